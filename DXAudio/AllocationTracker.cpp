@@ -0,0 +1,113 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "AllocationTracker.h"
+
+#ifdef DXAUDIO_TRACK_ALLOCATIONS
+
+#include <crtdbg.h>
+
+#define WARMUP_PERIODS 32
+
+static thread_local bool t_Tracking = false; //True while the calling thread's period is being watched
+static thread_local UINT t_Allocations = 0; //Allocations made by the calling thread this period
+
+static _CRT_ALLOC_HOOK s_PreviousHook = nullptr; //Whatever hook was installed before ours
+
+//Counts allocations on tracked threads, then defers to any previous hook
+static int __cdecl AllocHook(int AllocType, void* UserData, size_t Size, int BlockType, long RequestNumber, const unsigned char* Filename, int LineNumber) {
+	if (t_Tracking && (AllocType == _HOOK_ALLOC || AllocType == _HOOK_REALLOC)) {
+		t_Allocations++;
+	}
+
+	if (s_PreviousHook != nullptr) {
+		return s_PreviousHook(AllocType, UserData, Size, BlockType, RequestNumber, Filename, LineNumber);
+	}
+
+	return TRUE;
+}
+
+//Installs the hook the first time it's called.  It is never removed, since another hook may have
+//been chained on top of it - on untracked threads it costs a single thread-local read.
+static bool InstallHook() {
+	s_PreviousHook = _CrtSetAllocHook(AllocHook);
+	return true;
+}
+
+//Returns the lowest committed address of the calling thread's stack
+static void* GetStackLimit() {
+	return ((NT_TIB*)(NtCurrentTeb()))->StackLimit;
+}
+
+AllocationTracker::AllocationTracker() :
+m_WarmupPeriods(WARMUP_PERIODS),
+m_StackLimit(nullptr),
+m_StackGrew(false)
+{
+	static const bool s_IsHookInstalled = InstallHook(); //Thread-safe one-time initialization
+	(void)(s_IsHookInstalled);
+}
+
+VOID AllocationTracker::BeginPeriod() {
+	t_Allocations = 0;
+	t_Tracking = true;
+	m_StackLimit = GetStackLimit();
+	m_StackGrew = false;
+}
+
+VOID AllocationTracker::EndPeriod() {
+	t_Tracking = false;
+
+	if (GetStackLimit() != m_StackLimit) {
+		m_StackGrew = true;
+	}
+
+	if (m_WarmupPeriods != 0) {
+		m_WarmupPeriods--;
+		return;
+	}
+
+	_ASSERT_EXPR(t_Allocations == 0, L"DXAudio: the stream thread allocated memory while processing a period");
+	_ASSERT_EXPR(!m_StackGrew, L"DXAudio: the stream thread's stack grew while processing a period");
+}
+
+VOID AllocationTracker::Pause() {
+	t_Tracking = false;
+
+	if (GetStackLimit() != m_StackLimit) {
+		m_StackGrew = true;
+	}
+}
+
+VOID AllocationTracker::Resume() {
+	t_Tracking = true;
+
+	//Whatever the callback did to the stack is the application's business
+	m_StackLimit = GetStackLimit();
+}
+
+VOID AllocationTracker::Rearm() {
+	m_WarmupPeriods = WARMUP_PERIODS;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+
+//The tracker is active in debug builds, unless the application's callbacks are known to allocate
+//through the same CRT - in which case define DXAUDIO_NO_ALLOCATION_TRACKER to turn it off.
+#if defined(_DEBUG) && !defined(DXAUDIO_NO_ALLOCATION_TRACKER)
+	#define DXAUDIO_TRACK_ALLOCATIONS
+#endif
+
+/* AllocationTracker verifies, in debug builds, that the stream thread's hot path is allocation-free.
+** Between BeginPeriod() and EndPeriod() it counts every CRT heap allocation made on the calling thread
+** (through _CrtSetAllocHook) and watches the thread's committed stack; EndPeriod() asserts that neither
+** grew.  The application's callback is excluded with Pause() and Resume().  The first few periods
+** after Rearm() are not checked, since WASAPI and the stack need a moment to settle.  In release builds
+** every method is an empty inline function. */
+class AllocationTracker {
+public:
+#ifdef DXAUDIO_TRACK_ALLOCATIONS
+	AllocationTracker();
+
+	/* Starts watching the calling thread for one period */
+	VOID BeginPeriod();
+
+	/* Stops watching, and asserts if anything was allocated or the stack grew */
+	VOID EndPeriod();
+
+	/* Stops counting while the application's callback runs */
+	VOID Pause();
+
+	/* Resumes counting after the application's callback returns */
+	VOID Resume();
+
+	/* Restarts the warm-up, after the stream is (re)started or (re)initialized */
+	VOID Rearm();
+
+private:
+	UINT m_WarmupPeriods; //Periods left before checking starts
+	void* m_StackLimit; //The committed stack limit when counting last (re)started
+	bool m_StackGrew; //True if the stack grew outside of the callback this period
+#else
+	VOID BeginPeriod() { }
+	VOID EndPeriod() { }
+	VOID Pause() { }
+	VOID Resume() { }
+	VOID Rearm() { }
+#endif
+};
\ No newline at end of file
@@ -52,7 +52,7 @@ CDXAudioDuplexStream::~CDXAudioDuplexStream() {
 	}
 }
 
-HRESULT CDXAudioDuplexStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioDuplexStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -70,10 +70,8 @@ HRESULT CDXAudioDuplexStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
-
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(pDesc, Callback);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -83,10 +81,9 @@ HRESULT CDXAudioDuplexStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 VOID CDXAudioDuplexStream::ImplInitialize() {
 	HRESULT hr = S_OK;
 
-	//Get the default audio input device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio input device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eCapture,
-		eConsole,
 		&m_InputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -98,10 +95,9 @@ VOID CDXAudioDuplexStream::ImplInitialize() {
 	//Initialize the client reader
 	InitClientReader();
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&m_OutputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -133,10 +129,9 @@ VOID CDXAudioDuplexStream::ImplDeviceChange() {
 	CComPtr<IMMDevice> DefaultDevice;
 	LPWSTR DefaultDeviceID = nullptr;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -175,10 +170,9 @@ VOID CDXAudioDuplexStream::ImplDeviceChange() {
 	//Release this com ptr since we're reusing it for checking the input device
 	DefaultDevice.Release();
 
-	//Get the default audio input device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio input device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eCapture,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -248,34 +242,36 @@ VOID CDXAudioDuplexStream::ImplProcess() {
 	HRESULT hr = S_OK;
 
 	//The number of samples we need to generate corresponds with the application sample rate.
-	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
-	//so we need to multiply by the resample ratio to get the correct number of frames.
-	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	//m_ClientReader.GetMaxReadFrames() accounts for the resample ratio (and coalescing).
+	UINT InputBufferSize = m_ClientReader.GetMaxReadFrames();
+	FLOAT* InputBuffer = m_Arena.GetInput(); //Preallocated in InitArena(), so the period never allocates
 	UINT FramesRead = 0;
+	bool IsSilent = false; //Set if the endpoint reported the input as silent
 
 	//Read the resampled data from the device
 	m_ClientReader.Read (
 		InputBuffer,
 		InputBufferSize,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
-	//Generate an output buffer of equal size to the input buffer, also on the stack
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
+	//The output buffer is sized to match the largest possible read
+	FLOAT* OutputBuffer = m_Arena.GetOutput();
 
-	//Give the application the input data and tell it to generate output
-	m_ReadWriteCallback->OnProcess (
-		m_SampleRate,
+	//Give the application the input data and get output from it
+	const bool IsOutputSilent = ProcessDuplex (
 		InputBuffer,
 		OutputBuffer,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
 	//Write this data to the stream
 	m_ClientWriter.Write (
 		OutputBuffer,
-		FramesRead
+		FramesRead,
+		IsOutputSilent
 	);
 }
 
@@ -285,11 +281,27 @@ VOID CDXAudioDuplexStream::InitClientReader() {
 
 	HRESULT hr = m_ClientReader.Initialize (
 		false,
-		m_SampleRate,
+		GetRequestedRate(),
 		GetWaitEvent(),
+		m_Desc.Flags,
+		1,
 		m_InputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		//In native-rate mode the stream follows the capture side, and the render side has to follow along
+		if (UpdateSampleRate(m_ClientReader.GetSampleRate())) {
+			m_ClientWriter.Clean();
+			InitClientWriter();
+
+			if (m_Running) {
+				m_ClientWriter.Start();
+			}
+		}
+
+		InitArena();
+	}
 }
 
 //Initialize the client writer
@@ -299,11 +311,24 @@ VOID CDXAudioDuplexStream::InitClientWriter() {
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
 		NULL,
+		m_Desc.Flags,
+		m_Desc.LatencyMode,
+		m_Desc.PrefillFrames,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
 }
 
+//Size the per-period buffers from the client reader - the output matches whatever was read
+VOID CDXAudioDuplexStream::InitArena() {
+	const UINT MaxFrames = m_ClientReader.GetMaxReadFrames();
+
+	HRESULT hr = m_Arena.Reserve (
+		MaxFrames,
+		MaxFrames
+	); HANDLE_HR(__LINE__);
+}
+
 //Handle bad or good HRESULTS
 HRESULT CDXAudioDuplexStream::HandleHR(UINT Line, HRESULT hr) {
 	if (hr == S_OK) {
@@ -314,6 +339,7 @@ HRESULT CDXAudioDuplexStream::HandleHR(UINT Line, HRESULT hr) {
 	} else {
 		//Something bad happened, stop the stream and alert the application
 		m_ReadWriteCallback->OnObjectFailure(FILENAME, Line, hr);
+		RecordFailure(hr);
 		Halt();
 		return E_FAIL;
 	}
@@ -71,12 +71,11 @@ public:
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_InputDevice; //The device we're reading from
 	CComPtr<IMMDevice> m_OutputDevice; //The device we're writing to
-	CComPtr<IDXAudioReadWriteCallback> m_ReadWriteCallback; //The callback object
 	LPWSTR m_InputDeviceID; //The input device's unique identifier
 	LPWSTR m_OutputDeviceID; //The output device's unique identifier
 	ClientReader m_ClientReader; //Used for reading input data from the stream
@@ -89,6 +88,9 @@ private:
 	/* Initializes the client writer object */
 	VOID InitClientWriter();
 
+	/* Sizes the per-period buffers in m_Arena */
+	VOID InitArena();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
@@ -46,7 +46,7 @@ CDXAudioEchoStream::~CDXAudioEchoStream() {
 	}
 }
 
-HRESULT CDXAudioEchoStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioEchoStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +64,8 @@ HRESULT CDXAudioEchoStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAu
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
-
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(pDesc, Callback);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -77,10 +75,9 @@ HRESULT CDXAudioEchoStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAu
 VOID CDXAudioEchoStream::ImplInitialize() {
 	HRESULT hr = S_OK;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&m_OutputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -115,10 +112,9 @@ VOID CDXAudioEchoStream::ImplDeviceChange() {
 	CComPtr<IMMDevice> DefaultDevice;
 	LPWSTR DefaultDeviceID = nullptr;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -193,34 +189,36 @@ VOID CDXAudioEchoStream::ImplProcess() {
 	HRESULT hr = S_OK;
 
 	//The number of samples we need to generate corresponds with the application sample rate.
-	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
-	//so we need to multiply by the resample ratio to get the correct number of frames.
-	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	//m_ClientReader.GetMaxReadFrames() accounts for the resample ratio (and coalescing).
+	UINT InputBufferSize = m_ClientReader.GetMaxReadFrames();
+	FLOAT* InputBuffer = m_Arena.GetInput(); //Preallocated in InitArena(), so the period never allocates
 	UINT FramesRead = 0;
+	bool IsSilent = false; //Set if the endpoint reported the input as silent
 
 	//Read the resampled data from the device
 	m_ClientReader.Read (
 		InputBuffer,
 		InputBufferSize,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
-	//Generate an output buffer of equal size to the input buffer, also on the stack
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
+	//The output buffer is sized to match the largest possible read
+	FLOAT* OutputBuffer = m_Arena.GetOutput();
 
-	//Give the application the input data and tell it to generate output
-	m_ReadWriteCallback->OnProcess (
-		m_SampleRate,
+	//Give the application the input data and get output from it
+	const bool IsOutputSilent = ProcessDuplex (
 		InputBuffer,
 		OutputBuffer,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
 	//Write this data to the stream
 	m_ClientWriter.Write (
 		OutputBuffer,
-		FramesRead
+		FramesRead,
+		IsOutputSilent
 	);
 }
 
@@ -230,11 +228,27 @@ VOID CDXAudioEchoStream::InitClientReader() {
 
 	HRESULT hr = m_ClientReader.Initialize (
 		true,
-		m_SampleRate,
+		GetRequestedRate(),
 		NULL,
+		m_Desc.Flags,
+		1,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		//In native-rate mode the stream follows the capture side, and the render side has to follow along
+		if (UpdateSampleRate(m_ClientReader.GetSampleRate())) {
+			m_ClientWriter.Clean();
+			InitClientWriter();
+
+			if (m_Running) {
+				m_ClientWriter.Start();
+			}
+		}
+
+		InitArena();
+	}
 }
 
 //Initialize the client writer
@@ -244,11 +258,24 @@ VOID CDXAudioEchoStream::InitClientWriter() {
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
 		GetWaitEvent(),
+		m_Desc.Flags,
+		m_Desc.LatencyMode,
+		m_Desc.PrefillFrames,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
 }
 
+//Size the per-period buffers from the client reader - the output matches whatever was read
+VOID CDXAudioEchoStream::InitArena() {
+	const UINT MaxFrames = m_ClientReader.GetMaxReadFrames();
+
+	HRESULT hr = m_Arena.Reserve (
+		MaxFrames,
+		MaxFrames
+	); HANDLE_HR(__LINE__);
+}
+
 //Handle bad or good HRESULTS
 HRESULT CDXAudioEchoStream::HandleHR(UINT Line, HRESULT hr) {
 	if (hr == S_OK) {
@@ -259,6 +286,7 @@ HRESULT CDXAudioEchoStream::HandleHR(UINT Line, HRESULT hr) {
 	} else {
 		//Something bad happened, stop the stream and alert the application
 		m_ReadWriteCallback->OnObjectFailure(FILENAME, Line, hr);
+		RecordFailure(hr);
 		Halt();
 		return E_FAIL;
 	}
@@ -71,11 +71,10 @@ public:
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_OutputDevice; //The device we're reading to / writing from
-	CComPtr<IDXAudioReadWriteCallback> m_ReadWriteCallback; //The callback object
 	LPWSTR m_DeviceID; //The device's unique identifier
 	ClientReader m_ClientReader; //Used for reading loopback data from the stream
 	ClientWriter m_ClientWriter; //Used for writing output data to the stream
@@ -87,6 +86,9 @@ private:
 	/* Initializes the client writer object */
 	VOID InitClientWriter();
 
+	/* Sizes the per-period buffers in m_Arena */
+	VOID InitArena();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
@@ -29,8 +29,12 @@
 
 //Zero out all data
 CDXAudioInputStream::CDXAudioInputStream() :
-m_ClientReader(*this),
+m_ReaderA(*this),
+m_ReaderB(*this),
+m_ClientReader(&m_ReaderA),
+m_StandbyReader(&m_ReaderB),
 m_DeviceID(nullptr),
+m_StandbyDeviceID(nullptr),
 m_Running(false)
 { }
 
@@ -43,9 +47,14 @@ CDXAudioInputStream::~CDXAudioInputStream() {
 		CoTaskMemFree(m_DeviceID);
 		m_DeviceID = nullptr;
 	}
+
+	if (m_StandbyDeviceID != nullptr) {
+		CoTaskMemFree(m_StandbyDeviceID);
+		m_StandbyDeviceID = nullptr;
+	}
 }
 
-HRESULT CDXAudioInputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioInputStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -63,10 +72,8 @@ HRESULT CDXAudioInputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXA
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
-
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(pDesc, Callback);
 
 	if (FAILED(hr)) return hr;
 
@@ -76,10 +83,9 @@ HRESULT CDXAudioInputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXA
 VOID CDXAudioInputStream::ImplInitialize() {
 	HRESULT hr = S_OK;
 
-	//Get the default audio input device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio input device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eCapture,
-		eConsole,
 		&m_InputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -95,13 +101,15 @@ VOID CDXAudioInputStream::ImplInitialize() {
 //Start the stream
 VOID CDXAudioInputStream::ImplStart() {
 	m_Running = true;
-	m_ClientReader.Start();
+	m_ClientReader->Start();
+	UpdateProcessTimer();
 }
 
 //Stop the stream
 VOID CDXAudioInputStream::ImplStop() {
 	m_Running = false;
-	m_ClientReader.Stop();
+	m_ClientReader->Stop();
+	UpdateProcessTimer();
 }
 
 VOID CDXAudioInputStream::ImplDeviceChange() {
@@ -109,10 +117,9 @@ VOID CDXAudioInputStream::ImplDeviceChange() {
 	CComPtr<IMMDevice> DefaultDevice;
 	LPWSTR DefaultDeviceID = nullptr;
 
-	//Get the default audio input device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio input device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eCapture,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -124,7 +131,7 @@ VOID CDXAudioInputStream::ImplDeviceChange() {
 	//Check to see if the id of the default device is the same as ours
 	if (wcscmp(DefaultDeviceID, m_DeviceID) != 0) {
 		//If it isn't, we don't have the default device. Release everything.
-		m_ClientReader.Clean();
+		m_ClientReader->Clean();
 		m_InputDevice.Release();
 		CoTaskMemFree(m_DeviceID);
 
@@ -137,7 +144,7 @@ VOID CDXAudioInputStream::ImplDeviceChange() {
 
 		//If the stream was running before, we need to start it up again
 		if (m_Running) {
-			m_ClientReader.Start();
+			m_ClientReader->Start();
 		}
 	}
 
@@ -148,19 +155,103 @@ VOID CDXAudioInputStream::ImplDeviceChange() {
 	}
 }
 
+HRESULT CDXAudioInputStream::ImplPrepareStandby() {
+	HRESULT hr = S_OK;
+	CComPtr<IMMDevice> DefaultDevice;
+	LPWSTR DefaultDeviceID = nullptr;
+	CComPtr<IDXAudioCallback> Callback = m_ReadCallback;
+
+	//Get the audio input device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
+		eCapture,
+		&DefaultDevice
+	); if (FAILED(hr)) return NoteStandbyFailure(FILENAME, __LINE__, hr);
+
+	//Get the id of this device
+	hr = DefaultDevice->GetId (
+		&DefaultDeviceID
+	); if (FAILED(hr)) return NoteStandbyFailure(FILENAME, __LINE__, hr);
+
+	//The stream thread only changes m_DeviceID in ImplSwapStandby(), which can't run until we're done
+	if (wcscmp(DefaultDeviceID, m_DeviceID) == 0) {
+		CoTaskMemFree(DefaultDeviceID);
+		return S_FALSE;
+	}
+
+	//Open the new device just as InitClientReader() would, short of letting the stream know
+	hr = m_StandbyReader->Prepare (
+		false,
+		GetRequestedRate(),
+		IsCoalesceMode() ? NULL : GetWaitEvent(),
+		m_Desc.Flags,
+		GetCoalescePeriods(),
+		DefaultDevice,
+		Callback
+	);
+
+	if (FAILED(hr)) {
+		if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+			LPCWSTR File = nullptr;
+			UINT Line = 0;
+
+			m_StandbyReader->GetFailure(&File, &Line, &hr);
+			NoteStandbyFailure(File, Line, hr);
+		}
+
+		m_StandbyReader->Clean();
+		CoTaskMemFree(DefaultDeviceID);
+		return hr;
+	}
+
+	m_StandbyDevice = DefaultDevice;
+	m_StandbyDeviceID = DefaultDeviceID;
+
+	return S_OK;
+}
+
+VOID CDXAudioInputStream::ImplSwapStandby() {
+	ClientReader* const OldReader = m_ClientReader;
+
+	if (m_Running) {
+		m_StandbyReader->Start();
+	}
+
+	m_ClientReader = m_StandbyReader;
+	m_StandbyReader = OldReader;
+	m_StandbyReader->Clean();
+
+	m_InputDevice = m_StandbyDevice;
+	m_StandbyDevice.Release();
+	CoTaskMemFree(m_DeviceID);
+	m_DeviceID = m_StandbyDeviceID;
+	m_StandbyDeviceID = nullptr;
+
+	m_ClientReader->PublishEndpointInfo();
+	UpdateSampleRate(m_ClientReader->GetSampleRate());
+	InitArena();
+
+	UpdateProcessTimer();
+
+	//Fade in over about a period, since the new device starts in the middle of whatever it's hearing
+	BeginFadeIn(m_ClientReader->GetPeriodFrames());
+
+	//A property may have changed while the standby was being prepared
+	ImplPropertyChange();
+}
+
 VOID CDXAudioInputStream::ImplPropertyChange() {
 	//This will return AUDCLNT_E_DEVICE_INVALIDATED if we have a stream with outdated properties
-	HRESULT hr = m_ClientReader.VerifyClient();
+	HRESULT hr = m_ClientReader->VerifyClient();
 
 	//If that's the case, we need to get rid of this one and create a new one
 	if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
-		m_ClientReader.Clean();
+		m_ClientReader->Clean();
 
 		InitClientReader();
 
 		//If the stream was running before, we need to start it up again
 		if (m_Running) {
-			m_ClientReader.Start();
+			m_ClientReader->Start();
 		}
 	} else HANDLE_HR(__LINE__);
 }
@@ -169,38 +260,82 @@ VOID CDXAudioInputStream::ImplProcess() {
 	HRESULT hr = S_OK;
 
 	//The number of samples we need to generate corresponds with the application sample rate.
-	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
-	//so we need to multiply by the resample ratio to get the correct number of frames.
-	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	//m_ClientReader->GetMaxReadFrames() accounts for the resample ratio (and coalescing).
+	UINT InputBufferSize = m_ClientReader->GetMaxReadFrames();
+	FLOAT* InputBuffer = m_Arena.GetInput(); //Preallocated in InitArena(), so the period never allocates
 	UINT FramesRead = 0; //Used to find out how many frames were actually read
+	bool IsSilent = false; //Set if the endpoint reported the input as silent
 
 	//Read the input data from the stream
-	m_ClientReader.Read (
+	m_ClientReader->Read (
 		InputBuffer,
 		InputBufferSize,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
-	//Send that data to the application
-	m_ReadCallback->OnProcess (
-		m_SampleRate,
+	//Smooth over a switch to a standby endpoint
+	ApplyFadeIn (
 		InputBuffer,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
+
+	//Send that data to the application (a coalescing reader returns nothing until a batch is complete)
+	if (FramesRead != 0 || !IsCoalesceMode()) {
+		ProcessInput (
+			InputBuffer,
+			FramesRead,
+			IsSilent
+		);
+	}
 }
 
 //Initialize the client reader
 VOID CDXAudioInputStream::InitClientReader() {
 	CComPtr<IDXAudioCallback> Callback = m_ReadCallback;
 
-	HRESULT hr = m_ClientReader.Initialize (
+	//A coalescing stream polls the client on a timer, once per batch, rather than waking every period
+	HRESULT hr = m_ClientReader->Initialize (
 		false,
-		m_SampleRate,
-		GetWaitEvent(),
+		GetRequestedRate(),
+		IsCoalesceMode() ? NULL : GetWaitEvent(),
+		m_Desc.Flags,
+		GetCoalescePeriods(),
 		m_InputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		UpdateSampleRate(m_ClientReader->GetSampleRate());
+		InitArena();
+	} else {
+		//The device went away while it was being opened - leave nothing half-open for Read() or VerifyClient()
+		m_ClientReader->Clean();
+	}
+
+	UpdateProcessTimer();
+}
+
+//Size the per-period buffers from the client reader
+VOID CDXAudioInputStream::InitArena() {
+	HRESULT hr = m_Arena.Reserve (
+		m_ClientReader->GetMaxReadFrames(),
+		0
+	); HANDLE_HR(__LINE__);
+}
+
+VOID CDXAudioInputStream::UpdateProcessTimer() {
+	if (!IsCoalesceMode()) {
+		return;
+	}
+
+	//A cleaned client reader has no period, so the timer would fire continuously
+	if (m_Running && m_ClientReader->GetPeriod() != 0) {
+		SetProcessTimer(m_ClientReader->GetPeriod() * GetCoalescePeriods());
+	} else {
+		CancelProcessTimer();
+	}
 }
 
 //Handle bad or good HRESULTS
@@ -213,6 +348,7 @@ HRESULT CDXAudioInputStream::HandleHR(UINT Line, HRESULT hr) {
 	} else {
 		//Something bad happened, stop the stream and alert the application
 		m_ReadCallback->OnObjectFailure(FILENAME, Line, hr);
+		RecordFailure(hr);
 		Halt();
 		return E_FAIL;
 	}
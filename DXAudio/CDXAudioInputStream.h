@@ -66,21 +66,37 @@ public:
 	/* Reads data from the stream, then calls Process() on the callback object */
 	VOID ImplProcess() final;
 
+	/* Opens the default device with the standby reader, if it isn't the one in use */
+	HRESULT ImplPrepareStandby() final;
+
+	/* Makes the standby reader the one in use, and fades the stream in on it */
+	VOID ImplSwapStandby() final;
+
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_InputDevice; //The device we're reading from
-	CComPtr<IDXAudioReadCallback> m_ReadCallback; //The callback object
 	LPWSTR m_DeviceID; //The input device's unique identifier
-	ClientReader m_ClientReader; //Used for reading data from the stream
+	ClientReader m_ReaderA; //The two client readers take turns being used and standing by (standby mode)
+	ClientReader m_ReaderB;
+	ClientReader* m_ClientReader; //Used for reading data from the stream
+	ClientReader* m_StandbyReader; //Opened on the standby thread for the new default device, then swapped with m_ClientReader
+	CComPtr<IMMDevice> m_StandbyDevice; //The device the standby reader was opened on
+	LPWSTR m_StandbyDeviceID; //Its unique identifier
 	bool m_Running; //Indicates whether or not the stream is running (used for routing)
 
 	/* Initializes the client reader object */
 	VOID InitClientReader();
 
+	/* Sizes the per-period buffers in m_Arena */
+	VOID InitArena();
+
+	/* Arms the process timer of a coalescing stream while it's running on an open client, and cancels it otherwise */
+	VOID UpdateProcessTimer();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
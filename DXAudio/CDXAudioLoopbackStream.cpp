@@ -46,7 +46,7 @@ CDXAudioLoopbackStream::~CDXAudioLoopbackStream() {
 	}
 }
 
-HRESULT CDXAudioLoopbackStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioLoopbackStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +64,8 @@ HRESULT CDXAudioLoopbackStream::Initialize(FLOAT SampleRate, IDXAudioCallback* p
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
-
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(pDesc, Callback);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -77,10 +75,9 @@ HRESULT CDXAudioLoopbackStream::Initialize(FLOAT SampleRate, IDXAudioCallback* p
 VOID CDXAudioLoopbackStream::ImplInitialize() {
 	HRESULT hr = S_OK;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&m_OutputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -115,10 +112,9 @@ VOID CDXAudioLoopbackStream::ImplDeviceChange() {
 	CComPtr<IMMDevice> DefaultDevice;
 	LPWSTR DefaultDeviceID = nullptr;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -193,34 +189,40 @@ VOID CDXAudioLoopbackStream::ImplProcess() {
 	HRESULT hr = S_OK;
 
 	//The number of samples we need to generate corresponds with the application sample rate.
-	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
-	//so we need to multiply by the resample ratio to get the correct number of frames.
-	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	//m_ClientReader.GetMaxReadFrames() accounts for the resample ratio (and coalescing).
+	UINT InputBufferSize = m_ClientReader.GetMaxReadFrames();
+	FLOAT* InputBuffer = m_Arena.GetInput(); //Preallocated in InitArena(), so the period never allocates
 	UINT FramesRead = 0;
+	bool IsSilent = false; //Set if the endpoint reported the input as silent
 
 	//Read the resampled data from the device
 	m_ClientReader.Read (
 		InputBuffer,
 		InputBufferSize,
-		FramesRead
+		FramesRead,
+		IsSilent
 	);
 
-	//Give the application this data
-	m_ReadCallback->OnProcess (
-		m_SampleRate,
-		InputBuffer,
-		FramesRead
-	);
+	//Send that data to the application (a coalescing reader returns nothing until a batch is complete)
+	if (FramesRead != 0 || !IsCoalesceMode()) {
+		ProcessInput (
+			InputBuffer,
+			FramesRead,
+			IsSilent
+		);
+	}
 
-	//Generate a "fake" output buffer with silence to appease the render stream
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
-	ZeroMemory(OutputBuffer, sizeof(FLOAT) * 2 * FramesRead);
+	//Generate a "fake" output buffer with silence to appease the render stream.  This is sized from the
+	//render period rather than FramesRead, which is zero for most periods when coalescing.  The writer is
+	//told it's silent, so it zeroes the buffer itself if it needs to, and otherwise renders it as a flag.
+	const UINT SilenceFrames = m_Arena.GetOutputFrames();
+	FLOAT* OutputBuffer = m_Arena.GetOutput();
 
 	//Write this data to the stream
 	m_ClientWriter.Write (
 		OutputBuffer,
-		FramesRead
+		SilenceFrames,
+		true
 	);
 }
 
@@ -230,11 +232,27 @@ VOID CDXAudioLoopbackStream::InitClientReader() {
 
 	HRESULT hr = m_ClientReader.Initialize (
 		true,
-		m_SampleRate,
+		GetRequestedRate(),
 		NULL,
+		m_Desc.Flags,
+		GetCoalescePeriods(),
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		//In native-rate mode the stream follows the capture side, and the render side has to follow along
+		if (UpdateSampleRate(m_ClientReader.GetSampleRate())) {
+			m_ClientWriter.Clean();
+			InitClientWriter();
+
+			if (m_Running) {
+				m_ClientWriter.Start();
+			}
+		}
+
+		InitArena();
+	}
 }
 
 //Initialize the client writer
@@ -244,9 +262,28 @@ VOID CDXAudioLoopbackStream::InitClientWriter() {
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
 		GetWaitEvent(),
+		NULL, //The render side only exists to keep the endpoint running
+		DXAUDIO_LATENCY_MODE_DEFAULT, //Only silence is written, so the margin doesn't matter
+		0,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		InitArena();
+	}
+}
+
+//Size the per-period buffers - the input from the client reader, the silence from the render period.
+//This is called after each client is initialized, so the writer may not be ready yet.
+VOID CDXAudioLoopbackStream::InitArena() {
+	const DOUBLE Ratio = m_ClientWriter.GetRatio();
+	const UINT SilenceFrames = Ratio != 0.0 ? (UINT)(ceil(DOUBLE(m_ClientWriter.GetPeriodFrames()) / Ratio)) : 0;
+
+	HRESULT hr = m_Arena.Reserve (
+		m_ClientReader.GetMaxReadFrames(),
+		SilenceFrames
+	); HANDLE_HR(__LINE__);
 }
 
 //Handle bad or good HRESULTS
@@ -259,6 +296,7 @@ HRESULT CDXAudioLoopbackStream::HandleHR(UINT Line, HRESULT hr) {
 	} else {
 		//Something bad happened, stop the stream and alert the application
 		m_ReadCallback->OnObjectFailure(FILENAME, Line, hr);
+		RecordFailure(hr);
 		Halt();
 		return E_FAIL;
 	}
@@ -70,11 +70,10 @@ public:
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_OutputDevice; //The device we're reading from (output)
-	CComPtr<IDXAudioReadCallback> m_ReadCallback; //The callback object
 	LPWSTR m_DeviceID; //The output device's unique identifier
 	ClientReader m_ClientReader; //Used for reading data from the stream
 	ClientWriter m_ClientWriter; //Used only for event callback purposes (only silence is output)
@@ -86,6 +85,9 @@ private:
 	/* Initializes the client writer object */
 	VOID InitClientWriter();
 
+	/* Sizes the per-period buffers in m_Arena */
+	VOID InitArena();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
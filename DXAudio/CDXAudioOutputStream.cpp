@@ -29,8 +29,12 @@
 
 //Zero out all data
 CDXAudioOutputStream::CDXAudioOutputStream() :
-m_ClientWriter(*this),
+m_WriterA(*this),
+m_WriterB(*this),
+m_ClientWriter(&m_WriterA),
+m_StandbyWriter(&m_WriterB),
 m_DeviceID(nullptr),
+m_StandbyDeviceID(nullptr),
 m_SamplesNeeded(0.0),
 m_Running(false)
 { }
@@ -44,9 +48,14 @@ CDXAudioOutputStream::~CDXAudioOutputStream() {
 		CoTaskMemFree(m_DeviceID);
 		m_DeviceID = nullptr;
 	}
+
+	if (m_StandbyDeviceID != nullptr) {
+		CoTaskMemFree(m_StandbyDeviceID);
+		m_StandbyDeviceID = nullptr;
+	}
 }
 
-HRESULT CDXAudioOutputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioOutputStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +73,8 @@ HRESULT CDXAudioOutputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
-
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(pDesc, Callback);
 
 	if (FAILED(hr)) return hr;
 
@@ -77,10 +84,9 @@ HRESULT CDXAudioOutputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 VOID CDXAudioOutputStream::ImplInitialize() {
 	HRESULT hr = S_OK;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&m_OutputDevice
 	); HANDLE_HR(__LINE__);
 
@@ -96,13 +102,13 @@ VOID CDXAudioOutputStream::ImplInitialize() {
 //Start the stream
 VOID CDXAudioOutputStream::ImplStart() {
 	m_Running = true;
-	m_ClientWriter.Start();
+	m_ClientWriter->Start();
 }
 
 //Stop the stream
 VOID CDXAudioOutputStream::ImplStop() {
 	m_Running = false;
-	m_ClientWriter.Stop();
+	m_ClientWriter->Stop();
 }
 
 VOID CDXAudioOutputStream::ImplDeviceChange() {
@@ -110,10 +116,9 @@ VOID CDXAudioOutputStream::ImplDeviceChange() {
 	CComPtr<IMMDevice> DefaultDevice;
 	LPWSTR DefaultDeviceID = nullptr;
 
-	//Get the default audio output device
-	hr = m_Enumerator->GetDefaultAudioEndpoint (
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
 		eRender,
-		eConsole,
 		&DefaultDevice
 	); HANDLE_HR(__LINE__);
 
@@ -125,7 +130,7 @@ VOID CDXAudioOutputStream::ImplDeviceChange() {
 	//Check to see if the id of the default device is the same as ours
 	if (wcscmp(DefaultDeviceID, m_DeviceID) != 0) {
 		//If it isn't, we don't have the default device. Release everything.
-		m_ClientWriter.Clean();
+		m_ClientWriter->Clean();
 		m_OutputDevice.Release();
 		CoTaskMemFree(m_DeviceID);
 
@@ -138,7 +143,7 @@ VOID CDXAudioOutputStream::ImplDeviceChange() {
 
 		//If the stream was running before, we need to start it up again
 		if (m_Running) {
-			m_ClientWriter.Start();
+			m_ClientWriter->Start();
 		}
 
 		//Reset decimal sample counter
@@ -152,19 +157,103 @@ VOID CDXAudioOutputStream::ImplDeviceChange() {
 	}
 }
 
+HRESULT CDXAudioOutputStream::ImplPrepareStandby() {
+	HRESULT hr = S_OK;
+	CComPtr<IMMDevice> DefaultDevice;
+	LPWSTR DefaultDeviceID = nullptr;
+	CComPtr<IDXAudioCallback> Callback = m_WriteCallback;
+
+	//Get the audio output device (the default one, unless the stream was given an ID)
+	hr = GetEndpoint (
+		eRender,
+		&DefaultDevice
+	); if (FAILED(hr)) return NoteStandbyFailure(FILENAME, __LINE__, hr);
+
+	//Get the id of this device
+	hr = DefaultDevice->GetId (
+		&DefaultDeviceID
+	); if (FAILED(hr)) return NoteStandbyFailure(FILENAME, __LINE__, hr);
+
+	//The stream thread only changes m_DeviceID in ImplSwapStandby(), which can't run until we're done
+	if (wcscmp(DefaultDeviceID, m_DeviceID) == 0) {
+		CoTaskMemFree(DefaultDeviceID);
+		return S_FALSE;
+	}
+
+	//Open the new device just as InitClientWriter() would, short of letting the stream know
+	hr = m_StandbyWriter->Prepare (
+		GetRequestedRate(),
+		GetWaitEvent(),
+		m_Desc.Flags,
+		m_Desc.LatencyMode,
+		m_Desc.PrefillFrames,
+		DefaultDevice,
+		Callback
+	);
+
+	if (FAILED(hr)) {
+		if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+			LPCWSTR File = nullptr;
+			UINT Line = 0;
+
+			m_StandbyWriter->GetFailure(&File, &Line, &hr);
+			NoteStandbyFailure(File, Line, hr);
+		}
+
+		m_StandbyWriter->Clean();
+		CoTaskMemFree(DefaultDeviceID);
+		return hr;
+	}
+
+	m_StandbyDevice = DefaultDevice;
+	m_StandbyDeviceID = DefaultDeviceID;
+
+	return S_OK;
+}
+
+VOID CDXAudioOutputStream::ImplSwapStandby() {
+	ClientWriter* const OldWriter = m_ClientWriter;
+
+	//Start the new endpoint first - its margin of silence covers the switch
+	if (m_Running) {
+		m_StandbyWriter->Start();
+	}
+
+	m_ClientWriter = m_StandbyWriter;
+	m_StandbyWriter = OldWriter;
+	m_StandbyWriter->Clean();
+
+	m_OutputDevice = m_StandbyDevice;
+	m_StandbyDevice.Release();
+	CoTaskMemFree(m_DeviceID);
+	m_DeviceID = m_StandbyDeviceID;
+	m_StandbyDeviceID = nullptr;
+
+	m_ClientWriter->PublishEndpointInfo();
+	UpdateSampleRate(m_ClientWriter->GetSampleRate());
+	InitArena();
+
+	//Reset decimal sample counter, and fade the first period in from the silence
+	m_SamplesNeeded = 0.0;
+	BeginFadeIn((UINT)(ceil(DOUBLE(m_ClientWriter->GetPeriodFrames()) / m_ClientWriter->GetRatio())));
+
+	//A property may have changed while the standby was being prepared
+	ImplPropertyChange();
+}
+
 VOID CDXAudioOutputStream::ImplPropertyChange() {
 	//This will return AUDCLNT_E_DEVICE_INVALIDATED if we have a stream with outdated properties
-	HRESULT hr = m_ClientWriter.VerifyClient();
+	HRESULT hr = m_ClientWriter->VerifyClient();
 
 	//If that's the case, we need to get rid of this one and create a new one
 	if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
-		m_ClientWriter.Clean();
+		m_ClientWriter->Clean();
 
 		InitClientWriter();
 
 		//If the stream was running before, we need to start it up again
 		if (m_Running) {
-			m_ClientWriter.Start();
+			m_ClientWriter->Start();
 		}
 
 		//Reset decimal sample counter
@@ -176,23 +265,30 @@ VOID CDXAudioOutputStream::ImplProcess() {
 	HRESULT hr = S_OK;
 
 	//The number of samples we need to generate corresponds with the application sample rate.
-	//m_ClientWriter.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
+	//m_ClientWriter->GetPeriodFrames() returns the frames needed at the endpoint sample rate,
 	//so we need to divide by the resample ratio to get the correct number of frames.
-	m_SamplesNeeded += DOUBLE(m_ClientWriter.GetPeriodFrames()) / m_ClientWriter.GetRatio();
+	m_SamplesNeeded += DOUBLE(m_ClientWriter->GetPeriodFrames()) / m_ClientWriter->GetRatio();
 	const UINT SamplesGen = (UINT)(ceil(m_SamplesNeeded)); //We'll generate an integral number of samples
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * SamplesGen)); //Create the buffer on the stack (_alloca is safe here)
+	FLOAT* OutputBuffer = m_Arena.GetOutput(); //Preallocated in InitArena(), so the period never allocates
 
-	//Get the application to generate new output data
-	m_WriteCallback->OnProcess (
-		m_SampleRate,
+	//Get new output data from the application
+	const bool IsSilent = ProcessOutput (
 		OutputBuffer,
 		SamplesGen
 	);
 
+	//Smooth over a switch to a standby endpoint
+	ApplyFadeIn (
+		OutputBuffer,
+		SamplesGen,
+		IsSilent
+	);
+
 	//Write that output data to the stream
-	m_ClientWriter.Write (
+	m_ClientWriter->Write (
 		OutputBuffer,
-		SamplesGen
+		SamplesGen,
+		IsSilent
 	);
 
 	//Subtract the integral number of samples from the decimal number of samples.
@@ -208,12 +304,31 @@ VOID CDXAudioOutputStream::ImplProcess() {
 VOID CDXAudioOutputStream::InitClientWriter() {
 	CComPtr<IDXAudioCallback> Callback = m_WriteCallback;
 
-	HRESULT hr = m_ClientWriter.Initialize (
-		m_SampleRate,
+	HRESULT hr = m_ClientWriter->Initialize (
+		GetRequestedRate(),
 		GetWaitEvent(),
+		m_Desc.Flags,
+		m_Desc.LatencyMode,
+		m_Desc.PrefillFrames,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	if (SUCCEEDED(hr)) {
+		UpdateSampleRate(m_ClientWriter->GetSampleRate());
+		InitArena();
+	}
+}
+
+//Size the output buffer from the client writer.  ImplProcess() carries the fractional
+//remainder between periods, so one period can need a single frame more than the ratio gives.
+VOID CDXAudioOutputStream::InitArena() {
+	const UINT MaxFrames = (UINT)(ceil(DOUBLE(m_ClientWriter->GetPeriodFrames()) / m_ClientWriter->GetRatio())) + 1;
+
+	HRESULT hr = m_Arena.Reserve (
+		0,
+		MaxFrames
+	); HANDLE_HR(__LINE__);
 }
 
 //Handle bad or good HRESULTS
@@ -226,6 +341,7 @@ HRESULT CDXAudioOutputStream::HandleHR(UINT Line, HRESULT hr) {
 	} else {
 		//Something bad happened, stop the stream and alert the application
 		m_WriteCallback->OnObjectFailure(FILENAME, Line, hr);
+		RecordFailure(hr);
 		Halt();
 		return E_FAIL;
 	}
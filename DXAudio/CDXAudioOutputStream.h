@@ -67,22 +67,35 @@ public:
 	/* Calls Process() on the callback object, then writes the given data to the stream */
 	VOID ImplProcess() final;
 
+	/* Opens the default device with the standby writer, if it isn't the one in use */
+	HRESULT ImplPrepareStandby() final;
+
+	/* Makes the standby writer the one in use, and fades the stream in on it */
+	VOID ImplSwapStandby() final;
+
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_OutputDevice; //The device we're outputting to
-	CComPtr<IDXAudioWriteCallback> m_WriteCallback; //The callback object
 	LPWSTR m_DeviceID; //The output device's unique identifier
-	ClientWriter m_ClientWriter; //Used for writing data to the endpoint
+	ClientWriter m_WriterA; //The two client writers take turns being used and standing by (standby mode)
+	ClientWriter m_WriterB;
+	ClientWriter* m_ClientWriter; //Used for writing data to the endpoint
+	ClientWriter* m_StandbyWriter; //Opened on the standby thread for the new default device, then swapped with m_ClientWriter
+	CComPtr<IMMDevice> m_StandbyDevice; //The device the standby writer was opened on
+	LPWSTR m_StandbyDeviceID; //Its unique identifier
 	DOUBLE m_SamplesNeeded; //Prevents padding loss by keeping track of decimal amounts of samples
 	bool m_Running; //Indicates whether or not the stream is running (used for routing)
 
 	/* Initializes the client writer object */
 	VOID InitClientWriter();
 
+	/* Sizes the per-period buffers in m_Arena */
+	VOID InitArena();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
@@ -22,12 +22,27 @@
 
 #include "CDXAudioStream.h"
 #include "CMMNotificationClient.h"
+#include "CSimulatedDeviceEnumerator.h"
+#include "EndpointCache.h"
+#include "NotificationHub.h"
+#include <Audioclient.h>
+#include <malloc.h>
+#include <math.h>
 
 #define FILENAME L"CDXAudioStream.cpp"
 #define EVENT_INIT(x, Line) x = CreateEventW(NULL, FALSE, FALSE, NULL); if (x == NULL) { m_Callback->OnObjectFailure(FILENAME, Line, HRESULT_FROM_WIN32(GetLastError())); return E_FAIL; }
 #define EVENT_CLEANUP(x) if (x != NULL) { CloseHandle(x); x = NULL; }
 #define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
 
+//Notifications come in bursts - a default device change is announced for every role, and a format change along with
+//several other properties - so changes are handled this long (in 100-nanosecond units) after the first of a burst
+#define CHANGE_SETTLE_TIME 100000
+
+//The rate a native-rate stream stands in with when the description doesn't give one, and the highest endpoint rate
+//its buffers are sized for
+#define NATIVE_RATE_DEFAULT 48000.0f
+#define NATIVE_RATE_CEILING 384000.0f
+
 CDXAudioStream::CDXAudioStream() :
 m_RefCount(1),
 m_StartEvent(NULL),
@@ -36,8 +51,50 @@ m_DeviceChangeEvent(NULL),
 m_PropertyChangeEvent(NULL),
 m_WaitEvent(NULL),
 m_HaltEvent(NULL),
-m_Thread(NULL)
-{ }
+m_ClosedEvent(NULL),
+m_ReadyEvent(NULL),
+m_InputDataEvent(NULL),
+m_OutputSpaceEvent(NULL),
+m_Thread(NULL),
+m_ProcessTimer(NULL),
+m_SettleTimer(NULL),
+m_BlockInput(nullptr),
+m_BlockOutput(nullptr),
+m_BlockCapacity(0),
+m_LastBatchFrames(0),
+m_LastProcessTime(0),
+m_TimerInterval(0),
+m_EndpointInfoUpdates(0),
+m_FramePosition(0),
+m_InputDeviceRate(0),
+m_OutputDeviceRate(0),
+m_IsOfflineRunning(false),
+m_IsReady(false),
+m_InitResult(S_OK),
+m_ChangeNotifiedTicks(0),
+m_RecoveryStart(0),
+m_StandbyThread(NULL),
+m_StandbyRequestEvent(NULL),
+m_StandbyReadyEvent(NULL),
+m_StandbyExitEvent(NULL),
+m_StandbyResult(S_OK),
+m_StandbyFailureFile(FILENAME),
+m_StandbyFailureLine(0),
+m_IsStandbyBusy(false),
+m_IsStandbyPending(false),
+m_StandbyNotified(0),
+m_IsDeviceChangeDeferred(false),
+m_IsPropertyChangeDeferred(false),
+m_FadeFrames(0),
+m_FadePosition(0)
+{
+	ZeroMemory(&m_Desc, sizeof(m_Desc));
+	ZeroMemory(&m_SimulatedDevice, sizeof(m_SimulatedDevice));
+	ZeroMemory(&m_Timing, sizeof(m_Timing));
+	ZeroMemory(&m_StreamInfo, sizeof(m_StreamInfo));
+	InitializeSRWLock(&m_StreamInfoLock);
+	QueryPerformanceFrequency(&m_PerformanceFrequency);
+}
 
 CDXAudioStream::~CDXAudioStream() {
 	//Expects thread to be halted by child class
@@ -53,10 +110,93 @@ CDXAudioStream::~CDXAudioStream() {
 	EVENT_CLEANUP(m_PropertyChangeEvent);
 	EVENT_CLEANUP(m_WaitEvent);
 	EVENT_CLEANUP(m_HaltEvent);
+	EVENT_CLEANUP(m_ClosedEvent);
+	EVENT_CLEANUP(m_ReadyEvent);
+	EVENT_CLEANUP(m_InputDataEvent);
+	EVENT_CLEANUP(m_OutputSpaceEvent);
+	EVENT_CLEANUP(m_ProcessTimer);
+	EVENT_CLEANUP(m_SettleTimer);
+	EVENT_CLEANUP(m_StandbyRequestEvent);
+	EVENT_CLEANUP(m_StandbyReadyEvent);
+	EVENT_CLEANUP(m_StandbyExitEvent);
+
+	if (m_BlockInput != nullptr) {
+		_aligned_free(m_BlockInput);
+		m_BlockInput = nullptr;
+	}
+
+	if (m_BlockOutput != nullptr) {
+		_aligned_free(m_BlockOutput);
+		m_BlockOutput = nullptr;
+	}
 }
 
-HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback) {
+HRESULT CDXAudioStream::Initialize(const DXAUDIO_STREAM_DESC* pDesc, CComPtr<IDXAudioCallback> Callback) {
+	HRESULT hr = S_OK;
+	const DXAUDIO_STREAM_TYPE Type = GetStreamType();
+
 	m_Callback = Callback;
+	m_Desc = *pDesc;
+	m_SampleRate = pDesc->SampleRate;
+
+	//In native-rate mode, the description's rate only stands in until the endpoint's is known
+	if (IsNativeRateMode() && m_SampleRate == 0.0f) {
+		m_SampleRate = NATIVE_RATE_DEFAULT;
+	}
+
+	//The simulated device description only has to outlive the call that creates the stream
+	if (pDesc->pSimulatedDevice != nullptr) {
+		m_SimulatedDevice = *pDesc->pSimulatedDevice;
+		m_Desc.pSimulatedDevice = &m_SimulatedDevice;
+	}
+
+	//An offline stream always runs on simulated endpoints (the zeroed default description, if none was given), and
+	//its file is the render device's
+	if (IsOfflineMode()) {
+		CComPtr<IDXAudioOfflineCallback> OfflineCallback;
+		Callback.QueryInterface(&OfflineCallback);
+
+		m_OfflineRenderer.Initialize(OfflineCallback, &m_AllocationTracker);
+		m_Desc.pSimulatedDevice = &m_SimulatedDevice;
+
+		if (pDesc->OfflineFileName != nullptr) {
+			m_SimulatedDevice.RenderFileName = pDesc->OfflineFileName;
+		}
+
+		m_Desc.OfflineFileName = nullptr;
+	}
+
+	//The file names are copied along with the simulated device description
+	if (m_SimulatedDevice.CaptureFileName != nullptr) {
+		m_CaptureFileName = m_SimulatedDevice.CaptureFileName;
+		m_SimulatedDevice.CaptureFileName = m_CaptureFileName.c_str();
+	}
+
+	if (m_SimulatedDevice.RenderFileName != nullptr) {
+		m_RenderFileName = m_SimulatedDevice.RenderFileName;
+		m_SimulatedDevice.RenderFileName = m_RenderFileName.c_str();
+	}
+
+	//So are the IDs of the chosen endpoints, which are dropped if the stream has no use for them
+	m_Desc.InputDeviceID = nullptr;
+	m_Desc.OutputDeviceID = nullptr;
+
+	if (pDesc->InputDeviceID != nullptr && UsesFlow(eCapture)) {
+		m_ChosenInputID = pDesc->InputDeviceID;
+		m_Desc.InputDeviceID = m_ChosenInputID.c_str();
+	}
+
+	if (pDesc->OutputDeviceID != nullptr && UsesFlow(eRender)) {
+		m_ChosenOutputID = pDesc->OutputDeviceID;
+		m_Desc.OutputDeviceID = m_ChosenOutputID.c_str();
+	}
+
+	//The extended callback interfaces are optional - at most one of these will succeed
+	Callback.QueryInterface(&m_ReadCallbackEx);
+	Callback.QueryInterface(&m_WriteCallbackEx);
+	Callback.QueryInterface(&m_ReadWriteCallbackEx);
+	Callback.QueryInterface(&m_GlitchCallback);
+	Callback.QueryInterface(&m_RateCallback);
 
 	EVENT_INIT(m_StartEvent, __LINE__);
 	EVENT_INIT(m_StopEvent, __LINE__);
@@ -64,6 +204,58 @@ HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback) {
 	EVENT_INIT(m_PropertyChangeEvent, __LINE__);
 	EVENT_INIT(m_WaitEvent, __LINE__);
 	EVENT_INIT(m_HaltEvent, __LINE__);
+	EVENT_INIT(m_InputDataEvent, __LINE__);
+	EVENT_INIT(m_OutputSpaceEvent, __LINE__);
+	EVENT_INIT(m_StandbyRequestEvent, __LINE__);
+	EVENT_INIT(m_StandbyReadyEvent, __LINE__);
+	EVENT_INIT(m_StandbyExitEvent, __LINE__);
+
+	//The closed event stays set once the thread exits, so it can't be auto-reset
+	m_ClosedEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	if (m_ClosedEvent == NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(GetLastError()));
+		return E_FAIL;
+	}
+
+	//Likewise the ready event, which any number of callers may wait on
+	m_ReadyEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	if (m_ReadyEvent == NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(GetLastError()));
+		return E_FAIL;
+	}
+
+	//The process timer is only armed by streams that poll their client (see SetProcessTimer())
+	m_ProcessTimer = CreateWaitableTimerW(NULL, FALSE, NULL);
+
+	if (m_ProcessTimer == NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(GetLastError()));
+		return E_FAIL;
+	}
+
+	m_SettleTimer = CreateWaitableTimerW(NULL, FALSE, NULL);
+
+	if (m_SettleTimer == NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(GetLastError()));
+		return E_FAIL;
+	}
+
+	//Allocate the ring buffers up front - the stream thread never allocates them
+	if (IsPushMode()) {
+		if (Type != DXAUDIO_STREAM_TYPE_OUTPUT) {
+			hr = m_InputRing.Initialize(m_Desc.BufferFrames); CHECK_HR(__LINE__);
+		}
+
+		if (Type != DXAUDIO_STREAM_TYPE_INPUT && Type != DXAUDIO_STREAM_TYPE_LOOPBACK) {
+			hr = m_OutputRing.Initialize(m_Desc.BufferFrames); CHECK_HR(__LINE__);
+		}
+	}
+
+	//Likewise for the re-blocking buffers
+	if (IsBlockMode() || (IsCoalesceMode() && Type == DXAUDIO_STREAM_TYPE_OUTPUT)) {
+		hr = InitializeBlocks(); CHECK_HR(__LINE__);
+	}
 
 	//Everything will happen on a separate thread
 	m_Thread = CreateThread (
@@ -90,7 +282,878 @@ HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback) {
 DWORD __stdcall CDXAudioStream::StaticStreamThreadEntry(LPVOID Data) {
 	CDXAudioStream* l_Stream = reinterpret_cast<CDXAudioStream*>(Data);
 
-	return l_Stream->StreamThreadEntry();
+	DWORD dwResult = l_Stream->StreamThreadEntry();
+
+	//If the thread gave up before opening the devices, nobody must be left waiting for it
+	l_Stream->SignalReady(FAILED(HRESULT(dwResult)) ? HRESULT(dwResult) : E_ABORT);
+
+	//Release anyone blocked in Read() or Write() - nothing will service the rings anymore
+	SetEvent(l_Stream->m_ClosedEvent);
+
+	return dwResult;
+}
+
+VOID CDXAudioStream::SignalReady(HRESULT hr) {
+	if (m_IsReady) {
+		return;
+	}
+
+	RecordFailure(hr);
+
+	m_IsReady = true;
+	SetEvent(m_ReadyEvent);
+}
+
+HRESULT CDXAudioStream::WaitForReady(DWORD Milliseconds) {
+	if (WaitForSingleObject(m_ReadyEvent, Milliseconds) != WAIT_OBJECT_0) {
+		return E_PENDING;
+	}
+
+	return m_InitResult;
+}
+
+DWORD __stdcall CDXAudioStream::StaticStandbyThreadEntry(LPVOID Data) {
+	return reinterpret_cast<CDXAudioStream*>(Data)->StandbyThreadEntry();
+}
+
+DWORD CDXAudioStream::StandbyThreadEntry() {
+	HANDLE Events[] = { m_StandbyExitEvent, m_StandbyRequestEvent };
+
+	//The device objects are free-threaded, so the stream thread's enumerator can be used from here
+	HRESULT hr = CoInitializeEx (
+		NULL,
+		COINIT_MULTITHREADED
+	);
+
+	while (WaitForMultipleObjects(ARRAYSIZE(Events), Events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		m_StandbyResult = ImplPrepareStandby();
+		SetEvent(m_StandbyReadyEvent);
+	}
+
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+HRESULT CDXAudioStream::Write(const FLOAT* AudioOut, UINT Frames, UINT* pFramesWritten, BOOL Blocking) {
+	HANDLE Events[] = { m_OutputSpaceEvent, m_ClosedEvent };
+	UINT FramesWritten = 0;
+	HRESULT hr = S_OK;
+
+	if (pFramesWritten != nullptr) {
+		*pFramesWritten = 0;
+	}
+
+	if (!m_OutputRing.IsInitialized()) {
+		return E_ILLEGAL_METHOD_CALL;
+	}
+
+	if (AudioOut == nullptr && Frames != 0) {
+		return E_POINTER;
+	}
+
+	while (true) {
+		FramesWritten += m_OutputRing.Write (
+			AudioOut + FramesWritten * 2,
+			Frames - FramesWritten
+		);
+
+		if (FramesWritten == Frames || !Blocking) {
+			break;
+		}
+
+		//Wait for the stream thread to consume something.  The event is latched, so a
+		//period that completes between Write() and the wait isn't lost.
+		if (WaitForMultipleObjects(2, Events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+			hr = E_ABORT;
+			break;
+		}
+	}
+
+	if (pFramesWritten != nullptr) {
+		*pFramesWritten = FramesWritten;
+	}
+
+	if (FAILED(hr)) return hr;
+
+	return (FramesWritten == Frames) ? S_OK : S_FALSE;
+}
+
+HRESULT CDXAudioStream::Read(FLOAT* AudioIn, UINT Frames, UINT* pFramesRead, BOOL Blocking) {
+	HANDLE Events[] = { m_InputDataEvent, m_ClosedEvent };
+	UINT FramesRead = 0;
+	HRESULT hr = S_OK;
+
+	if (pFramesRead != nullptr) {
+		*pFramesRead = 0;
+	}
+
+	if (!m_InputRing.IsInitialized()) {
+		return E_ILLEGAL_METHOD_CALL;
+	}
+
+	if (AudioIn == nullptr && Frames != 0) {
+		return E_POINTER;
+	}
+
+	while (true) {
+		FramesRead += m_InputRing.Read (
+			AudioIn + FramesRead * 2,
+			Frames - FramesRead
+		);
+
+		if (FramesRead == Frames || !Blocking) {
+			break;
+		}
+
+		//Wait for the stream thread to deliver the next period
+		if (WaitForMultipleObjects(2, Events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+			hr = E_ABORT;
+			break;
+		}
+	}
+
+	if (pFramesRead != nullptr) {
+		*pFramesRead = FramesRead;
+	}
+
+	if (FAILED(hr)) return hr;
+
+	return (FramesRead == Frames) ? S_OK : S_FALSE;
+}
+
+HRESULT CDXAudioStream::InitializeBlocks() {
+	const DXAUDIO_STREAM_TYPE Type = GetStreamType();
+	const UINT BlockFrames = m_Desc.BlockFrames;
+	UINT FifoFrames = 0;
+	HRESULT hr = S_OK;
+
+	//In native-rate mode, the rate isn't known yet and may change later, so leave room for the fastest endpoints
+	const FLOAT CapacityRate = IsNativeRateMode() && m_SampleRate < NATIVE_RATE_CEILING ? NATIVE_RATE_CEILING : m_SampleRate.load();
+
+	if (IsBlockMode()) {
+		//A FIFO has to hold a block's worth of frames plus whatever arrives in one period.  Periods are
+		//only known once the clients are initialized (and change on re-initialization), so leave room
+		//for half a second, which is far more than any shared-mode endpoint delivers at once.
+		m_BlockCapacity = BlockFrames;
+		FifoFrames = BlockFrames * 2 + (UINT)(CapacityRate / 2);
+	} else {
+		//A coalescing output stream generates a whole batch of periods at a time.  For the same reason
+		//as above, size the batch for periods of up to 50 ms.
+		m_BlockCapacity = m_Desc.CoalescePeriods * ((UINT)(CapacityRate / 20) + 1);
+		FifoFrames = m_BlockCapacity * 2;
+	}
+
+	const SIZE_T BlockSize = sizeof(FLOAT) * 2 * m_BlockCapacity;
+
+	m_BlockInput = (FLOAT*)(_aligned_malloc(BlockSize, CACHE_LINE_SIZE));
+	m_BlockOutput = (FLOAT*)(_aligned_malloc(BlockSize, CACHE_LINE_SIZE));
+
+	if (m_BlockInput == nullptr || m_BlockOutput == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	ZeroMemory(m_BlockInput, BlockSize);
+	ZeroMemory(m_BlockOutput, BlockSize);
+
+	if (Type != DXAUDIO_STREAM_TYPE_OUTPUT) {
+		hr = m_BlockInputFifo.Initialize(FifoFrames);
+		if (FAILED(hr)) return hr;
+	}
+
+	if (Type != DXAUDIO_STREAM_TYPE_INPUT && Type != DXAUDIO_STREAM_TYPE_LOOPBACK) {
+		hr = m_BlockOutputFifo.Initialize(FifoFrames);
+		if (FAILED(hr)) return hr;
+	}
+
+	//A duplex stream can only produce output once a full block of input has arrived, so the output
+	//starts one block of silence ahead.  From then on, the frames waiting in the two FIFOs always
+	//add up to one block plus the current period, so the output FIFO never runs dry.
+	if (IsBlockMode() && (Type == DXAUDIO_STREAM_TYPE_DUPLEX || Type == DXAUDIO_STREAM_TYPE_ECHO)) {
+		m_BlockOutputFifo.Write(m_BlockOutput, BlockFrames);
+	}
+
+	return S_OK;
+}
+
+VOID CDXAudioStream::SetProcessTimer(REFERENCE_TIME Interval) {
+	LARGE_INTEGER DueTime;
+
+	m_TimerInterval = Interval;
+
+	//Negative due times are relative, in 100-nanosecond units; the period is in milliseconds
+	DueTime.QuadPart = -Interval;
+
+	SetWaitableTimer (
+		m_ProcessTimer,
+		&DueTime,
+		(LONG)((Interval + 9999) / 10000),
+		NULL,
+		NULL,
+		FALSE
+	);
+}
+
+VOID CDXAudioStream::SetEndpointInfo(bool IsInput, const DXAUDIO_ENDPOINT_INFO& Info, LPCWSTR DeviceID) {
+	AcquireSRWLockExclusive(&m_StreamInfoLock);
+
+	if (IsInput) {
+		m_StreamInfo.Input = Info;
+		m_InputDeviceID = DeviceID;
+	} else {
+		m_StreamInfo.Output = Info;
+		m_OutputDeviceID = DeviceID;
+	}
+
+	ReleaseSRWLockExclusive(&m_StreamInfoLock);
+
+	m_EndpointInfoUpdates++;
+}
+
+bool CDXAudioStream::UpdateSampleRate(FLOAT SampleRate) {
+	const FLOAT OldSampleRate = m_SampleRate;
+
+	if (!IsNativeRateMode() || SampleRate == OldSampleRate) {
+		return false;
+	}
+
+	m_SampleRate = SampleRate;
+
+	//The rate the stream first opens at isn't a change - the application can ask GetSampleRate() once it's ready
+	if (!m_IsReady) {
+		return false;
+	}
+
+	if (m_RateCallback != nullptr) {
+		m_RateCallback->OnSampleRateChanged(OldSampleRate, SampleRate);
+	}
+
+	return true;
+}
+
+HRESULT CDXAudioStream::GetEndpoint(EDataFlow Flow, IMMDevice** ppDevice) {
+	LPCWSTR DeviceID = GetChosenEndpoint(Flow);
+
+	if (DeviceID == nullptr) {
+		return m_Enumerator->GetDefaultAudioEndpoint (
+			Flow,
+			eConsole,
+			ppDevice
+		);
+	}
+
+	//Simulated endpoints are only known to the stream's own enumerator
+	if (m_Desc.pSimulatedDevice != nullptr) {
+		return m_Enumerator->GetDevice (
+			DeviceID,
+			ppDevice
+		);
+	}
+
+	return EndpointCache::GetDevice(m_Enumerator, DeviceID, ppDevice);
+}
+
+REFERENCE_TIME CDXAudioStream::GetExpectedInterval() {
+	REFERENCE_TIME Interval = m_TimerInterval;
+
+	//Only the stream thread writes the stream info, so it doesn't need the lock to read it
+	if (Interval == 0) {
+		const DXAUDIO_ENDPOINT_INFO* Endpoints[] = { &m_StreamInfo.Input, &m_StreamInfo.Output };
+
+		for (UINT i = 0; i < ARRAYSIZE(Endpoints); i++) {
+			if (Endpoints[i]->SampleRate != 0) {
+				const REFERENCE_TIME Period = REFERENCE_TIME(Endpoints[i]->PeriodFrames) * 10000000 / Endpoints[i]->SampleRate;
+
+				if (Interval == 0 || Period < Interval) {
+					Interval = Period;
+				}
+			}
+		}
+	}
+
+	return Interval;
+}
+
+VOID CDXAudioStream::HandleChange(bool IsDeviceChange) {
+	const LONGLONG Start = StreamPerformance::GetTicks();
+	const LONGLONG Notified = m_ChangeNotifiedTicks.exchange(0);
+	const UINT Updates = m_EndpointInfoUpdates;
+
+	StreamTracer::Begin(TRACE_SPAN_REINITIALIZE);
+
+	if (IsDeviceChange) {
+		ImplDeviceChange();
+	} else {
+		ImplPropertyChange();
+	}
+
+	StreamTracer::End(TRACE_SPAN_REINITIALIZE);
+
+	//Most notifications concern some other device, and nothing is re-opened
+	if (m_EndpointInfoUpdates != Updates) {
+		m_Performance.OnReinitialize(StreamPerformance::GetTicks() - Start);
+		m_RecoveryStart = Notified != 0 ? Notified : Start;
+	}
+
+	m_Performance.RestartWakeups();
+}
+
+VOID CDXAudioStream::OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) {
+	if (NotificationHub::IsRelevantRole(Role) && UsesFlow(Flow) && GetChosenEndpoint(Flow) == nullptr) {
+		OnChangeNotified();
+		SetEvent(m_DeviceChangeEvent);
+	}
+}
+
+VOID CDXAudioStream::OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY& Key) {
+	bool IsOwnDevice = false;
+
+	if (!NotificationHub::IsRelevantProperty(Key)) {
+		return;
+	}
+
+	AcquireSRWLockShared(&m_StreamInfoLock);
+	IsOwnDevice = (DeviceID != nullptr && (m_InputDeviceID == DeviceID || m_OutputDeviceID == DeviceID)) ||
+		(m_InputDeviceID.empty() && m_OutputDeviceID.empty()); //Nothing is open yet, so it can't be ruled out
+	ReleaseSRWLockShared(&m_StreamInfoLock);
+
+	if (IsOwnDevice) {
+		OnChangeNotified();
+		SetEvent(m_PropertyChangeEvent);
+	}
+}
+
+VOID CDXAudioStream::OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) {
+	bool IsOwnDevice = false;
+
+	if (!NotificationHub::IsRelevantState(State) || DeviceID == nullptr) {
+		return;
+	}
+
+	//A chosen endpoint that wasn't present when the stream opened it never got as far as being recorded as in use
+	AcquireSRWLockShared(&m_StreamInfoLock);
+	IsOwnDevice = m_InputDeviceID == DeviceID || m_OutputDeviceID == DeviceID ||
+		m_ChosenInputID == DeviceID || m_ChosenOutputID == DeviceID;
+	ReleaseSRWLockShared(&m_StreamInfoLock);
+
+	if (IsOwnDevice) {
+		OnChangeNotified();
+		SetEvent(m_PropertyChangeEvent);
+	}
+}
+
+VOID CDXAudioStream::DeferChange(bool IsDeviceChange) {
+	LARGE_INTEGER DueTime;
+
+	if (!m_IsDeviceChangeDeferred && !m_IsPropertyChangeDeferred) {
+		DueTime.QuadPart = -CHANGE_SETTLE_TIME; //Relative
+
+		SetWaitableTimer (
+			m_SettleTimer,
+			&DueTime,
+			0,
+			NULL,
+			NULL,
+			FALSE
+		);
+	}
+
+	if (IsDeviceChange) {
+		m_IsDeviceChangeDeferred = true;
+	} else {
+		m_IsPropertyChangeDeferred = true;
+	}
+}
+
+VOID CDXAudioStream::HandleDeferredChanges() {
+	//A new default device is opened from scratch anyway, so the property check comes after it
+	if (m_IsDeviceChangeDeferred) {
+		m_IsDeviceChangeDeferred = false;
+
+		if (m_StandbyThread != NULL) {
+			RequestStandby();
+		} else {
+			HandleChange(true);
+		}
+	}
+
+	if (m_IsPropertyChangeDeferred) {
+		m_IsPropertyChangeDeferred = false;
+		HandleChange(false);
+	}
+}
+
+VOID CDXAudioStream::RequestStandby() {
+	const LONGLONG Notified = m_ChangeNotifiedTicks.exchange(0);
+
+	//Recovery is timed from the first of the notifications that led to the switch
+	if (m_StandbyNotified == 0) {
+		m_StandbyNotified = Notified != 0 ? Notified : StreamPerformance::GetTicks();
+	}
+
+	if (m_IsStandbyBusy) {
+		m_IsStandbyPending = true;
+	} else {
+		m_IsStandbyBusy = true;
+		SetEvent(m_StandbyRequestEvent);
+	}
+}
+
+VOID CDXAudioStream::HandleStandby() {
+	const LONGLONG Start = StreamPerformance::GetTicks();
+	const UINT Updates = m_EndpointInfoUpdates;
+
+	m_IsStandbyBusy = false;
+
+	StreamTracer::Begin(TRACE_SPAN_REINITIALIZE);
+
+	if (m_StandbyResult == S_OK) {
+		ImplSwapStandby();
+	} else if (m_StandbyResult == AUDCLNT_E_DEVICE_INVALIDATED) {
+		ImplDeviceChange();
+	} else if (FAILED(m_StandbyResult)) {
+		m_Callback->OnObjectFailure(m_StandbyFailureFile, m_StandbyFailureLine, m_StandbyResult);
+		RecordFailure(m_StandbyResult);
+		Halt();
+	}
+
+	StreamTracer::End(TRACE_SPAN_REINITIALIZE);
+
+	if (m_EndpointInfoUpdates != Updates) {
+		if (m_StandbyResult == S_OK) {
+			m_Performance.OnStandbySwitch(StreamPerformance::GetTicks() - Start);
+		} else {
+			m_Performance.OnReinitialize(StreamPerformance::GetTicks() - Start);
+		}
+
+		m_RecoveryStart = m_StandbyNotified;
+	}
+
+	m_StandbyNotified = 0;
+	m_Performance.RestartWakeups();
+
+	//The default may have changed again while the standby thread was busy
+	if (m_IsStandbyPending) {
+		m_IsStandbyPending = false;
+		RequestStandby();
+	}
+}
+
+VOID CDXAudioStream::ApplyFadeIn(FLOAT* Buffer, UINT Frames, bool IsSilent) {
+	UINT i = 0;
+
+	for (; i < Frames && m_FadePosition < m_FadeFrames; i++, m_FadePosition++) {
+		if (!IsSilent) {
+			const FLOAT Gain = FLOAT(m_FadePosition) / FLOAT(m_FadeFrames);
+
+			Buffer[i * 2] *= Gain;
+			Buffer[i * 2 + 1] *= Gain;
+		}
+	}
+}
+
+VOID CDXAudioStream::ProcessOfflinePeriod() {
+	const LONGLONG Start = StreamPerformance::GetTicks();
+	const REFERENCE_TIME Interval = GetExpectedInterval();
+
+	//The simulated endpoints move on by exactly one period, which is then processed straight away - there's no
+	//wakeup to measure, so only the time taken is recorded
+	m_AllocationTracker.BeginPeriod();
+	m_Statistics.OnWakeup();
+	m_OfflineRenderer.AdvancePeriod();
+	StreamTracer::Begin(TRACE_SPAN_PERIOD);
+	ImplProcess();
+	StreamTracer::End(TRACE_SPAN_PERIOD);
+	m_Performance.OnPeriodEnd(Start, Interval);
+	m_Performance.OnOfflinePeriod(StreamPerformance::GetTicks() - Start, Interval);
+	EndRecovery();
+	m_AllocationTracker.EndPeriod();
+}
+
+VOID CDXAudioStream::GetStreamInfo(DXAUDIO_STREAM_INFO* pInfo) {
+	if (pInfo == nullptr) {
+		return;
+	}
+
+	AcquireSRWLockShared(&m_StreamInfoLock);
+	*pInfo = m_StreamInfo;
+	ReleaseSRWLockShared(&m_StreamInfoLock);
+}
+
+UINT CDXAudioStream::GetAddedLatency() {
+	if (IsBlockMode()) {
+		return m_Desc.BlockFrames;
+	} else if (IsCoalesceMode()) {
+		return m_LastBatchFrames.load(std::memory_order_relaxed);
+	}
+
+	return 0;
+}
+
+VOID CDXAudioStream::ProcessInput(FLOAT* AudioIn, UINT Frames, bool IsSilent) {
+	if (IsPushMode()) {
+		//Queue the data for the application to pick up with Read()
+		PushInput(AudioIn, Frames);
+	} else if (IsBlockMode()) {
+		const UINT BlockFrames = m_Desc.BlockFrames;
+		INT64 InputOffset = -INT64(m_BlockInputFifo.GetReadAvailable()); //Leftovers from earlier periods come first
+
+		m_BlockInputFifo.Write(AudioIn, Frames);
+
+		//Deliver every complete block
+		while (m_BlockInputFifo.GetReadAvailable() >= BlockFrames) {
+			m_BlockInputFifo.Read(m_BlockInput, BlockFrames);
+
+			CallRead (
+				m_BlockInput,
+				BlockFrames,
+				InputOffset,
+				false
+			);
+
+			InputOffset += BlockFrames;
+		}
+	} else {
+		//Send the data straight to the application.  When coalescing, the client reader has
+		//already gathered and resampled a whole batch of periods.
+		CallRead (
+			AudioIn,
+			Frames,
+			0,
+			IsSilent
+		);
+
+		m_LastBatchFrames.store(Frames, std::memory_order_relaxed);
+	}
+}
+
+bool CDXAudioStream::ProcessOutput(FLOAT* AudioOut, UINT Frames) {
+	LARGE_INTEGER StartTime;
+	bool IsSilent = false;
+
+	QueryPerformanceCounter(&StartTime);
+
+	if (IsPushMode()) {
+		//Take the output data the application has queued with Write()
+		PullOutput(AudioOut, Frames);
+	} else if (IsBlockMode()) {
+		const UINT BlockFrames = m_Desc.BlockFrames;
+
+		//Generate whole blocks until there's enough to cover this period
+		while (m_BlockOutputFifo.GetReadAvailable() < Frames) {
+			//A block marked silent is queued as zeros, since it shares the FIFO with blocks that aren't
+			const bool IsBlockSilent = CallWrite (
+				m_BlockOutput,
+				BlockFrames,
+				m_BlockOutputFifo.GetReadAvailable()
+			);
+
+			if (IsBlockSilent) {
+				ZeroMemory(m_BlockOutput, sizeof(FLOAT) * 2 * BlockFrames);
+			}
+
+			m_BlockOutputFifo.Write(m_BlockOutput, BlockFrames);
+		}
+
+		m_BlockOutputFifo.Read(AudioOut, Frames);
+	} else if (IsCoalesceMode()) {
+		//Generate a whole batch of periods whenever the previous one runs out
+		if (m_BlockOutputFifo.GetReadAvailable() < Frames) {
+			UINT BatchFrames = Frames * m_Desc.CoalescePeriods;
+
+			if (BatchFrames > m_BlockCapacity) {
+				BatchFrames = m_BlockCapacity;
+			}
+
+			const bool IsBlockSilent = CallWrite (
+				m_BlockOutput,
+				BatchFrames,
+				m_BlockOutputFifo.GetReadAvailable()
+			);
+
+			if (IsBlockSilent) {
+				ZeroMemory(m_BlockOutput, sizeof(FLOAT) * 2 * BatchFrames);
+			}
+
+			m_BlockOutputFifo.Write(m_BlockOutput, BatchFrames);
+			m_LastBatchFrames.store(BatchFrames, std::memory_order_relaxed);
+		}
+
+		UINT FramesRead = m_BlockOutputFifo.Read(AudioOut, Frames);
+
+		//Only possible if a period is longer than the batch was sized for
+		if (FramesRead < Frames) {
+			ZeroMemory(AudioOut + FramesRead * 2, sizeof(FLOAT) * 2 * (Frames - FramesRead));
+		}
+	} else {
+		//Get the application to generate new output data
+		IsSilent = CallWrite (
+			AudioOut,
+			Frames,
+			0
+		);
+	}
+
+	EndProcessTiming(StartTime);
+
+	return IsSilent;
+}
+
+bool CDXAudioStream::ProcessDuplex(FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames, bool IsSilent) {
+	LARGE_INTEGER StartTime;
+	bool IsOutputSilent = false;
+
+	QueryPerformanceCounter(&StartTime);
+
+	if (IsPushMode()) {
+		//Queue the input for Read() and take the output queued by Write()
+		PushInput(AudioIn, Frames);
+		PullOutput(AudioOut, Frames);
+	} else if (IsBlockMode()) {
+		const UINT BlockFrames = m_Desc.BlockFrames;
+		INT64 InputOffset = -INT64(m_BlockInputFifo.GetReadAvailable());
+
+		m_BlockInputFifo.Write(AudioIn, Frames);
+
+		//Process every complete block, queueing its output behind the silence primed in InitializeBlocks()
+		while (m_BlockInputFifo.GetReadAvailable() >= BlockFrames) {
+			m_BlockInputFifo.Read(m_BlockInput, BlockFrames);
+
+			const bool IsBlockSilent = CallReadWrite (
+				m_BlockInput,
+				m_BlockOutput,
+				BlockFrames,
+				InputOffset,
+				m_BlockOutputFifo.GetReadAvailable(),
+				false
+			);
+
+			if (IsBlockSilent) {
+				ZeroMemory(m_BlockOutput, sizeof(FLOAT) * 2 * BlockFrames);
+			}
+
+			InputOffset += BlockFrames;
+
+			m_BlockOutputFifo.Write(m_BlockOutput, BlockFrames);
+		}
+
+		UINT FramesRead = m_BlockOutputFifo.Read(AudioOut, Frames);
+
+		//Only possible if the FIFOs overflowed - play silence rather than garbage
+		if (FramesRead < Frames) {
+			ZeroMemory(AudioOut + FramesRead * 2, sizeof(FLOAT) * 2 * (Frames - FramesRead));
+		}
+	} else {
+		//Give the application the input data and tell it to generate output
+		IsOutputSilent = CallReadWrite (
+			AudioIn,
+			AudioOut,
+			Frames,
+			0,
+			0,
+			IsSilent
+		);
+	}
+
+	EndProcessTiming(StartTime);
+
+	return IsOutputSilent;
+}
+
+VOID CDXAudioStream::EndProcessTiming(const LARGE_INTEGER& StartTime) {
+	LARGE_INTEGER EndTime;
+
+	QueryPerformanceCounter(&EndTime);
+
+	//Convert from performance counter ticks to 100-nanosecond units
+	m_LastProcessTime = (REFERENCE_TIME)((EndTime.QuadPart - StartTime.QuadPart) * 10000000 / m_PerformanceFrequency.QuadPart);
+}
+
+VOID CDXAudioStream::ReportGlitch(DXAUDIO_GLITCH_TYPE Type) {
+	DXAUDIO_GLITCH_EVENT Event;
+	LARGE_INTEGER Now;
+
+	QueryPerformanceCounter(&Now);
+
+	//Convert to 100-nanosecond units in two parts, so that a long uptime can't overflow the multiplication
+	Event.Type = Type;
+	Event.Time = UINT64(Now.QuadPart / m_PerformanceFrequency.QuadPart) * 10000000 +
+		UINT64(Now.QuadPart % m_PerformanceFrequency.QuadPart) * 10000000 / m_PerformanceFrequency.QuadPart;
+	Event.FramePosition = m_FramePosition;
+
+	m_Statistics.OnGlitch(Event);
+
+	if (m_GlitchCallback != nullptr) {
+		m_AllocationTracker.Pause();
+		m_GlitchCallback->OnGlitch(&Event);
+		m_AllocationTracker.Resume();
+	}
+}
+
+VOID CDXAudioStream::GetPeriodInfo(DXAUDIO_PERIOD_INFO* pInfo, INT64 InputOffset, UINT OutputQueued) {
+	const DOUBLE SampleRate = DOUBLE(m_SampleRate);
+
+	pInfo->FramePosition = m_FramePosition;
+	pInfo->Flags = 0;
+
+	//Offsets are counted at the stream's rate, so they're scaled to the endpoint's rate (and to time) here
+	if (m_InputDeviceRate != 0) {
+		const INT64 InputPosition = INT64(m_Timing.InputDevicePosition) + (INT64)(floor(DOUBLE(InputOffset) * m_InputDeviceRate / SampleRate));
+
+		pInfo->InputDevicePosition = InputPosition > 0 ? UINT64(InputPosition) : 0;
+		pInfo->InputTime = m_Timing.InputTime != 0 ? m_Timing.InputTime + (INT64)(DOUBLE(InputOffset) * 10000000 / SampleRate) : 0;
+	} else {
+		pInfo->InputDevicePosition = 0;
+		pInfo->InputTime = 0;
+	}
+
+	if (m_OutputDeviceRate != 0) {
+		pInfo->OutputDevicePosition = m_Timing.OutputDevicePosition + (UINT64)(DOUBLE(OutputQueued) * m_OutputDeviceRate / SampleRate);
+		pInfo->OutputTime = m_Timing.OutputTime != 0 ? m_Timing.OutputTime + (UINT64)(DOUBLE(OutputQueued) * 10000000 / SampleRate) : 0;
+	} else {
+		pInfo->OutputDevicePosition = 0;
+		pInfo->OutputTime = 0;
+	}
+}
+
+VOID CDXAudioStream::CallRead(FLOAT* AudioIn, UINT Frames, INT64 InputOffset, bool IsSilent) {
+	DXAUDIO_PERIOD_INFO Info;
+	LONGLONG Start = 0;
+
+	m_AllocationTracker.Pause();
+	Start = StreamPerformance::GetTicks();
+	StreamTracer::Begin(TRACE_SPAN_CALLBACK);
+
+	if (m_ReadCallbackEx != nullptr) {
+		GetPeriodInfo(&Info, InputOffset, 0);
+
+		//A loopback stream also renders silence, but that's of no interest to the application
+		Info.OutputDevicePosition = 0;
+		Info.OutputTime = 0;
+
+		if (IsSilent) {
+			Info.Flags |= DXAUDIO_PERIOD_FLAG_SILENT_INPUT;
+		}
+
+		m_ReadCallbackEx->OnProcessEx (
+			m_SampleRate,
+			AudioIn,
+			Frames,
+			&Info
+		);
+	} else {
+		m_ReadCallback->OnProcess (
+			m_SampleRate,
+			AudioIn,
+			Frames
+		);
+	}
+
+	StreamTracer::End(TRACE_SPAN_CALLBACK);
+	m_Performance.OnCallback(StreamPerformance::GetTicks() - Start);
+	m_AllocationTracker.Resume();
+
+	m_FramePosition += Frames;
+}
+
+bool CDXAudioStream::CallWrite(FLOAT* AudioOut, UINT Frames, UINT OutputQueued) {
+	DXAUDIO_PERIOD_INFO Info;
+	LONGLONG Start = 0;
+	bool IsSilent = false;
+
+	m_AllocationTracker.Pause();
+	Start = StreamPerformance::GetTicks();
+	StreamTracer::Begin(TRACE_SPAN_CALLBACK);
+
+	if (m_WriteCallbackEx != nullptr) {
+		GetPeriodInfo(&Info, 0, OutputQueued);
+
+		m_WriteCallbackEx->OnProcessEx (
+			m_SampleRate,
+			AudioOut,
+			Frames,
+			&Info
+		);
+
+		IsSilent = (Info.Flags & DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT) != 0;
+	} else {
+		m_WriteCallback->OnProcess (
+			m_SampleRate,
+			AudioOut,
+			Frames
+		);
+	}
+
+	StreamTracer::End(TRACE_SPAN_CALLBACK);
+	m_Performance.OnCallback(StreamPerformance::GetTicks() - Start);
+	m_AllocationTracker.Resume();
+
+	m_FramePosition += Frames;
+
+	return IsSilent;
+}
+
+bool CDXAudioStream::CallReadWrite(FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames, INT64 InputOffset, UINT OutputQueued, bool IsSilent) {
+	DXAUDIO_PERIOD_INFO Info;
+	LONGLONG Start = 0;
+	bool IsOutputSilent = false;
+
+	m_AllocationTracker.Pause();
+	Start = StreamPerformance::GetTicks();
+	StreamTracer::Begin(TRACE_SPAN_CALLBACK);
+
+	if (m_ReadWriteCallbackEx != nullptr) {
+		GetPeriodInfo(&Info, InputOffset, OutputQueued);
+
+		if (IsSilent) {
+			Info.Flags |= DXAUDIO_PERIOD_FLAG_SILENT_INPUT;
+		}
+
+		m_ReadWriteCallbackEx->OnProcessEx (
+			m_SampleRate,
+			AudioIn,
+			AudioOut,
+			Frames,
+			&Info
+		);
+
+		IsOutputSilent = (Info.Flags & DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT) != 0;
+	} else {
+		m_ReadWriteCallback->OnProcess (
+			m_SampleRate,
+			AudioIn,
+			AudioOut,
+			Frames
+		);
+	}
+
+	StreamTracer::End(TRACE_SPAN_CALLBACK);
+	m_Performance.OnCallback(StreamPerformance::GetTicks() - Start);
+	m_AllocationTracker.Resume();
+
+	m_FramePosition += Frames;
+
+	return IsOutputSilent;
+}
+
+VOID CDXAudioStream::PullOutput(FLOAT* AudioOut, UINT Frames) {
+	UINT FramesRead = m_OutputRing.Read(AudioOut, Frames);
+
+	//Underrun - whatever the application hasn't written yet is played as silence
+	if (FramesRead < Frames) {
+		ZeroMemory(AudioOut + FramesRead * 2, sizeof(FLOAT) * 2 * (Frames - FramesRead));
+	}
+
+	SetEvent(m_OutputSpaceEvent);
+}
+
+VOID CDXAudioStream::PushInput(const FLOAT* AudioIn, UINT Frames) {
+	//Overrun - if the application isn't keeping up, the newest frames are dropped
+	m_InputRing.Write(AudioIn, Frames);
+
+	SetEvent(m_InputDataEvent);
 }
 
 DWORD CDXAudioStream::StreamThreadEntry() {
@@ -103,7 +1166,10 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 		m_DeviceChangeEvent,
 		m_PropertyChangeEvent,
 		m_WaitEvent,
-		m_HaltEvent
+		m_ProcessTimer,
+		m_HaltEvent,
+		m_StandbyReadyEvent,
+		m_SettleTimer
 	};
 
 	bool StreamRunning = false;
@@ -113,7 +1179,10 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 	static const DWORD SM_DEVICECHANGE = WAIT_OBJECT_0 + 2;
 	static const DWORD SM_PROPERTYCHANGE = WAIT_OBJECT_0 + 3;
 	static const DWORD SM_PROCESS = WAIT_OBJECT_0 + 4;
-	static const DWORD SM_CLOSE = WAIT_OBJECT_0 + 5;
+	static const DWORD SM_TIMER = WAIT_OBJECT_0 + 5;
+	static const DWORD SM_CLOSE = WAIT_OBJECT_0 + 6;
+	static const DWORD SM_STANDBY = WAIT_OBJECT_0 + 7;
+	static const DWORD SM_SETTLE = WAIT_OBJECT_0 + 8;
 
 	static const UINT nEvents = sizeof(Events) / sizeof(HANDLE);
 
@@ -126,56 +1195,122 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 
 	m_Callback->OnThreadInit();
 
-	//Create the device enumerator
-	hr = CoCreateInstance (
-		__uuidof(MMDeviceEnumerator),
-		NULL,
-		CLSCTX_ALL,
-		__uuidof(IMMDeviceEnumerator),
-		(void**)(&m_Enumerator)
-	); CHECK_HR(__LINE__);
-
 	CMMNotificationClient NotificationClient(*this);
 
-	//Register the callback for default device / property changes
-	hr = m_Enumerator->RegisterEndpointNotificationCallback (
-		&NotificationClient
-	); CHECK_HR(__LINE__);
+	//Get the device enumerator and register for default device / property changes - a simulated stream gets an
+	//enumerator that hands out simulated endpoints, and everything from here on runs the same either way.  Streams on
+	//the system's devices share the hub's enumerator and registration, so creating many at once doesn't serialize
+	//on creating their own.
+	if (m_Desc.pSimulatedDevice != nullptr) {
+		m_Enumerator.Attach(new CSimulatedDeviceEnumerator(*m_Desc.pSimulatedDevice, IsOfflineMode() ? &m_OfflineRenderer : nullptr));
+
+		hr = m_Enumerator->RegisterEndpointNotificationCallback (
+			&NotificationClient
+		); CHECK_HR(__LINE__);
+	} else {
+		hr = NotificationHub::Subscribe(this);
+		CHECK_HR(__LINE__);
+
+		hr = NotificationHub::GetEnumerator(&m_Enumerator);
 
-	//Initialize the child object
+		if (FAILED(hr)) {
+			NotificationHub::Unsubscribe(this);
+			m_Callback->OnObjectFailure(FILENAME, __LINE__, hr);
+			return hr;
+		}
+	}
+
+	//Initialize the child object - failures halt the stream, after recording what went wrong with RecordFailure()
 	ImplInitialize();
 
+	if (WaitForSingleObject(m_HaltEvent, 0) == WAIT_OBJECT_0) {
+		SetEvent(m_HaltEvent); //Put the message back for the loop below
+		SignalReady(E_FAIL);
+	} else {
+		SignalReady(S_OK);
+	}
+
+	//In standby mode, new default devices are opened on a thread of their own - without it, they're opened here as usual
+	if (IsStandbyMode()) {
+		m_StandbyThread = CreateThread (
+			NULL,
+			0,
+			StaticStandbyThreadEntry,
+			this,
+			NULL,
+			NULL
+		);
+	}
+
 	hr = S_OK;
 
+	//Give this thread a trace ring (does nothing unless DXAUDIO_TRACE is defined)
+	StreamTracer::RegisterThread();
+
 	while (run) {
-		//Wait for a message (event)
+		//Wait for a message (event) - a running offline stream only checks for one between periods
 		dwResult = WaitForMultipleObjectsEx (
 			nEvents,
 			Events,
 			FALSE,
-			INFINITE,
+			m_IsOfflineRunning ? 0 : INFINITE,
 			FALSE
 		);
 
 		switch (dwResult) {
-			case SM_PROCESS: { //Process
+			case WAIT_TIMEOUT: { //Process (offline)
+				ProcessOfflinePeriod();
+			} break;
+
+			case SM_PROCESS: //Process
+			case SM_TIMER: { //Process (polled client)
+				const LONGLONG WakeupTicks = StreamPerformance::GetTicks();
+				const REFERENCE_TIME Interval = GetExpectedInterval();
+
+				m_AllocationTracker.BeginPeriod();
+				m_Statistics.OnWakeup();
+				m_Performance.OnWakeup(WakeupTicks, Interval);
+				StreamTracer::Begin(TRACE_SPAN_PERIOD);
 				ImplProcess();
+				StreamTracer::End(TRACE_SPAN_PERIOD);
+				m_Performance.OnPeriodEnd(WakeupTicks, Interval);
+				EndRecovery();
+				m_AllocationTracker.EndPeriod();
 			} break;
 
 			case SM_START: { //Start the stream
 				ImplStart();
+				m_Performance.RestartWakeups();
+				m_AllocationTracker.Rearm();
+
+				m_IsOfflineRunning = IsOfflineMode();
+				m_RecoveryStart = 0;
 			} break;
 
 			case SM_STOP: { //Stop the stream
 				ImplStop();
+				m_Performance.RestartWakeups();
+
+				m_IsOfflineRunning = false;
+				m_RecoveryStart = 0;
+			} break;
+
+			case SM_DEVICECHANGE: { //The default device has changed on a flow the stream uses
+				DeferChange(true);
+			} break;
+
+			case SM_STANDBY: { //The standby thread has prepared the new default device
+				HandleStandby();
+				m_AllocationTracker.Rearm();
 			} break;
 
-			case SM_DEVICECHANGE: { //The default device has changed somewhere
-				ImplDeviceChange();
+			case SM_PROPERTYCHANGE: { //The format of one of the stream's devices has changed
+				DeferChange(false);
 			} break;
 
-			case SM_PROPERTYCHANGE: { //A property has changed somewhere
-				ImplPropertyChange();
+			case SM_SETTLE: { //The burst of notifications is over
+				HandleDeferredChanges();
+				m_AllocationTracker.Rearm();
 			} break;
 
 			case SM_CLOSE: { //Close the stream
@@ -189,10 +1324,24 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 		}
 	}
 
+	StreamTracer::UnregisterThread();
+
+	//Wait for any standby preparation to finish before the endpoints are released
+	if (m_StandbyThread != NULL) {
+		SetEvent(m_StandbyExitEvent);
+		WaitForSingleObject(m_StandbyThread, INFINITE);
+		CloseHandle(m_StandbyThread);
+		m_StandbyThread = NULL;
+	}
+
 	// Prevent any more notifications
-	m_Enumerator->UnregisterEndpointNotificationCallback (
-		&NotificationClient
-	);
+	if (m_Desc.pSimulatedDevice != nullptr) {
+		m_Enumerator->UnregisterEndpointNotificationCallback (
+			&NotificationClient
+		);
+	} else {
+		NotificationHub::Unsubscribe(this);
+	}
 
 	return hr;
 }
\ No newline at end of file
@@ -26,8 +26,20 @@
 #include <comdef.h>
 #include <atlbase.h>
 #include <mmdeviceapi.h>
+#include <string>
+#include <atomic>
 #include "CMMNotificationClientListener.h"
 #include "QueryInterface.h"
+#include "RingBuffer.h"
+#include "StreamStatistics.h"
+#include "StreamPerformance.h"
+#include "StreamArena.h"
+#include "AllocationTracker.h"
+#include "StreamTracer.h"
+#include "OfflineRenderer.h"
+
+//The IID of IDXAudioStream while it only went up to GetStreamType()
+static const GUID IID_IDXAudioStreamV1 = { 0x58127943, 0x2ecc, 0x4e74, { 0x84, 0x5b, 0xe4, 0x93, 0x32, 0x63, 0xa8, 0x80 } };
 
 /* This is the base class for all streams - it handles threading issues */
 class CDXAudioStream abstract : public IDXAudioStream, public CMMNotificationClientListener {
@@ -59,9 +71,167 @@ public:
 		SetEvent(m_HaltEvent);
 	}
 
+	/* Records [hr] as the reason the stream couldn't open its devices, for WaitForReady() - does nothing once the
+	** stream is ready, or if a failure has already been recorded (stream thread only) */
+	VOID RecordFailure(HRESULT hr) {
+		if (!m_IsReady && SUCCEEDED(m_InitResult)) {
+			m_InitResult = hr;
+		}
+	}
+
+	/* Keeps a note of where ImplPrepareStandby() failed, so that HandleStandby() can report it to the application
+	** on the stream thread, and returns [hr] (standby thread only) */
+	HRESULT NoteStandbyFailure(LPCWSTR File, UINT Line, HRESULT hr) {
+		m_StandbyFailureFile = File;
+		m_StandbyFailureLine = Line;
+		return hr;
+	}
+
+	/* Returns the counters reported by GetStatistics(), for the client reader/writer to update */
+	StreamStatistics& GetStreamStatistics() {
+		return m_Statistics;
+	}
+
+	/* Records how the input ([IsInput] true) or output side was set up, for GetStreamInfo(), and the ID of the device
+	** it was opened on, for telling which notifications concern the stream - called by the client reader/writer
+	** whenever they initialize */
+	VOID SetEndpointInfo(bool IsInput, const DXAUDIO_ENDPOINT_INFO& Info, LPCWSTR DeviceID);
+
+	/* Returns the measurements reported by GetPerformance(), for the client reader/writer to update */
+	StreamPerformance& GetStreamPerformance() {
+		return m_Performance;
+	}
+
+	/* Records a glitch of type [Type] in the statistics and notifies the application if it asked to be -
+	** called by the client reader/writer on the stream thread */
+	VOID ReportGlitch(DXAUDIO_GLITCH_TYPE Type);
+
+	/* Records the capture endpoint position and time of the first frame the client reader has just returned,
+	** for the extended callbacks.  [Time] is zero if unknown, and [DeviceRate] is the endpoint's sample rate. */
+	VOID SetCaptureTiming(UINT64 DevicePosition, UINT64 Time, UINT DeviceRate) {
+		m_Timing.InputDevicePosition = DevicePosition;
+		m_Timing.InputTime = Time;
+		m_InputDeviceRate = DeviceRate;
+	}
+
+	/* Records the estimated render endpoint position and presentation time of the next frame the client writer
+	** will be given, for the extended callbacks */
+	VOID SetPresentationTiming(UINT64 DevicePosition, UINT64 Time, UINT DeviceRate) {
+		m_Timing.OutputDevicePosition = DevicePosition;
+		m_Timing.OutputTime = Time;
+		m_OutputDeviceRate = DeviceRate;
+	}
+
+	/* Returns how long the most recent ProcessOutput() or ProcessDuplex() call took, in 100-nanosecond
+	** units.  The client writer compares this against the device period to judge the callback's load. */
+	REFERENCE_TIME GetLastProcessTime() {
+		return m_LastProcessTime;
+	}
+
 protected:
-	/* Initializes the thread - must be called by child class in its Initialize() method */
-	HRESULT Initialize(CComPtr<IDXAudioCallback> Callback);
+	/* Copies the stream description, allocates the push-mode ring buffers if requested, and initializes
+	** the thread - must be called by child class in its Initialize() method */
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC* pDesc, CComPtr<IDXAudioCallback> Callback);
+
+	/* Returns true if the stream was created as DXAUDIO_STREAM_TYPE_OFFLINE - GetStreamType() still reports the
+	** output or duplex type it runs as */
+	bool IsOfflineMode() {
+		return m_Desc.Type == DXAUDIO_STREAM_TYPE_OFFLINE;
+	}
+
+	/* Returns true if the application feeds and drains this stream through Write() and Read() rather than OnProcess() */
+	bool IsPushMode() {
+		return m_Desc.BufferFrames != 0;
+	}
+
+	/* Returns true if OnProcess() is called with a fixed number of frames */
+	bool IsBlockMode() {
+		return m_Desc.BlockFrames != 0 && !IsPushMode();
+	}
+
+	/* Returns true if OnProcess() is called with a batch of several device periods.  This is only supported by
+	** input, loopback and output streams, and a fixed block size takes precedence. */
+	bool IsCoalesceMode() {
+		const DXAUDIO_STREAM_TYPE Type = GetStreamType();
+
+		return m_Desc.CoalescePeriods > 1 && !IsPushMode() && !IsBlockMode() &&
+			Type != DXAUDIO_STREAM_TYPE_DUPLEX && Type != DXAUDIO_STREAM_TYPE_ECHO;
+	}
+
+	/* Returns true if a new default device is opened on the standby thread before the stream switches to it.  This
+	** is only supported by input and output streams, and an offline stream's devices never change. */
+	bool IsStandbyMode() {
+		const DXAUDIO_STREAM_TYPE Type = GetStreamType();
+
+		return (m_Desc.Flags & DXAUDIO_STREAM_FLAG_WARM_STANDBY) != 0 && !IsOfflineMode() &&
+			(Type == DXAUDIO_STREAM_TYPE_INPUT || Type == DXAUDIO_STREAM_TYPE_OUTPUT);
+	}
+
+	/* Returns true if the stream runs at the rate of the endpoint that drives it, instead of the one it was created
+	** with - the render endpoint for output streams, and the capture (or loopback) endpoint for the rest */
+	bool IsNativeRateMode() {
+		return (m_Desc.Flags & DXAUDIO_STREAM_FLAG_NATIVE_RATE) != 0;
+	}
+
+	/* Returns the sample rate to open the endpoint that drives the stream at - zero in native-rate mode, which asks
+	** the client reader or writer for the endpoint's own.  The other side of a duplex stream is always opened at
+	** m_SampleRate. */
+	FLOAT GetRequestedRate() {
+		return IsNativeRateMode() ? 0.0f : m_SampleRate.load();
+	}
+
+	/* Adopts [SampleRate], the rate the endpoint that drives the stream was just opened at, in native-rate mode.
+	** Returns true if that changed the rate of a stream that was already ready - the application has then been
+	** told, and the other side of the stream, if any, has to be re-opened at the new rate (stream thread only). */
+	bool UpdateSampleRate(FLOAT SampleRate);
+
+	/* Returns the ID of the endpoint the application chose for [Flow] (loopback capture is on the render flow), or
+	** NULL if the stream follows the default one */
+	LPCWSTR GetChosenEndpoint(EDataFlow Flow) {
+		return Flow == eCapture ? m_Desc.InputDeviceID : m_Desc.OutputDeviceID;
+	}
+
+	/* Fills [ppDevice] with the endpoint to open for [Flow] - the one the application chose, or else the default
+	** console endpoint.  Streams on the same chosen endpoint of the system's devices share its device object. */
+	HRESULT GetEndpoint(EDataFlow Flow, IMMDevice** ppDevice);
+
+	/* Returns the number of device periods the client reader should gather per batch */
+	UINT GetCoalescePeriods() {
+		return IsCoalesceMode() ? m_Desc.CoalescePeriods : 1;
+	}
+
+	/* Makes the thread process once every [Interval] (in 100-nanosecond units) without relying on an endpoint to
+	** set the wait event.  Used by coalescing input streams, whose client is polled rather than event-driven. */
+	VOID SetProcessTimer(REFERENCE_TIME Interval);
+
+	/* Stops the timer armed by SetProcessTimer(), for as long as there's no running client to poll */
+	VOID CancelProcessTimer() {
+		CancelWaitableTimer(m_ProcessTimer);
+	}
+
+	/* Hands one period of input to the application (input and loopback streams).  Depending on the stream
+	** description, this queues it on the input ring, re-blocks it, or calls OnProcess() directly.  [IsSilent] is
+	** passed on from the client reader. */
+	VOID ProcessInput(FLOAT* AudioIn, UINT Frames, bool IsSilent);
+
+	/* Gets one period of output from the application (output streams).  Returns true if the application marked
+	** the output as silent, in which case the contents of [AudioOut] are undefined. */
+	bool ProcessOutput(FLOAT* AudioOut, UINT Frames);
+
+	/* Hands one period of input to the application and gets the same number of output frames (duplex and echo streams).
+	** [IsSilent] and the return value are the same as for ProcessInput() and ProcessOutput(). */
+	bool ProcessDuplex(FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames, bool IsSilent);
+
+	/* Ramps the next [Frames] frames passed to ApplyFadeIn() up from silence, so that a switch to another endpoint
+	** doesn't start with a click */
+	VOID BeginFadeIn(UINT Frames) {
+		m_FadeFrames = Frames;
+		m_FadePosition = 0;
+	}
+
+	/* Applies the fade begun by BeginFadeIn() to [Frames] frames of [Buffer].  If [IsSilent], the buffer is left
+	** alone, but the fade still moves on. */
+	VOID ApplyFadeIn(FLOAT* Buffer, UINT Frames, bool IsSilent);
 
 	/* Returns a handle to the event used for waking the thread each device period */
 	HANDLE GetWaitEvent() {
@@ -94,8 +264,33 @@ protected:
 	/* Child class must read/write stream data and call their callback's process method */
 	virtual VOID ImplProcess() PURE;
 
+	/* Child class must open the default device as a standby endpoint if it isn't the one in use (standby mode only).
+	** This runs on the standby thread while the stream thread carries on with the old endpoint, and returns S_OK if
+	** a standby was prepared, S_FALSE if there's nothing to switch to, or a failure.  Failures other than
+	** AUDCLNT_E_DEVICE_INVALIDATED must be noted with NoteStandbyFailure() instead of reported, since the callback
+	** and Halt() may only be used from the stream thread - HandleStandby() reports them there. */
+	virtual HRESULT ImplPrepareStandby() {
+		return E_NOTIMPL;
+	}
+
+	/* Child class must switch to the endpoint prepared by ImplPrepareStandby(), on the stream thread */
+	virtual VOID ImplSwapStandby() { }
+
 	CComPtr<IMMDeviceEnumerator> m_Enumerator; //The WASAPI device enumerator
-	FLOAT m_SampleRate; //The sample rate requested by the application - input/output will be resampled to this
+	DXAUDIO_STREAM_DESC m_Desc; //The description the stream was created with
+	DXAUDIO_SIMULATED_DEVICE_DESC m_SimulatedDevice; //Copy of *m_Desc.pSimulatedDevice, if set (m_Desc then points here)
+	std::wstring m_CaptureFileName; //Copy of m_SimulatedDevice.CaptureFileName (which then points here)
+	std::wstring m_RenderFileName; //Copy of m_SimulatedDevice.RenderFileName or m_Desc.OfflineFileName (which then point here)
+	std::wstring m_ChosenInputID; //Copy of m_Desc.InputDeviceID, if the stream captures from it (m_Desc then points here)
+	std::wstring m_ChosenOutputID; //Copy of m_Desc.OutputDeviceID, if the stream uses it (m_Desc then points here)
+	std::atomic<FLOAT> m_SampleRate; //The sample rate requested by the application - input/output will be resampled to this (changed by UpdateSampleRate() in native-rate mode)
+
+	//Only the one matching the stream type is set, by the child class's Initialize() method
+	CComPtr<IDXAudioReadCallback> m_ReadCallback; //The callback object of an input or loopback stream
+	CComPtr<IDXAudioWriteCallback> m_WriteCallback; //The callback object of an output stream
+	CComPtr<IDXAudioReadWriteCallback> m_ReadWriteCallback; //The callback object of a duplex or echo stream
+
+	StreamArena m_Arena; //Per-period buffers, sized by the child class whenever its clients are initialized
 
 private:
 	long m_RefCount; //Reference counter
@@ -106,16 +301,165 @@ private:
 	HANDLE m_PropertyChangeEvent; //Used as a message for checking for property value changes
 	HANDLE m_WaitEvent; //Used as the callback event for WASAPI
 	HANDLE m_HaltEvent; //Used for closing the thread/stream
+	HANDLE m_ClosedEvent; //Manual-reset, set once the thread has exited (wakes blocked Read()/Write() callers)
+	HANDLE m_ReadyEvent; //Manual-reset, set once the thread has opened the devices or failed to (see SignalReady())
+	HANDLE m_InputDataEvent; //Set by the stream thread whenever it queues input data (push mode)
+	HANDLE m_OutputSpaceEvent; //Set by the stream thread whenever it frees output space (push mode)
+	HANDLE m_ProcessTimer; //Periodic waitable timer, used in place of the wait event by polled clients
+	HANDLE m_SettleTimer; //One-shot waitable timer that lets a burst of notifications settle before it's handled
 
 	HANDLE m_Thread; //Handle to the thread (one thread for each stream)
 
 	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting
 
+	RingBuffer m_InputRing; //Input data produced by the stream thread, consumed by Read() (push mode)
+	RingBuffer m_OutputRing; //Output data produced by Write(), consumed by the stream thread (push mode)
+
+	RingBuffer m_BlockInputFifo; //Input frames waiting to make up a full block (block mode)
+	RingBuffer m_BlockOutputFifo; //Output frames generated ahead of the endpoint (block mode)
+	FLOAT* m_BlockInput; //The block handed to OnProcess() as input (block mode)
+	FLOAT* m_BlockOutput; //The block handed to OnProcess() as output (block mode)
+	UINT m_BlockCapacity; //Capacity of m_BlockInput and m_BlockOutput in frames
+	std::atomic<UINT> m_LastBatchFrames; //Size of the most recent batch handed to OnProcess() (coalesce mode - written by the stream thread, read by GetAddedLatency())
+
+	StreamStatistics m_Statistics; //Counters reported by GetStatistics()
+	StreamPerformance m_Performance; //Measurements reported by GetPerformance()
+	REFERENCE_TIME m_TimerInterval; //Interval the process timer was set to, or zero if the endpoint drives the stream
+	UINT m_EndpointInfoUpdates; //Incremented by SetEndpointInfo(), to tell whether a device change re-opened anything
+	DXAUDIO_STREAM_INFO m_StreamInfo; //Reported by GetStreamInfo()
+	SRWLOCK m_StreamInfoLock; //Guards m_StreamInfo, which is written by the stream thread and read by the application
+	LARGE_INTEGER m_PerformanceFrequency; //Ticks per second of the performance counter
+	REFERENCE_TIME m_LastProcessTime; //Duration of the most recent ProcessOutput()/ProcessDuplex() call
+
+	/* Returns how long after one wakeup the next is due, in 100-nanosecond units - the timer interval if the stream
+	** is polled, otherwise the shortest endpoint period - or zero if the endpoints haven't been opened */
+	REFERENCE_TIME GetExpectedInterval();
+
+	/* Calls ImplDeviceChange() or ImplPropertyChange() ([IsDeviceChange] selects which), recording the time taken
+	** as a re-initialization if any endpoint was re-opened */
+	VOID HandleChange(bool IsDeviceChange);
+
+	/* Has the standby thread prepare the new default device (standby mode only) - if it's already busy, it goes
+	** again once it's done */
+	VOID RequestStandby();
+
+	/* Switches to the endpoint prepared by the standby thread, recording the time taken.  If the standby couldn't be
+	** prepared because the device changed again, the stream falls back to ImplDeviceChange(). */
+	VOID HandleStandby();
+
+	/* Notes when a burst of notifications began, so that RecoveryTime covers the wait for the stream thread too */
+	VOID OnChangeNotified() {
+		LONGLONG Expected = 0;
+		m_ChangeNotifiedTicks.compare_exchange_strong(Expected, StreamPerformance::GetTicks());
+	}
+
+	/* Returns true if [Flow] is the data flow of one of the stream's endpoints (loopback capture is on the render flow) */
+	bool UsesFlow(EDataFlow Flow) {
+		const DXAUDIO_STREAM_TYPE Type = GetStreamType();
+
+		if (Flow == eRender) {
+			return Type != DXAUDIO_STREAM_TYPE_INPUT;
+		} else if (Flow == eCapture) {
+			return Type != DXAUDIO_STREAM_TYPE_OUTPUT && Type != DXAUDIO_STREAM_TYPE_LOOPBACK;
+		}
+
+		return true;
+	}
+
+	/* Remembers that a change of the kind selected by [IsDeviceChange] came in, and arms the settle timer unless
+	** it's already running - the change is handled once it fires, along with any others that came in meanwhile */
+	VOID DeferChange(bool IsDeviceChange);
+
+	/* Handles the changes deferred since the settle timer was armed */
+	VOID HandleDeferredChanges();
+
+	/* Records the recovery time once the first period after a re-open has been processed */
+	VOID EndRecovery() {
+		if (m_RecoveryStart != 0) {
+			m_Performance.OnRecovery(StreamPerformance::GetTicks() - m_RecoveryStart);
+			m_RecoveryStart = 0;
+		}
+	}
+
+	/* Records the time elapsed since [StartTime] as the most recent process time */
+	VOID EndProcessTiming(const LARGE_INTEGER& StartTime);
+
+	AllocationTracker m_AllocationTracker; //Checks that processing a period never allocates (debug builds only)
+
+	OfflineRenderer m_OfflineRenderer; //Drives the simulated endpoints of an offline stream
+	bool m_IsOfflineRunning; //True while an offline stream is started, so that the thread never waits (stream thread only)
+	bool m_IsReady; //True once the ready event has been set (stream thread only)
+	HRESULT m_InitResult; //The result reported by WaitForReady() - only read once the ready event is set
+	std::atomic<LONGLONG> m_ChangeNotifiedTicks; //When the first change notification not yet handled arrived, or zero
+	LONGLONG m_RecoveryStart; //When the change that last re-opened the endpoint(s) was notified, or zero once recovered (stream thread only)
+
+	HANDLE m_StandbyThread; //Prepares new default devices ahead of the switch (standby mode only)
+	HANDLE m_StandbyRequestEvent; //Used as a message for the standby thread to prepare the default device
+	HANDLE m_StandbyReadyEvent; //Set by the standby thread once it's done, successfully or not
+	HANDLE m_StandbyExitEvent; //Used for closing the standby thread
+	HRESULT m_StandbyResult; //What ImplPrepareStandby() returned (written by the standby thread before m_StandbyReadyEvent is set)
+	LPCWSTR m_StandbyFailureFile; //Where ImplPrepareStandby() failed, as noted by NoteStandbyFailure() (same rules as m_StandbyResult)
+	UINT m_StandbyFailureLine; //The line it failed on
+	bool m_IsStandbyBusy; //True between RequestStandby() and HandleStandby() (stream thread only)
+	bool m_IsStandbyPending; //True if another device change came in while the standby thread was busy (stream thread only)
+	LONGLONG m_StandbyNotified; //When the device change being prepared for was notified (stream thread only)
+	bool m_IsDeviceChangeDeferred; //True if a default device change is waiting for the settle timer (stream thread only)
+	bool m_IsPropertyChangeDeferred; //Likewise for a property change
+	std::wstring m_InputDeviceID; //ID of the device the input side was opened on, or empty (guarded by m_StreamInfoLock)
+	std::wstring m_OutputDeviceID; //Likewise for the output side
+	UINT m_FadeFrames; //Length of the fade begun by BeginFadeIn() (stream thread only)
+	UINT m_FadePosition; //Frames of it applied so far
+
+	/* Processes one period of an offline stream, moving the simulated endpoints on first */
+	VOID ProcessOfflinePeriod();
+
+	//Set if the callback object implements the extended interface, in which case OnProcessEx() is called instead
+	CComPtr<IDXAudioReadCallbackEx> m_ReadCallbackEx;
+	CComPtr<IDXAudioWriteCallbackEx> m_WriteCallbackEx;
+	CComPtr<IDXAudioReadWriteCallbackEx> m_ReadWriteCallbackEx;
+	CComPtr<IDXAudioGlitchCallback> m_GlitchCallback; //Set if the callback object wants to hear about glitches
+	CComPtr<IDXAudioRateCallback> m_RateCallback; //Set if the callback object wants to hear about sample rate changes
+
+	UINT64 m_FramePosition; //Frames passed to the callback so far, at the stream's sample rate
+	DXAUDIO_PERIOD_INFO m_Timing; //Endpoint timing reported by the client reader/writer for the current period
+	UINT m_InputDeviceRate; //Sample rate of the capture endpoint, for converting offsets into device positions
+	UINT m_OutputDeviceRate; //Sample rate of the render endpoint
+
+	/* Fills [pInfo] for a callback buffer whose first input frame is [InputOffset] frames after the first frame
+	** the client reader returned this period (negative if re-blocking held it back from an earlier period), and whose
+	** first output frame has [OutputQueued] frames queued ahead of it that the client writer hasn't been given yet */
+	VOID GetPeriodInfo(DXAUDIO_PERIOD_INFO* pInfo, INT64 InputOffset, UINT OutputQueued);
+
+	/* These call the application's OnProcess() (or OnProcessEx()) method, excluding it from the allocation tracker.
+	** [InputOffset] and [OutputQueued] are described in GetPeriodInfo().  [IsSilent] marks the input as silent for
+	** OnProcessEx(), and the return value is true if OnProcessEx() marked the output as silent. */
+	VOID CallRead(FLOAT* AudioIn, UINT Frames, INT64 InputOffset, bool IsSilent);
+	bool CallWrite(FLOAT* AudioOut, UINT Frames, UINT OutputQueued);
+	bool CallReadWrite(FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames, INT64 InputOffset, UINT OutputQueued, bool IsSilent);
+
+	/* Allocates the re-blocking FIFOs and block buffers (block and coalesce modes) */
+	HRESULT InitializeBlocks();
+
+	/* Fills [AudioOut] with [Frames] frames from the output ring, padding with silence on underrun (push mode only) */
+	VOID PullOutput(FLOAT* AudioOut, UINT Frames);
+
+	/* Queues [Frames] frames from [AudioIn] on the input ring, dropping whatever doesn't fit (push mode only) */
+	VOID PushInput(const FLOAT* AudioIn, UINT Frames);
+
 	//IUnknown methods
 
 	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
 		QUERY_INTERFACE_CAST(IDXAudioStream);
 		QUERY_INTERFACE_CAST(IUnknown);
+
+		//Applications built against the original four-method interface ask for it by its original IID
+		if (riid == IID_IDXAudioStreamV1) {
+			IDXAudioStream* pObj = static_cast<IDXAudioStream*>(this);
+			pObj->AddRef();
+			*ppvObject = pObj;
+			return S_OK;
+		}
+
 		QUERY_INTERFACE_FAIL();
 	}
 
@@ -136,21 +480,91 @@ private:
 		return m_SampleRate;
 	}
 
-	//CMMNotificationClientListener methods
+	/* Queues output data on the output ring */
+	HRESULT STDMETHODCALLTYPE Write(const FLOAT* AudioOut, UINT Frames, UINT* pFramesWritten, BOOL Blocking) final;
+
+	/* Dequeues input data from the input ring */
+	HRESULT STDMETHODCALLTYPE Read(FLOAT* AudioIn, UINT Frames, UINT* pFramesRead, BOOL Blocking) final;
+
+	/* Returns the fill level of the input ring */
+	UINT STDMETHODCALLTYPE GetReadAvailable() final {
+		return m_InputRing.IsInitialized() ? m_InputRing.GetReadAvailable() : 0;
+	}
+
+	/* Returns the free space in the output ring */
+	UINT STDMETHODCALLTYPE GetWriteAvailable() final {
+		return m_OutputRing.IsInitialized() ? m_OutputRing.GetWriteAvailable() : 0;
+	}
+
+	/* Returns the latency added by re-blocking or batching */
+	UINT STDMETHODCALLTYPE GetAddedLatency() final;
+
+	/* Copies the stream's counters */
+	VOID STDMETHODCALLTYPE GetStatistics(DXAUDIO_STREAM_STATISTICS* pStatistics) final {
+		if (pStatistics != nullptr) {
+			m_Statistics.GetStatistics(pStatistics);
+		}
+	}
+
+	/* Zeroes the stream's counters */
+	VOID STDMETHODCALLTYPE ResetStatistics() final {
+		m_Statistics.Reset();
+	}
+
+	/* Copies the stream's timing measurements */
+	VOID STDMETHODCALLTYPE GetPerformance(DXAUDIO_STREAM_PERFORMANCE* pPerformance) final {
+		if (pPerformance != nullptr) {
+			m_Performance.GetPerformance(pPerformance);
+		}
+	}
 
-	/* Called when the user changes the default device for any data flow or role */
-	virtual VOID OnDefaultDeviceChanged() final {
-		SetEvent(m_DeviceChangeEvent);
+	/* Empties the stream's timing measurements */
+	VOID STDMETHODCALLTYPE ResetPerformance() final {
+		m_Performance.Reset();
 	}
 
-	/* Called when the user changes properties such as sample rate on an endpoint */
-	virtual VOID OnPropertyValueChanged() final {
-		SetEvent(m_PropertyChangeEvent);
+	/* Copies the most recent glitch events */
+	UINT STDMETHODCALLTYPE GetGlitchEvents(DXAUDIO_GLITCH_EVENT* pEvents, UINT MaxEvents) final {
+		return pEvents != nullptr ? m_Statistics.GetGlitchEvents(pEvents, MaxEvents) : 0;
 	}
 
+	/* Copies how the endpoints were set up */
+	VOID STDMETHODCALLTYPE GetStreamInfo(DXAUDIO_STREAM_INFO* pInfo) final;
+
+	/* Returns the event that's set once the thread has opened the devices */
+	HANDLE STDMETHODCALLTYPE GetReadyEvent() final {
+		return m_ReadyEvent;
+	}
+
+	/* Waits for the thread to open the devices, and returns how that went */
+	HRESULT STDMETHODCALLTYPE WaitForReady(DWORD Milliseconds) final;
+
+	//CMMNotificationClientListener methods
+
+	/* Called when the user changes the default device for any data flow or role - the stream thread is only woken
+	** if it's the console role of a flow the stream uses, and the application didn't choose that flow's endpoint */
+	virtual VOID OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) final;
+
+	/* Called when the user changes properties such as sample rate on an endpoint - the stream thread is only woken
+	** if the device format of one of the stream's own devices changed */
+	virtual VOID OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY& Key) final;
+
+	/* Called when an endpoint changes state - the stream thread is only woken if one of the stream's own endpoints
+	** became active again, in which case its clients are checked just as for a property change */
+	virtual VOID OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) final;
+
 	/* The static thread entry point */
 	static DWORD __stdcall StaticStreamThreadEntry(LPVOID Data);
 
 	/* The non-static thread entry point, called by StaticStreamThreadEntry() */
 	DWORD StreamThreadEntry();
+
+	/* Sets the ready event, recording [hr] as the result if it failed - only the first call does anything */
+	VOID SignalReady(HRESULT hr);
+
+	/* The static standby thread entry point */
+	static DWORD __stdcall StaticStandbyThreadEntry(LPVOID Data);
+
+	/* The non-static standby thread entry point, called by StaticStandbyThreadEntry() */
+	DWORD StandbyThreadEntry();
 };
\ No newline at end of file
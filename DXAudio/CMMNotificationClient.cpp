@@ -54,13 +54,25 @@ ULONG CMMNotificationClient::Release() {
 }
 
 HRESULT CMMNotificationClient::OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) {
-	m_Listener.OnDefaultDeviceChanged(); //redirect the call to the listener with no data
+	m_Listener.OnDefaultDeviceChanged(Flow, Role, DeviceID); //redirect the call to the listener
 
 	return S_OK;
 }
 
 HRESULT CMMNotificationClient::OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY Key) {
-	m_Listener.OnPropertyValueChanged(); //redirect the call to the listener with no data
+	m_Listener.OnPropertyValueChanged(DeviceID, Key); //redirect the call to the listener
+
+	return S_OK;
+}
+
+HRESULT CMMNotificationClient::OnDeviceRemoved(LPCWSTR DeviceID) {
+	m_Listener.OnDeviceStateChanged(DeviceID, DEVICE_STATE_NOTPRESENT); //redirect the call to the listener
+
+	return S_OK;
+}
+
+HRESULT CMMNotificationClient::OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) {
+	m_Listener.OnDeviceStateChanged(DeviceID, State); //redirect the call to the listener
 
 	return S_OK;
 }
\ No newline at end of file
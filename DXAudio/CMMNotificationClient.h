@@ -51,11 +51,13 @@ public:
 	/* Called when the default device has changed on any flow or role */
 	STDMETHODIMP OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) final;
 
-	STDMETHODIMP OnDeviceAdded(LPCWSTR DeviceID) final { return S_OK; } //Not used
+	STDMETHODIMP OnDeviceAdded(LPCWSTR DeviceID) final { return S_OK; } //Not used - a new endpoint is announced again once its state changes
 
-	STDMETHODIMP OnDeviceRemoved(LPCWSTR DeviceID) final { return S_OK; } //Not used
+	/* Called when an endpoint is removed from the system - passed on as a change to DEVICE_STATE_NOTPRESENT */
+	STDMETHODIMP OnDeviceRemoved(LPCWSTR DeviceID) final;
 
-	STDMETHODIMP OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) final { return S_OK; } //Not used
+	/* Called when an endpoint is enabled, disabled, plugged in or unplugged */
+	STDMETHODIMP OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) final;
 
 	/* Called when a property value of an endpoint has changed */
 	STDMETHODIMP OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY Key) final;
@@ -63,6 +65,6 @@ public:
 private:
 	long m_RefCount; //Reference counter
 
-	//Calls to OnDefaultDeviceChanged() and OnPropertyValueChanged() are redirected to the listener
+	//Calls to OnDefaultDeviceChanged(), OnPropertyValueChanged() and the device state methods are redirected to the listener
 	CMMNotificationClientListener& m_Listener;
 };
\ No newline at end of file
@@ -27,13 +27,16 @@
 #include <mmdeviceapi.h>
 
 /* Interface used by CMMNotificationClient to notify changes in the default device
-** and the properties of audio endpoints.
-** The reason no data is used in these callbacks is because the calls are handled on a separate
-** thread via events, and a mutex would be overkill for something we can figure out without the data. */
+** and the properties of audio endpoints.  The data is passed on so that the listener can tell whether the
+** change concerns it - [DeviceID] is only valid for the duration of the call. */
 struct CMMNotificationClientListener {
 	/* Called when the default device is changed on some flow or role - must be implemented */
-	virtual void OnDefaultDeviceChanged() PURE;
+	virtual void OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) PURE;
 
 	/* Called when a property of an endpoint has changed - must be implemented */
-	virtual void OnPropertyValueChanged() PURE;
+	virtual void OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY& Key) PURE;
+
+	/* Called when an endpoint is enabled, disabled, plugged in, unplugged or removed - [State] is its new
+	** DEVICE_STATE_XXX value (DEVICE_STATE_NOTPRESENT once it's removed) - must be implemented */
+	virtual void OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) PURE;
 };
\ No newline at end of file
@@ -0,0 +1,836 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <ksmedia.h>
+#include <math.h>
+
+#include "CSimulatedAudioClient.h"
+#include "ClientNegotiation.h"
+#include "OfflineRenderer.h"
+#include "QueryInterface.h"
+
+#define TONE_AMPLITUDE 0.25 //Peak level of the simulated capture tone
+
+static const DOUBLE s_TwoPi = 6.283185307179586;
+
+//Converts a performance counter reading to 100-nanosecond units, in two parts so that a long uptime can't overflow
+static UINT64 CounterToTime(LONGLONG Counter, LONGLONG Frequency) {
+	return UINT64(Counter / Frequency) * 10000000 + UINT64(Counter % Frequency) * 10000000 / UINT64(Frequency);
+}
+
+//Returns true if [pFormat] holds floating-point samples
+static bool IsFloatFormat(const WAVEFORMATEX* pFormat) {
+	if (pFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+		return ((const WAVEFORMATEXTENSIBLE*)(pFormat))->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+	}
+
+	return pFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+}
+
+//Returns true if [pFormat] describes the same samples as [pMixFormat]
+static bool IsSameFormat(const WAVEFORMATEX* pFormat, const WAVEFORMATEXTENSIBLE* pMixFormat) {
+	return pFormat->nSamplesPerSec == pMixFormat->Format.nSamplesPerSec &&
+		pFormat->nChannels == pMixFormat->Format.nChannels &&
+		pFormat->wBitsPerSample == pMixFormat->Format.wBitsPerSample &&
+		IsFloatFormat(pFormat) == IsFloatFormat(&pMixFormat->Format);
+}
+
+//Returns the usual channel mask for [Channels] channels
+static DWORD GetChannelMask(UINT Channels) {
+	return Channels == 2 ? KSAUDIO_SPEAKER_STEREO : DWORD((1ull << Channels) - 1);
+}
+
+CSimulatedAudioClient::CSimulatedAudioClient(CSimulatedDevice* pDevice) :
+m_RefCount(1),
+m_Device(pDevice),
+m_Desc(pDevice->GetDesc()),
+m_Flow(pDevice->GetFlow()),
+m_DevicePeriod(0),
+m_IsInitialized(false),
+m_IsCapture(pDevice->GetFlow() == eCapture),
+m_PeriodFrames(0),
+m_BufferFrames(0),
+m_Buffer(nullptr),
+m_EventHandle(NULL),
+m_ClockThread(NULL),
+m_StopEvent(NULL),
+m_Timer(NULL),
+m_DevicePosition(0),
+m_QueuedFrames(0),
+m_PacketFrames(0),
+m_IsOverrun(false),
+m_FrameDebt(0.0),
+m_Random(pDevice->GetDesc().Seed),
+m_StartCounter(0),
+m_StartPosition(0),
+m_pRenderer(pDevice->GetRenderer()),
+m_IsRegistered(false),
+m_IsOfflineStarted(false),
+m_Generation(pDevice->GetGeneration())
+{
+	//A format change fault may have switched the rate, in which case the period stays the same length of time
+	m_Desc.SampleRate = pDevice->GetSampleRate();
+	m_Desc.PeriodFrames = UINT(UINT64(m_Desc.PeriodFrames) * m_Desc.SampleRate / pDevice->GetDesc().SampleRate);
+
+	//24-bit samples sit in a 32-bit container, like every shared-mode mix format that uses them
+	BuildClientFormat (
+		&m_MixFormat,
+		m_Desc.SampleRate,
+		WORD(m_Desc.Channels),
+		GetChannelMask(m_Desc.Channels),
+		WORD(m_Desc.BitsPerSample == 24 ? 32 : m_Desc.BitsPerSample),
+		WORD(m_Desc.BitsPerSample),
+		m_Desc.IsFloat != FALSE
+	);
+
+	m_Format = m_MixFormat;
+	m_DevicePeriod = REFERENCE_TIME(m_Desc.PeriodFrames) * 10000000 / m_Desc.SampleRate;
+
+	InitializeCriticalSection(&m_Lock);
+	QueryPerformanceFrequency(&m_CounterFrequency);
+}
+
+CSimulatedAudioClient::~CSimulatedAudioClient() {
+	Stop();
+
+	if (m_IsRegistered) {
+		m_pRenderer->RemoveClient(this);
+	}
+
+	if (m_Buffer != nullptr) {
+		_aligned_free(m_Buffer);
+		m_Buffer = nullptr;
+	}
+
+	if (m_StopEvent != NULL) {
+		CloseHandle(m_StopEvent);
+		m_StopEvent = NULL;
+	}
+
+	if (m_Timer != NULL) {
+		CloseHandle(m_Timer);
+		m_Timer = NULL;
+	}
+
+	DeleteCriticalSection(&m_Lock);
+}
+
+HRESULT CSimulatedAudioClient::LoadCaptureFile(LPCWSTR FileName, bool IsRaw) {
+	HRESULT hr = m_CaptureFile.Open(FileName, IsRaw ? &m_MixFormat : nullptr);
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	m_MixFormat = m_CaptureFile.GetFormat();
+	m_Format = m_MixFormat;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::QueryInterface(REFIID riid, void** ppvObject) {
+	QUERY_INTERFACE_CAST(IAudioClient);
+
+	//IUnknown is reached through IAudioClient, so that every query for it returns the same pointer
+	if (riid == __uuidof(IUnknown)) {
+		IUnknown* pObj = static_cast<IAudioClient*>(this);
+		pObj->AddRef();
+		*ppvObject = pObj;
+		return S_OK;
+	}
+
+	QUERY_INTERFACE_FAIL();
+}
+
+ULONG CSimulatedAudioClient::AddRef() {
+	return InterlockedIncrement(&m_RefCount);
+}
+
+ULONG CSimulatedAudioClient::Release() {
+	const ULONG RefCount = InterlockedDecrement(&m_RefCount);
+
+	if (RefCount == 0) {
+		delete this;
+	}
+
+	return RefCount;
+}
+
+HRESULT CSimulatedAudioClient::Initialize(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Periodicity, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) {
+	if (m_IsInitialized) {
+		return AUDCLNT_E_ALREADY_INITIALIZED;
+	}
+
+	if (pFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	//The simulated devices only have a mixer to share
+	if (ShareMode != AUDCLNT_SHAREMODE_SHARED) {
+		return AUDCLNT_E_EXCLUSIVE_MODE_NOT_ALLOWED;
+	}
+
+	if ((StreamFlags & AUDCLNT_STREAMFLAGS_LOOPBACK) && m_Flow != eRender) {
+		return AUDCLNT_E_WRONG_ENDPOINT_TYPE;
+	}
+
+	//Like the real engine, only the mix format is accepted unless the engine is asked to convert - and there's no
+	//converting a capture file, so the caller has to fall back to the mix format
+	if ((!(StreamFlags & AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM) || m_CaptureFile.IsOpen()) && !IsSameFormat(pFormat, &m_MixFormat)) {
+		return AUDCLNT_E_UNSUPPORTED_FORMAT;
+	}
+
+	if (pFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE && pFormat->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)) {
+		m_Format = *((const WAVEFORMATEXTENSIBLE*)(pFormat));
+	} else {
+		BuildClientFormat (
+			&m_Format,
+			pFormat->nSamplesPerSec,
+			pFormat->nChannels,
+			GetChannelMask(pFormat->nChannels),
+			pFormat->wBitsPerSample,
+			pFormat->wBitsPerSample,
+			IsFloatFormat(pFormat)
+		);
+	}
+
+	m_IsCapture = m_Flow == eCapture || (StreamFlags & AUDCLNT_STREAMFLAGS_LOOPBACK) != 0;
+
+	//The render file takes whatever format the first render client is initialized with
+	if (!m_IsCapture) {
+		HRESULT hr = m_Device->OpenRenderFile(&m_Format.Format);
+
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	//The period stays the same length of time at whatever rate the client runs
+	m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Desc.PeriodFrames) * m_Format.Format.nSamplesPerSec / m_Desc.SampleRate));
+
+	//The buffer is never smaller than two periods, so that a little drift can't overflow it
+	if (BufferDuration < m_DevicePeriod * 2) {
+		BufferDuration = m_DevicePeriod * 2;
+	}
+
+	m_BufferFrames = (UINT32)(ceil(DOUBLE(BufferDuration) * m_Format.Format.nSamplesPerSec / 10000000));
+
+	m_Buffer = (BYTE*)(_aligned_malloc(m_BufferFrames * m_Format.Format.nBlockAlign, 64));
+
+	if (m_Buffer == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	//An offline client is moved on by its renderer, so it needs no clock of its own
+	if (m_pRenderer != nullptr) {
+		m_pRenderer->AddClient(this);
+		m_IsRegistered = true;
+		m_IsInitialized = true;
+
+		return S_OK;
+	}
+
+	m_StopEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+	if (m_StopEvent == NULL) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	//A high-resolution timer keeps the periods close to their due times (Windows 10 1803 and later)
+	m_Timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+	if (m_Timer == NULL) {
+		m_Timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+	}
+
+	if (m_Timer == NULL) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_IsInitialized = true;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetBufferSize(UINT32* pNumBufferFrames) {
+	if (pNumBufferFrames == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	*pNumBufferFrames = m_BufferFrames;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetStreamLatency(REFERENCE_TIME* phnsLatency) {
+	if (phnsLatency == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	*phnsLatency = m_DevicePeriod;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetCurrentPadding(UINT32* pNumPaddingFrames) {
+	if (pNumPaddingFrames == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+	*pNumPaddingFrames = m_QueuedFrames;
+	LeaveCriticalSection(&m_Lock);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::IsFormatSupported(AUDCLNT_SHAREMODE ShareMode, const WAVEFORMATEX* pFormat, WAVEFORMATEX** ppClosestMatch) {
+	if (pFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	if (ppClosestMatch != nullptr) {
+		*ppClosestMatch = nullptr;
+	}
+
+	if (ShareMode != AUDCLNT_SHAREMODE_SHARED) {
+		return AUDCLNT_E_UNSUPPORTED_FORMAT;
+	}
+
+	if (IsSameFormat(pFormat, &m_MixFormat)) {
+		return S_OK;
+	}
+
+	//Suggest the mix format instead, as the real engine does
+	if (ppClosestMatch != nullptr) {
+		return GetMixFormat(ppClosestMatch) == S_OK ? S_FALSE : E_OUTOFMEMORY;
+	}
+
+	return AUDCLNT_E_UNSUPPORTED_FORMAT;
+}
+
+HRESULT CSimulatedAudioClient::GetMixFormat(WAVEFORMATEX** ppDeviceFormat) {
+	if (ppDeviceFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	WAVEFORMATEXTENSIBLE* pFormat = (WAVEFORMATEXTENSIBLE*)(CoTaskMemAlloc(sizeof(WAVEFORMATEXTENSIBLE)));
+
+	if (pFormat == nullptr) {
+		*ppDeviceFormat = nullptr;
+		return E_OUTOFMEMORY;
+	}
+
+	*pFormat = m_MixFormat;
+	*ppDeviceFormat = (WAVEFORMATEX*)(pFormat);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetDevicePeriod(REFERENCE_TIME* phnsDefaultDevicePeriod, REFERENCE_TIME* phnsMinimumDevicePeriod) {
+	if (phnsDefaultDevicePeriod == nullptr && phnsMinimumDevicePeriod == nullptr) {
+		return E_POINTER;
+	}
+
+	if (phnsDefaultDevicePeriod != nullptr) {
+		*phnsDefaultDevicePeriod = m_DevicePeriod;
+	}
+
+	if (phnsMinimumDevicePeriod != nullptr) {
+		*phnsMinimumDevicePeriod = m_DevicePeriod;
+	}
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::Start() {
+	LARGE_INTEGER Counter;
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	if (m_ClockThread != NULL || m_IsOfflineStarted) {
+		return AUDCLNT_E_NOT_STOPPED;
+	}
+
+	//Periods are timed from here, and the device clock carries on from where it stopped
+	QueryPerformanceCounter(&Counter);
+	m_StartCounter = Counter.QuadPart;
+	m_StartPosition = m_DevicePosition;
+
+	if (m_pRenderer != nullptr) {
+		m_IsOfflineStarted = true;
+		return S_OK;
+	}
+
+	m_ClockThread = CreateThread (
+		NULL,
+		0,
+		StaticClockThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	if (m_ClockThread == NULL) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::Stop() {
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (!m_IsOfflineStarted && m_ClockThread == NULL) {
+		return S_FALSE;
+	}
+
+	if (m_ClockThread != NULL) {
+		SetEvent(m_StopEvent);
+		WaitForSingleObject(m_ClockThread, INFINITE);
+		CloseHandle(m_ClockThread);
+		m_ClockThread = NULL;
+	}
+
+	m_IsOfflineStarted = false;
+
+	//Nothing more is rendered until the next Start(), so the file can be completed now
+	if (!m_IsCapture && m_Device->HasRenderFile()) {
+		m_Device->FlushRenderFile();
+	}
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::Reset() {
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (m_ClockThread != NULL || m_IsOfflineStarted) {
+		return AUDCLNT_E_NOT_STOPPED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+	m_DevicePosition = 0;
+	m_QueuedFrames = 0;
+	m_PacketFrames = 0;
+	m_IsOverrun = false;
+	m_FrameDebt = 0.0;
+	LeaveCriticalSection(&m_Lock);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::SetEventHandle(HANDLE eventHandle) {
+	if (eventHandle == NULL) {
+		return E_INVALIDARG;
+	}
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	m_EventHandle = eventHandle;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetService(REFIID riid, void** ppv) {
+	if (ppv == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppv = nullptr;
+
+	if (!m_IsInitialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	if (riid == __uuidof(IAudioCaptureClient) && m_IsCapture) {
+		*ppv = static_cast<IAudioCaptureClient*>(this);
+	} else if (riid == __uuidof(IAudioRenderClient) && !m_IsCapture) {
+		*ppv = static_cast<IAudioRenderClient*>(this);
+	} else if (riid == __uuidof(IAudioClock)) {
+		*ppv = static_cast<IAudioClock*>(this);
+	} else {
+		return E_NOINTERFACE;
+	}
+
+	AddRef();
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetBuffer(BYTE** ppData, UINT32* pNumFramesToRead, DWORD* pdwFlags, UINT64* pu64DevicePosition, UINT64* pu64QPCPosition) {
+	UINT32 Frames = 0;
+	UINT64 Position = 0;
+	DWORD Flags = 0;
+
+	if (ppData == nullptr || pNumFramesToRead == nullptr || pdwFlags == nullptr) {
+		return E_POINTER;
+	}
+
+	//An injected GetBuffer() fault fails this one call, and the client carries on afterwards
+	if (IsInvalidated() || m_Device->TakeGetBufferFault()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+
+	//Packets are handed out a period at a time, oldest first
+	Frames = m_QueuedFrames < m_PeriodFrames ? m_QueuedFrames : m_PeriodFrames;
+	Position = m_DevicePosition - m_QueuedFrames;
+
+	if (Frames != 0 && m_IsOverrun) {
+		Flags |= AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY;
+		m_IsOverrun = false;
+	}
+
+	m_PacketFrames = Frames;
+
+	LeaveCriticalSection(&m_Lock);
+
+	if (Frames == 0) {
+		*ppData = nullptr;
+		*pNumFramesToRead = 0;
+		*pdwFlags = 0;
+		return AUDCLNT_S_BUFFER_EMPTY;
+	}
+
+	//Without a file or a tone, the device captures silence and says so
+	if (m_CaptureFile.IsOpen()) {
+		ReadCaptureFile(Position, Frames);
+	} else if (m_Desc.ToneFrequency > 0.0f) {
+		FillTone(Position, Frames);
+	} else {
+		Flags |= AUDCLNT_BUFFERFLAGS_SILENT;
+	}
+
+	*ppData = m_Buffer;
+	*pNumFramesToRead = Frames;
+	*pdwFlags = Flags;
+
+	if (pu64DevicePosition != nullptr) {
+		*pu64DevicePosition = Position;
+	}
+
+	if (pu64QPCPosition != nullptr) {
+		*pu64QPCPosition = GetPositionTime(Position);
+	}
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::ReleaseBuffer(UINT32 NumFramesRead) {
+	HRESULT hr = S_OK;
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+
+	//A packet is released whole or not at all - zero frames leaves it queued for the next GetBuffer()
+	if (NumFramesRead != 0 && (NumFramesRead != m_PacketFrames || NumFramesRead > m_QueuedFrames)) {
+		hr = AUDCLNT_E_INVALID_SIZE;
+	} else {
+		m_QueuedFrames -= NumFramesRead;
+		m_PacketFrames = 0;
+	}
+
+	LeaveCriticalSection(&m_Lock);
+
+	return hr;
+}
+
+HRESULT CSimulatedAudioClient::GetNextPacketSize(UINT32* pNumFramesInNextPacket) {
+	if (pNumFramesInNextPacket == nullptr) {
+		return E_POINTER;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+	*pNumFramesInNextPacket = m_QueuedFrames < m_PeriodFrames ? m_QueuedFrames : m_PeriodFrames;
+	LeaveCriticalSection(&m_Lock);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetBuffer(UINT32 NumFramesRequested, BYTE** ppData) {
+	HRESULT hr = S_OK;
+
+	if (ppData == nullptr) {
+		return E_POINTER;
+	}
+
+	if (IsInvalidated() || m_Device->TakeGetBufferFault()) {
+		*ppData = nullptr;
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+
+	if (NumFramesRequested > m_BufferFrames - m_QueuedFrames) {
+		hr = AUDCLNT_E_BUFFER_TOO_LARGE;
+	}
+
+	LeaveCriticalSection(&m_Lock);
+
+	*ppData = SUCCEEDED(hr) ? m_Buffer : nullptr;
+
+	return hr;
+}
+
+HRESULT CSimulatedAudioClient::ReleaseBuffer(UINT32 NumFramesWritten, DWORD dwFlags) {
+	HRESULT hr = S_OK;
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+
+	if (NumFramesWritten > m_BufferFrames - m_QueuedFrames) {
+		hr = AUDCLNT_E_INVALID_SIZE;
+	} else {
+		m_QueuedFrames += NumFramesWritten;
+	}
+
+	LeaveCriticalSection(&m_Lock);
+
+	//The rendered frames go to the render file and, offline, to the application
+	if (SUCCEEDED(hr) && NumFramesWritten != 0 && (m_Device->HasRenderFile() || m_pRenderer != nullptr)) {
+		if (dwFlags & AUDCLNT_BUFFERFLAGS_SILENT) {
+			ZeroMemory(m_Buffer, NumFramesWritten * m_Format.Format.nBlockAlign);
+		}
+
+		if (m_Device->HasRenderFile()) {
+			hr = m_Device->WriteRenderFile(m_Buffer, NumFramesWritten * m_Format.Format.nBlockAlign);
+		}
+
+		if (m_pRenderer != nullptr) {
+			m_pRenderer->OnRender(&m_Format.Format, m_Buffer, NumFramesWritten);
+		}
+	}
+
+	return hr;
+}
+
+HRESULT CSimulatedAudioClient::GetFrequency(UINT64* pu64Frequency) {
+	if (pu64Frequency == nullptr) {
+		return E_POINTER;
+	}
+
+	*pu64Frequency = m_Format.Format.nSamplesPerSec;
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetPosition(UINT64* pu64Position, UINT64* pu64QPCPosition) {
+	LARGE_INTEGER Counter;
+
+	if (pu64Position == nullptr) {
+		return E_POINTER;
+	}
+
+	if (IsInvalidated()) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
+	EnterCriticalSection(&m_Lock);
+	*pu64Position = m_DevicePosition;
+	LeaveCriticalSection(&m_Lock);
+
+	if (pu64QPCPosition != nullptr) {
+		QueryPerformanceCounter(&Counter);
+		*pu64QPCPosition = CounterToTime(Counter.QuadPart, m_CounterFrequency.QuadPart);
+	}
+
+	return S_OK;
+}
+
+HRESULT CSimulatedAudioClient::GetCharacteristics(DWORD* pdwCharacteristics) {
+	if (pdwCharacteristics == nullptr) {
+		return E_POINTER;
+	}
+
+	*pdwCharacteristics = 0;
+
+	return S_OK;
+}
+
+DWORD __stdcall CSimulatedAudioClient::StaticClockThreadEntry(LPVOID Data) {
+	((CSimulatedAudioClient*)(Data))->ClockThreadEntry();
+	return 0;
+}
+
+VOID CSimulatedAudioClient::ClockThreadEntry() {
+	HANDLE Events[] = { m_StopEvent, m_Timer };
+	LARGE_INTEGER Counter;
+	LARGE_INTEGER DueTime;
+	LONGLONG Jitter = 0;
+	LONGLONG Remaining = 0;
+
+	for (UINT64 Period = 1; ; Period++) {
+		//Each period is due a whole number of periods after Start(), so that late wakeups never accumulate.  The
+		//jitter comes from a linear congruential generator, so that a given seed always gives the same sequence.
+		m_Random = m_Random * 1664525 + 1013904223;
+		Jitter = LONGLONG((m_Random >> 8) % (m_Desc.JitterMicroseconds + 1)) * 10;
+
+		QueryPerformanceCounter(&Counter);
+		Remaining = LONGLONG(Period) * m_DevicePeriod + Jitter - LONGLONG(CounterToTime(Counter.QuadPart - m_StartCounter, m_CounterFrequency.QuadPart));
+
+		if (Remaining > 0) {
+			DueTime.QuadPart = -Remaining; //Relative to now
+
+			SetWaitableTimer(m_Timer, &DueTime, 0, NULL, NULL, FALSE);
+
+			if (WaitForMultipleObjects(2, Events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+				break;
+			}
+		} else if (WaitForSingleObject(m_StopEvent, 0) != WAIT_TIMEOUT) {
+			break;
+		}
+
+		AdvancePeriod();
+
+		if (m_EventHandle != NULL) {
+			SetEvent(m_EventHandle);
+		}
+	}
+
+	CancelWaitableTimer(m_Timer);
+}
+
+VOID CSimulatedAudioClient::AdvancePeriod() {
+	//A drifting clock moves a fraction of a frame more or less each period, which adds up to whole frames over time
+	const DOUBLE Frames = DOUBLE(m_Desc.PeriodFrames) * m_Format.Format.nSamplesPerSec / m_Desc.SampleRate * (1.0 + m_Desc.DriftPPM / 1000000.0) + m_FrameDebt;
+	const UINT32 DueFrames = Frames > 0.0 ? (UINT32)(Frames) : 0;
+
+	m_FrameDebt = Frames - DueFrames;
+
+	EnterCriticalSection(&m_Lock);
+
+	m_DevicePosition += DueFrames;
+
+	if (m_IsCapture) {
+		//Frames that don't fit in the endpoint buffer are lost, as they would be if a real client fell behind
+		if (DueFrames > m_BufferFrames - m_QueuedFrames) {
+			m_QueuedFrames = m_BufferFrames;
+			m_IsOverrun = true;
+		} else {
+			m_QueuedFrames += DueFrames;
+		}
+	} else {
+		//Once the rendered frames run out, the device plays silence
+		m_QueuedFrames -= DueFrames < m_QueuedFrames ? DueFrames : m_QueuedFrames;
+	}
+
+	LeaveCriticalSection(&m_Lock);
+}
+
+UINT64 CSimulatedAudioClient::GetPositionTime(UINT64 Position) {
+	const DOUBLE Rate = m_Format.Format.nSamplesPerSec * (1.0 + m_Desc.DriftPPM / 1000000.0);
+	const DOUBLE Offset = (DOUBLE(INT64(Position - m_StartPosition)) * 10000000.0) / Rate;
+
+	return UINT64(INT64(CounterToTime(m_StartCounter, m_CounterFrequency.QuadPart)) + INT64(Offset));
+}
+
+VOID CSimulatedAudioClient::FillTone(UINT64 Position, UINT32 Frames) {
+	const UINT Channels = m_Format.Format.nChannels;
+	const bool IsFloat = IsFloatFormat(&m_Format.Format);
+	const DOUBLE CyclesPerFrame = DOUBLE(m_Desc.ToneFrequency) / m_Format.Format.nSamplesPerSec;
+	BYTE* Buffer = m_Buffer;
+
+	for (UINT32 i = 0; i < Frames; i++) {
+		//The phase comes from the device position, so the tone carries on seamlessly from packet to packet
+		const DOUBLE Sample = TONE_AMPLITUDE * sin(s_TwoPi * fmod(DOUBLE(Position + i) * CyclesPerFrame, 1.0));
+
+		for (UINT j = 0; j < Channels; j++) {
+			if (IsFloat) {
+				*((FLOAT*)(Buffer)) = FLOAT(Sample);
+				Buffer += sizeof(FLOAT);
+			} else if (m_Format.Format.wBitsPerSample == 16) {
+				*((INT16*)(Buffer)) = INT16(Sample * 32767);
+				Buffer += sizeof(INT16);
+			} else { //24-bit samples are left-justified in 32 bits, so they're written the same way
+				*((INT32*)(Buffer)) = INT32(Sample * 2147483647);
+				Buffer += sizeof(INT32);
+			}
+		}
+	}
+}
+
+VOID CSimulatedAudioClient::ReadCaptureFile(UINT64 Position, UINT32 Frames) {
+	const UINT32 BlockAlign = m_Format.Format.nBlockAlign;
+	const UINT64 FileFrames = m_CaptureFile.GetFrames();
+	UINT64 Offset = Position % FileFrames;
+	BYTE* Buffer = m_Buffer;
+
+	//The file loops, picking up from the start wherever a packet runs past its end
+	while (Frames != 0) {
+		const UINT32 Chunk = FileFrames - Offset < Frames ? UINT32(FileFrames - Offset) : Frames;
+
+		CopyMemory(Buffer, m_CaptureFile.GetData() + Offset * BlockAlign, SIZE_T(Chunk) * BlockAlign);
+		Buffer += SIZE_T(Chunk) * BlockAlign;
+		Frames -= Chunk;
+		Offset = 0;
+	}
+}
\ No newline at end of file
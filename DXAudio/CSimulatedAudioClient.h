@@ -0,0 +1,186 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <Audioclient.h>
+#include "DXAudio.h"
+#include "CSimulatedDevice.h"
+#include "WaveFileReader.h"
+
+class OfflineRenderer;
+
+/* CSimulatedAudioClient stands in for a shared-mode WASAPI client on a simulated endpoint.  It implements the
+** client, capture, render and clock interfaces on one object, handing out whichever applies from GetService().
+** While started, a thread of its own advances a virtual device clock by one period at a time, producing capture
+** frames or consuming rendered ones, and then sets the event handle (if any) - late by a pseudo-random amount of
+** up to DXAUDIO_SIMULATED_DEVICE_DESC::JitterMicroseconds.  The number of frames each period moves is derived from
+** the period count alone, so the data is the same from run to run; only the wakeups depend on the scheduler.
+** A client created for an offline stream has no clock thread - its OfflineRenderer moves it on a period at a
+** time with AdvanceOfflinePeriod(), and receives everything it renders.  A capture client may play a file (in a
+** loop) in place of the tone, and a render client hands what it's given to its device's render file.  Once a fault
+** injected into its device has invalidated it, the client fails with AUDCLNT_E_DEVICE_INVALIDATED and has to be
+** replaced, as on a real endpoint. */
+class CSimulatedAudioClient : public IAudioClient, public IAudioCaptureClient, public IAudioRenderClient, public IAudioClock {
+public:
+	/* [pDevice] is the device the client was activated on, which it keeps a reference to */
+	CSimulatedAudioClient(CSimulatedDevice* pDevice);
+
+	~CSimulatedAudioClient();
+
+	/* Maps [FileName] to be captured in place of the tone.  The file's format becomes the mix format - or, if
+	** [IsRaw] is true, the file is taken to be headerless samples in the mix format described. */
+	HRESULT LoadCaptureFile(LPCWSTR FileName, bool IsRaw);
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final;
+
+	ULONG STDMETHODCALLTYPE AddRef() final;
+
+	ULONG STDMETHODCALLTYPE Release() final;
+
+	//IAudioClient methods
+
+	/* Accepts the mix format, or any format if AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM is set (except when capturing a
+	** file, which isn't converted).  Exclusive mode is refused. */
+	STDMETHODIMP Initialize(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Periodicity, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) final;
+
+	STDMETHODIMP GetBufferSize(UINT32* pNumBufferFrames) final;
+
+	STDMETHODIMP GetStreamLatency(REFERENCE_TIME* phnsLatency) final;
+
+	STDMETHODIMP GetCurrentPadding(UINT32* pNumPaddingFrames) final;
+
+	STDMETHODIMP IsFormatSupported(AUDCLNT_SHAREMODE ShareMode, const WAVEFORMATEX* pFormat, WAVEFORMATEX** ppClosestMatch) final;
+
+	STDMETHODIMP GetMixFormat(WAVEFORMATEX** ppDeviceFormat) final;
+
+	STDMETHODIMP GetDevicePeriod(REFERENCE_TIME* phnsDefaultDevicePeriod, REFERENCE_TIME* phnsMinimumDevicePeriod) final;
+
+	/* Starts the device clock thread (or, offline, lets AdvanceOfflinePeriod() move the device) */
+	STDMETHODIMP Start() final;
+
+	/* Stops the device clock - the device position holds until the next Start() */
+	STDMETHODIMP Stop() final;
+
+	STDMETHODIMP Reset() final;
+
+	STDMETHODIMP SetEventHandle(HANDLE eventHandle) final;
+
+	STDMETHODIMP GetService(REFIID riid, void** ppv) final;
+
+	//IAudioCaptureClient methods
+
+	/* Returns the oldest period's worth of captured frames (or what's left of it), filled from the capture file or
+	** with the test tone */
+	STDMETHODIMP GetBuffer(BYTE** ppData, UINT32* pNumFramesToRead, DWORD* pdwFlags, UINT64* pu64DevicePosition, UINT64* pu64QPCPosition) final;
+
+	/* Like a real capture client, only takes zero (leaving the packet queued) or every frame of the last packet */
+	STDMETHODIMP ReleaseBuffer(UINT32 NumFramesRead) final;
+
+	STDMETHODIMP GetNextPacketSize(UINT32* pNumFramesInNextPacket) final;
+
+	//IAudioRenderClient methods
+
+	/* Returns scratch space for [NumFramesRequested] frames - ReleaseBuffer() passes the rendered samples on to the
+	** render file and the OfflineRenderer, if there are any, and otherwise discards them */
+	STDMETHODIMP GetBuffer(UINT32 NumFramesRequested, BYTE** ppData) final;
+
+	STDMETHODIMP ReleaseBuffer(UINT32 NumFramesWritten, DWORD dwFlags) final;
+
+	//IAudioClock methods
+
+	STDMETHODIMP GetFrequency(UINT64* pu64Frequency) final;
+
+	STDMETHODIMP GetPosition(UINT64* pu64Position, UINT64* pu64QPCPosition) final;
+
+	STDMETHODIMP GetCharacteristics(DWORD* pdwCharacteristics) final;
+
+	/* Moves an offline client's device on by one period, if it's started - called by its OfflineRenderer */
+	VOID AdvanceOfflinePeriod() {
+		if (m_IsOfflineStarted) {
+			AdvancePeriod();
+		}
+	}
+
+private:
+	long m_RefCount; //Reference counter
+	CComPtr<CSimulatedDevice> m_Device; //The device the client was activated on
+	DXAUDIO_SIMULATED_DEVICE_DESC m_Desc; //How the simulated device behaves
+	EDataFlow m_Flow; //Data flow of the device the client belongs to
+	WAVEFORMATEXTENSIBLE m_MixFormat; //The device's mix format, built from m_Desc
+	WAVEFORMATEXTENSIBLE m_Format; //The format the client was initialized with
+	REFERENCE_TIME m_DevicePeriod; //Length of a device period
+	bool m_IsInitialized; //True once Initialize() has succeeded
+	bool m_IsCapture; //True for a capture or loopback client, false for a render client
+	UINT32 m_PeriodFrames; //Frames the device moves each period, at the client's rate (before drift)
+	UINT32 m_BufferFrames; //Size of the endpoint buffer
+	BYTE* m_Buffer; //Scratch space handed out by GetBuffer()
+	HANDLE m_EventHandle; //Set after every period, if not NULL
+	HANDLE m_ClockThread; //Runs the device clock while started
+	HANDLE m_StopEvent; //Tells the clock thread to exit
+	HANDLE m_Timer; //Paces the clock thread
+	CRITICAL_SECTION m_Lock; //Guards the positions below, which the clock thread and the client's user share
+	UINT64 m_DevicePosition; //Frames the device has moved since the client was initialized
+	UINT32 m_QueuedFrames; //Captured frames waiting to be read, or rendered frames waiting to be played
+	UINT32 m_PacketFrames; //Frames in the capture packet handed out by GetBuffer(), until it's released
+	bool m_IsOverrun; //True if captured frames were lost since the last packet was read
+	DOUBLE m_FrameDebt; //Fractional frames the drifting clock owes the next period
+	UINT m_Random; //State of the jitter sequence
+	LARGE_INTEGER m_CounterFrequency; //Ticks per second of the performance counter
+	LONGLONG m_StartCounter; //Performance counter reading at the last Start()
+	UINT64 m_StartPosition; //Device position at the last Start()
+	OfflineRenderer* m_pRenderer; //Drives the client in place of the clock thread, or NULL in real time
+	bool m_IsRegistered; //True once the client has been added to m_pRenderer
+	bool m_IsOfflineStarted; //True between Start() and Stop() of an offline client
+	WaveFileReader m_CaptureFile; //The file captured in place of the tone, if open
+	UINT m_Generation; //The device's generation when the client was created (see IsInvalidated())
+
+	/* Returns true if a fault has invalidated the client since it was created, in which case most methods fail with
+	** AUDCLNT_E_DEVICE_INVALIDATED, as a real client's do once its endpoint changes */
+	bool IsInvalidated() {
+		return m_Device->GetGeneration() != m_Generation;
+	}
+
+	/* The static clock thread entry point */
+	static DWORD __stdcall StaticClockThreadEntry(LPVOID Data);
+
+	/* Runs the device clock until Stop() */
+	VOID ClockThreadEntry();
+
+	/* Moves the device on by one period */
+	VOID AdvancePeriod();
+
+	/* Returns the time at which the device reached [Position], as a performance counter reading in 100-nanosecond units */
+	UINT64 GetPositionTime(UINT64 Position);
+
+	/* Fills [Frames] frames of m_Buffer with the test tone, starting at device position [Position] */
+	VOID FillTone(UINT64 Position, UINT32 Frames);
+
+	/* Fills [Frames] frames of m_Buffer from the capture file, starting at device position [Position] */
+	VOID ReadCaptureFile(UINT64 Position, UINT32 Frames);
+};
\ No newline at end of file
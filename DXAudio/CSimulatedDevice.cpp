@@ -0,0 +1,186 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <wchar.h>
+
+#include "CSimulatedDevice.h"
+#include "CSimulatedAudioClient.h"
+#include "QueryInterface.h"
+
+CSimulatedDevice::CSimulatedDevice(const DXAUDIO_SIMULATED_DEVICE_DESC& Desc, EDataFlow Flow, OfflineRenderer* pRenderer) :
+m_RefCount(1),
+m_Desc(Desc),
+m_Flow(Flow),
+m_pRenderer(pRenderer),
+m_SampleRate(Desc.SampleRate),
+m_Generation(0),
+m_Instance(0),
+m_IsGetBufferFault(false)
+{
+	ZeroMemory(&m_RenderFileFormat, sizeof(m_RenderFileFormat));
+}
+
+CSimulatedDevice::~CSimulatedDevice() { }
+
+HRESULT CSimulatedDevice::QueryInterface(REFIID riid, void** ppvObject) {
+	QUERY_INTERFACE_CAST(IMMDevice);
+	QUERY_INTERFACE_CAST(IUnknown);
+	QUERY_INTERFACE_FAIL();
+}
+
+ULONG CSimulatedDevice::AddRef() {
+	return InterlockedIncrement(&m_RefCount);
+}
+
+ULONG CSimulatedDevice::Release() {
+	const ULONG RefCount = InterlockedDecrement(&m_RefCount);
+
+	if (RefCount == 0) {
+		delete this;
+	}
+
+	return RefCount;
+}
+
+HRESULT CSimulatedDevice::Activate(REFIID iid, DWORD dwClsCtx, PROPVARIANT* pActivationParams, void** ppInterface) {
+	if (ppInterface == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppInterface = nullptr;
+
+	if (iid != __uuidof(IAudioClient)) {
+		return E_NOINTERFACE;
+	}
+
+	//The new client starts with the one reference handed to the caller
+	CSimulatedAudioClient* pClient = new CSimulatedAudioClient(this);
+
+	//A capture file takes the place of the mix format and the tone
+	if (m_Flow == eCapture && m_Desc.CaptureFileName != nullptr) {
+		HRESULT hr = pClient->LoadCaptureFile(m_Desc.CaptureFileName, m_Desc.IsRawFile != FALSE);
+
+		if (FAILED(hr)) {
+			pClient->Release();
+			return hr;
+		}
+	}
+
+	*ppInterface = static_cast<IAudioClient*>(pClient);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedDevice::OpenRenderFile(const WAVEFORMATEX* pFormat) {
+	if (m_Desc.RenderFileName == nullptr) {
+		return S_FALSE;
+	}
+
+	if (!m_RenderFile.IsOpen()) {
+		HRESULT hr = m_RenderFile.Open(m_Desc.RenderFileName, pFormat, m_Desc.IsRawFile != FALSE);
+
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		m_RenderFileFormat = *pFormat;
+	} else if (memcmp(&m_RenderFileFormat, pFormat, sizeof(WAVEFORMATEX) - sizeof(WORD)) != 0) {
+		//Everything but cbSize has to match, or the rest of the file would be garbage
+		return AUDCLNT_E_UNSUPPORTED_FORMAT;
+	}
+
+	return S_OK;
+}
+
+VOID CSimulatedDevice::InjectFault(DXAUDIO_SIMULATED_FAULT Fault) {
+	switch (Fault) {
+		case DXAUDIO_SIMULATED_FAULT_INVALIDATE: {
+			m_Generation++;
+		} break;
+
+		case DXAUDIO_SIMULATED_FAULT_DEFAULT_CHANGE: { //Another device with the same description takes over
+			m_Instance++;
+			m_Generation++;
+		} break;
+
+		case DXAUDIO_SIMULATED_FAULT_FORMAT_CHANGE: { //Clients created from now on see the other rate
+			const UINT Alternate = m_Desc.SampleRate == 44100 ? 48000 : 44100;
+
+			//A render file can only hold one format, so a device writing one keeps its rate and is just invalidated
+			if (m_Flow != eRender || m_Desc.RenderFileName == nullptr) {
+				m_SampleRate = m_SampleRate.load() == m_Desc.SampleRate ? Alternate : m_Desc.SampleRate;
+			}
+
+			m_Generation++;
+		} break;
+
+		case DXAUDIO_SIMULATED_FAULT_GETBUFFER: {
+			m_IsGetBufferFault = true;
+		} break;
+	}
+}
+
+VOID CSimulatedDevice::GetDeviceID(LPWSTR pID, UINT Length) {
+	const LPCWSTR Name = m_Flow == eRender ? L"Render" : L"Capture";
+	const UINT Instance = m_Instance.load();
+
+	//The original device keeps the plain ID
+	if (Instance == 0) {
+		swprintf_s(pID, Length, L"{DXAudio.Simulated.%s}", Name);
+	} else {
+		swprintf_s(pID, Length, L"{DXAudio.Simulated.%s.%u}", Name, Instance);
+	}
+}
+
+HRESULT CSimulatedDevice::GetId(LPWSTR* ppstrId) {
+	WCHAR DeviceID[64];
+
+	GetDeviceID(DeviceID, ARRAYSIZE(DeviceID));
+
+	const size_t Length = wcslen(DeviceID) + 1;
+
+	if (ppstrId == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppstrId = (LPWSTR)(CoTaskMemAlloc(Length * sizeof(WCHAR)));
+
+	if (*ppstrId == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	CopyMemory(*ppstrId, DeviceID, Length * sizeof(WCHAR));
+
+	return S_OK;
+}
+
+HRESULT CSimulatedDevice::GetState(DWORD* pdwState) {
+	if (pdwState == nullptr) {
+		return E_POINTER;
+	}
+
+	*pdwState = DEVICE_STATE_ACTIVE;
+
+	return S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include "DXAudio.h"
+#include "WaveFileWriter.h"
+#include <atomic>
+
+class OfflineRenderer;
+
+/* CSimulatedDevice stands in for a WASAPI endpoint device.  Each call to Activate() creates a new
+** CSimulatedAudioClient on it, and the device itself has no properties.  The render device owns the render file
+** (if any), so that it carries on across the clients a stream re-initializes.  Faults are injected from the
+** enumerator's fault thread, so everything they change is atomic. */
+class CSimulatedDevice : public IMMDevice {
+public:
+	/* [Desc] must already have its defaults filled in.  [Flow] is either eRender or eCapture.  [pRenderer] is
+	** passed on to every client, and is NULL unless the device belongs to an offline stream. */
+	CSimulatedDevice(const DXAUDIO_SIMULATED_DEVICE_DESC& Desc, EDataFlow Flow, OfflineRenderer* pRenderer);
+
+	~CSimulatedDevice();
+
+	/* Returns the description the device was created with, for its clients */
+	const DXAUDIO_SIMULATED_DEVICE_DESC& GetDesc() {
+		return m_Desc;
+	}
+
+	/* Returns the current sample rate of the mix format, which a format change fault may have switched */
+	UINT GetSampleRate() {
+		return m_SampleRate.load();
+	}
+
+	/* Returns a number that changes whenever the device's clients are invalidated */
+	UINT GetGeneration() {
+		return m_Generation.load();
+	}
+
+	/* Returns true once after a GetBuffer() fault was injected, for the client that gets to fail */
+	bool TakeGetBufferFault() {
+		return m_IsGetBufferFault.exchange(false);
+	}
+
+	/* Applies the fault [Fault] to the device - the enumerator sends any notification */
+	VOID InjectFault(DXAUDIO_SIMULATED_FAULT Fault);
+
+	/* Returns whether this is the render or the capture device */
+	EDataFlow GetFlow() {
+		return m_Flow;
+	}
+
+	/* Returns the offline renderer that drives the device's clients, or NULL in real time */
+	OfflineRenderer* GetRenderer() {
+		return m_pRenderer;
+	}
+
+	/* Opens DXAUDIO_SIMULATED_DEVICE_DESC::RenderFileName for a render client in [pFormat], unless there's no render
+	** file or it's already open.  The file keeps the format it was opened with, so a later client in any other
+	** format is refused. */
+	HRESULT OpenRenderFile(const WAVEFORMATEX* pFormat);
+
+	/* Returns true if a render client's frames should be written with WriteRenderFile() */
+	bool HasRenderFile() {
+		return m_RenderFile.IsOpen();
+	}
+
+	/* Appends [Bytes] bytes a render client was given to the render file */
+	HRESULT WriteRenderFile(const BYTE* pData, UINT32 Bytes) {
+		return m_RenderFile.Write(pData, Bytes);
+	}
+
+	/* Writes out everything rendered so far, so that the file is complete while the client is stopped */
+	VOID FlushRenderFile() {
+		m_RenderFile.Flush();
+	}
+
+	/* Writes the ID the device reports from GetId() to [pID], which holds [Length] characters.  The ID changes every
+	** time a default device change is injected, as if another device had taken over. */
+	VOID GetDeviceID(LPWSTR pID, UINT Length);
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final;
+
+	ULONG STDMETHODCALLTYPE AddRef() final;
+
+	ULONG STDMETHODCALLTYPE Release() final;
+
+	//IMMDevice methods
+
+	/* Creates a simulated IAudioClient - no other interface can be activated */
+	STDMETHODIMP Activate(REFIID iid, DWORD dwClsCtx, PROPVARIANT* pActivationParams, void** ppInterface) final;
+
+	STDMETHODIMP OpenPropertyStore(DWORD stgmAccess, IPropertyStore** ppProperties) final { return E_NOTIMPL; } //No properties to read
+
+	/* Returns a copy of GetDeviceID() allocated with CoTaskMemAlloc() */
+	STDMETHODIMP GetId(LPWSTR* ppstrId) final;
+
+	STDMETHODIMP GetState(DWORD* pdwState) final;
+
+private:
+	long m_RefCount; //Reference counter
+	DXAUDIO_SIMULATED_DEVICE_DESC m_Desc; //Passed on to every client
+	EDataFlow m_Flow; //Whether this is the render or the capture device
+	OfflineRenderer* m_pRenderer; //Passed on to every client
+	WaveFileWriter m_RenderFile; //Writes the render file, once the first render client opens it
+	WAVEFORMATEX m_RenderFileFormat; //The format the render file was opened with
+	std::atomic<UINT> m_SampleRate; //Current sample rate of the mix format
+	std::atomic<UINT> m_Generation; //Incremented whenever the clients are invalidated
+	std::atomic<UINT> m_Instance; //Incremented whenever the device is replaced as the default, and part of its ID
+	std::atomic<bool> m_IsGetBufferFault; //Set when a GetBuffer() fault is injected, until a client takes it
+};
\ No newline at end of file
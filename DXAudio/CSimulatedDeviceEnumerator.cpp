@@ -0,0 +1,250 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <wchar.h>
+
+#include "CSimulatedDeviceEnumerator.h"
+#include "QueryInterface.h"
+
+CSimulatedDeviceEnumerator::CSimulatedDeviceEnumerator(const DXAUDIO_SIMULATED_DEVICE_DESC& Desc, OfflineRenderer* pRenderer) :
+m_RefCount(1),
+m_FaultInterval(Desc.FaultIntervalMilliseconds),
+m_FaultTypes(Desc.FaultTypes),
+m_NextFault(0),
+m_FaultThread(NULL),
+m_StopEvent(NULL)
+{
+	DXAUDIO_SIMULATED_DEVICE_DESC Device = Desc;
+
+	if (Device.SampleRate == 0) {
+		Device.SampleRate = 48000;
+	}
+
+	if (Device.Channels < 2) {
+		Device.Channels = 2;
+	}
+
+	//Anything but 16, 24 or 32-bit integers is taken to mean 32-bit floats
+	if (Device.BitsPerSample != 16 && Device.BitsPerSample != 24 && Device.BitsPerSample != 32) {
+		Device.BitsPerSample = 32;
+		Device.IsFloat = TRUE;
+	} else if (Device.BitsPerSample != 32) {
+		Device.IsFloat = FALSE;
+	}
+
+	if (Device.PeriodFrames == 0) {
+		Device.PeriodFrames = Device.SampleRate / 100;
+	}
+
+	m_RenderDevice.Attach(new CSimulatedDevice(Device, eRender, pRenderer));
+	m_CaptureDevice.Attach(new CSimulatedDevice(Device, eCapture, pRenderer));
+
+	InitializeCriticalSection(&m_ClientLock);
+
+	if (m_FaultInterval == 0) {
+		return;
+	}
+
+	if (m_FaultTypes == 0) {
+		m_FaultTypes = DXAUDIO_SIMULATED_FAULT_INVALIDATE | DXAUDIO_SIMULATED_FAULT_DEFAULT_CHANGE |
+			DXAUDIO_SIMULATED_FAULT_FORMAT_CHANGE | DXAUDIO_SIMULATED_FAULT_GETBUFFER;
+	}
+
+	//Without the thread the devices simply never fail, which is all the stream will notice
+	m_StopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	if (m_StopEvent != NULL) {
+		m_FaultThread = CreateThread (
+			NULL,
+			0,
+			StaticFaultThreadEntry,
+			this,
+			NULL,
+			NULL
+		);
+	}
+}
+
+CSimulatedDeviceEnumerator::~CSimulatedDeviceEnumerator() {
+	if (m_FaultThread != NULL) {
+		SetEvent(m_StopEvent);
+		WaitForSingleObject(m_FaultThread, INFINITE);
+		CloseHandle(m_FaultThread);
+		m_FaultThread = NULL;
+	}
+
+	if (m_StopEvent != NULL) {
+		CloseHandle(m_StopEvent);
+		m_StopEvent = NULL;
+	}
+
+	DeleteCriticalSection(&m_ClientLock);
+}
+
+HRESULT CSimulatedDeviceEnumerator::QueryInterface(REFIID riid, void** ppvObject) {
+	QUERY_INTERFACE_CAST(IMMDeviceEnumerator);
+	QUERY_INTERFACE_CAST(IUnknown);
+	QUERY_INTERFACE_FAIL();
+}
+
+ULONG CSimulatedDeviceEnumerator::AddRef() {
+	return InterlockedIncrement(&m_RefCount);
+}
+
+ULONG CSimulatedDeviceEnumerator::Release() {
+	const ULONG RefCount = InterlockedDecrement(&m_RefCount);
+
+	if (RefCount == 0) {
+		delete this;
+	}
+
+	return RefCount;
+}
+
+HRESULT CSimulatedDeviceEnumerator::GetDefaultAudioEndpoint(EDataFlow dataFlow, ERole role, IMMDevice** ppEndpoint) {
+	if (ppEndpoint == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppEndpoint = nullptr;
+
+	if (dataFlow == eRender) {
+		return m_RenderDevice->QueryInterface(IID_PPV_ARGS(ppEndpoint));
+	} else if (dataFlow == eCapture) {
+		return m_CaptureDevice->QueryInterface(IID_PPV_ARGS(ppEndpoint));
+	}
+
+	return E_INVALIDARG;
+}
+
+HRESULT CSimulatedDeviceEnumerator::GetDevice(LPCWSTR pwstrId, IMMDevice** ppDevice) {
+	WCHAR ID[64];
+
+	if (pwstrId == nullptr || ppDevice == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppDevice = nullptr;
+
+	//The IDs change with every default change fault, so an old one no longer finds its device
+	m_RenderDevice->GetDeviceID(ID, ARRAYSIZE(ID));
+
+	if (wcscmp(pwstrId, ID) == 0) {
+		return m_RenderDevice->QueryInterface(IID_PPV_ARGS(ppDevice));
+	}
+
+	m_CaptureDevice->GetDeviceID(ID, ARRAYSIZE(ID));
+
+	if (wcscmp(pwstrId, ID) == 0) {
+		return m_CaptureDevice->QueryInterface(IID_PPV_ARGS(ppDevice));
+	}
+
+	return E_INVALIDARG;
+}
+
+HRESULT CSimulatedDeviceEnumerator::RegisterEndpointNotificationCallback(IMMNotificationClient* pClient) {
+	if (pClient == nullptr) {
+		return E_POINTER;
+	}
+
+	EnterCriticalSection(&m_ClientLock);
+	m_Clients.push_back(pClient);
+	LeaveCriticalSection(&m_ClientLock);
+
+	return S_OK;
+}
+
+HRESULT CSimulatedDeviceEnumerator::UnregisterEndpointNotificationCallback(IMMNotificationClient* pClient) {
+	HRESULT hr = E_INVALIDARG;
+
+	if (pClient == nullptr) {
+		return E_POINTER;
+	}
+
+	EnterCriticalSection(&m_ClientLock);
+
+	for (auto i = m_Clients.begin(); i != m_Clients.end(); i++) {
+		if (*i == pClient) {
+			m_Clients.erase(i);
+			hr = S_OK;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&m_ClientLock);
+
+	return hr;
+}
+
+VOID CSimulatedDeviceEnumerator::InjectNextFault() {
+	static const ERole Roles[] = { eConsole, eMultimedia, eCommunications };
+	CSimulatedDevice* const Devices[] = { m_RenderDevice, m_CaptureDevice };
+	WCHAR ID[64];
+	DXAUDIO_SIMULATED_FAULT Fault;
+
+	//Find the next enabled type, going round in the order the flags are declared
+	do {
+		Fault = DXAUDIO_SIMULATED_FAULT(1 << m_NextFault);
+		m_NextFault = (m_NextFault + 1) % 4;
+	} while ((m_FaultTypes & Fault) == 0);
+
+	for (UINT i = 0; i < ARRAYSIZE(Devices); i++) {
+		Devices[i]->InjectFault(Fault);
+	}
+
+	//A GetBuffer() fault is a transient error - nothing is announced, and the stream sees it when it next calls in
+	if (Fault == DXAUDIO_SIMULATED_FAULT_GETBUFFER) {
+		return;
+	}
+
+	EnterCriticalSection(&m_ClientLock);
+
+	for (UINT i = 0; i < ARRAYSIZE(Devices); i++) {
+		Devices[i]->GetDeviceID(ID, ARRAYSIZE(ID));
+
+		for (IMMNotificationClient* pClient : m_Clients) {
+			if (Fault == DXAUDIO_SIMULATED_FAULT_DEFAULT_CHANGE) {
+				for (UINT j = 0; j < ARRAYSIZE(Roles); j++) {
+					pClient->OnDefaultDeviceChanged(Devices[i]->GetFlow(), Roles[j], ID);
+				}
+			} else {
+				pClient->OnPropertyValueChanged(ID, PKEY_AudioEngine_DeviceFormat);
+			}
+		}
+	}
+
+	LeaveCriticalSection(&m_ClientLock);
+}
+
+DWORD __stdcall CSimulatedDeviceEnumerator::StaticFaultThreadEntry(LPVOID Data) {
+	return ((CSimulatedDeviceEnumerator*)(Data))->FaultThreadEntry();
+}
+
+DWORD CSimulatedDeviceEnumerator::FaultThreadEntry() {
+	while (WaitForSingleObject(m_StopEvent, m_FaultInterval) == WAIT_TIMEOUT) {
+		InjectNextFault();
+	}
+
+	return 0;
+}
\ No newline at end of file
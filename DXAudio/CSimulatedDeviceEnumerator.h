@@ -0,0 +1,90 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <vector>
+#include "DXAudio.h"
+#include "CSimulatedDevice.h"
+
+/* CSimulatedDeviceEnumerator stands in for the WASAPI device enumerator of a stream created with
+** DXAUDIO_STREAM_DESC::pSimulatedDevice.  It hands out one simulated render device and one simulated
+** capture device as the defaults for every role.  The devices only change when faults are injected: with a
+** non-zero DXAUDIO_SIMULATED_DEVICE_DESC::FaultIntervalMilliseconds, a fault thread works through the enabled
+** DXAUDIO_SIMULATED_FAULT types in turn, injects each into both devices and sends the registered clients the
+** notification that a real endpoint would.  An offline stream's enumerator passes its OfflineRenderer on to the devices. */
+class CSimulatedDeviceEnumerator : public IMMDeviceEnumerator {
+public:
+	/* Fills in the defaults of [Desc] and creates the two devices.  [pRenderer] is NULL unless the stream is offline. */
+	CSimulatedDeviceEnumerator(const DXAUDIO_SIMULATED_DEVICE_DESC& Desc, OfflineRenderer* pRenderer);
+
+	~CSimulatedDeviceEnumerator();
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final;
+
+	ULONG STDMETHODCALLTYPE AddRef() final;
+
+	ULONG STDMETHODCALLTYPE Release() final;
+
+	//IMMDeviceEnumerator methods
+
+	STDMETHODIMP EnumAudioEndpoints(EDataFlow dataFlow, DWORD dwStateMask, IMMDeviceCollection** ppDevices) final { return E_NOTIMPL; } //Not used
+
+	/* Returns the simulated device for [dataFlow], whatever the role */
+	STDMETHODIMP GetDefaultAudioEndpoint(EDataFlow dataFlow, ERole role, IMMDevice** ppEndpoint) final;
+
+	/* Returns the simulated device with the ID [pwstrId] */
+	STDMETHODIMP GetDevice(LPCWSTR pwstrId, IMMDevice** ppDevice) final;
+
+	/* Adds [pClient] to the clients notified of injected faults.  It isn't AddRef()'d, as with the real enumerator. */
+	STDMETHODIMP RegisterEndpointNotificationCallback(IMMNotificationClient* pClient) final;
+
+	/* Removes [pClient], after which it's never called again */
+	STDMETHODIMP UnregisterEndpointNotificationCallback(IMMNotificationClient* pClient) final;
+
+private:
+	long m_RefCount; //Reference counter
+	CComPtr<CSimulatedDevice> m_RenderDevice; //The default render device
+	CComPtr<CSimulatedDevice> m_CaptureDevice; //The default capture device
+	std::vector<IMMNotificationClient*> m_Clients; //The registered notification clients
+	CRITICAL_SECTION m_ClientLock; //Guards m_Clients, and is held while they're notified
+	UINT m_FaultInterval; //Milliseconds between faults, or zero if none are injected
+	DWORD m_FaultTypes; //The DXAUDIO_SIMULATED_FAULT types to inject
+	UINT m_NextFault; //The bit of m_FaultTypes to try next
+	HANDLE m_FaultThread; //Injects the faults, if there are any
+	HANDLE m_StopEvent; //Signalled to make the fault thread exit
+
+	/* Injects the next enabled fault into both devices and notifies the clients */
+	VOID InjectNextFault();
+
+	/* The static fault thread entry point */
+	static DWORD __stdcall StaticFaultThreadEntry(LPVOID Data);
+
+	/* The non-static fault thread entry point, called by StaticFaultThreadEntry() */
+	DWORD FaultThreadEntry();
+};
\ No newline at end of file
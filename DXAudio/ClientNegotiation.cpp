@@ -0,0 +1,448 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "ClientNegotiation.h"
+#include <ksmedia.h>
+#include <math.h>
+
+#define MAX_EXCLUSIVE_RATES 12
+
+//Standard rates tried in exclusive mode, on top of the application's and the mix format's
+static const DWORD s_StandardRates[] = { 44100, 48000, 88200, 96000, 176400, 192000, 32000, 22050, 16000 };
+
+//Sample formats tried in exclusive mode, from the cheapest for us to convert to the most expensive.
+//Packed 24-bit samples are left out - devices that take them virtually always take 24 bits in a
+//32-bit container too, which we convert as plain 32-bit samples.
+static const struct {
+	WORD BitsPerSample;
+	WORD ValidBits;
+	bool IsFloat;
+} s_SampleFormats[] = {
+	{ 32, 32, true },
+	{ 32, 32, false },
+	{ 32, 24, false },
+	{ 16, 16, false }
+};
+
+//Replaces [Client] with a fresh client from [Device].  [Client] is left NULL if that fails.
+static VOID ReactivateClient(IMMDevice* Device, CComPtr<IAudioClient>& Client) {
+	Client.Release();
+
+	Device->Activate (
+		__uuidof(IAudioClient),
+		CLSCTX_ALL,
+		nullptr,
+		(void**)(&Client)
+	);
+}
+
+UINT32 ChooseEnginePeriod(UINT32 DefaultPeriod, UINT32 FundamentalPeriod, UINT32 MinPeriod, UINT32 MaxPeriod) {
+	UINT32 Period = MinPeriod;
+
+	//A driver that doesn't support anything but the default reports a fundamental of zero
+	//or a minimum greater than the maximum - just use the default in that case
+	if (FundamentalPeriod == 0 || MinPeriod == 0 || MinPeriod > MaxPeriod) {
+		return DefaultPeriod;
+	}
+
+	//Periods must be a multiple of the fundamental period
+	if (Period % FundamentalPeriod != 0) {
+		Period += FundamentalPeriod - Period % FundamentalPeriod;
+	}
+
+	if (Period > MaxPeriod) {
+		return DefaultPeriod;
+	}
+
+	return Period;
+}
+
+HRESULT InitializeLowLatencyClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, const WAVEFORMATEX* Format, UINT32* pPeriodFrames) {
+	HRESULT hr = S_OK;
+	CComPtr<IAudioClient3> Client3;
+	WAVEFORMATEX* CurrentFormat = nullptr;
+	UINT32 DefaultPeriod = 0;
+	UINT32 FundamentalPeriod = 0;
+	UINT32 MinPeriod = 0;
+	UINT32 MaxPeriod = 0;
+	UINT32 Period = 0;
+
+	//IAudioClient3 is only available starting with Windows 10
+	hr = Client->QueryInterface (
+		IID_PPV_ARGS(&Client3)
+	); if (FAILED(hr)) {
+		return E_NOINTERFACE;
+	}
+
+	//Find out which periods the engine supports for this format
+	hr = Client3->GetSharedModeEnginePeriod (
+		Format,
+		&DefaultPeriod,
+		&FundamentalPeriod,
+		&MinPeriod,
+		&MaxPeriod
+	); if (FAILED(hr)) {
+		return hr;
+	}
+
+	Period = ChooseEnginePeriod (
+		DefaultPeriod,
+		FundamentalPeriod,
+		MinPeriod,
+		MaxPeriod
+	);
+
+	hr = Client3->InitializeSharedAudioStream (
+		StreamFlags,
+		Period,
+		Format,
+		NULL
+	);
+
+	//Another stream already runs the engine at a different period, which we have to share.  A client can't
+	//be initialized twice, so a new one has to be created for the second attempt.
+	if (hr == AUDCLNT_E_ENGINE_PERIODICITY_LOCKED) {
+		hr = Client3->GetCurrentSharedModeEnginePeriod (
+			&CurrentFormat,
+			&Period
+		);
+
+		if (SUCCEEDED(hr)) {
+			CoTaskMemFree(CurrentFormat);
+			Client3.Release();
+			ReactivateClient(Device, Client);
+
+			hr = Client != nullptr ? Client->QueryInterface(IID_PPV_ARGS(&Client3)) : E_FAIL;
+		}
+
+		if (SUCCEEDED(hr)) {
+			hr = Client3->InitializeSharedAudioStream (
+				StreamFlags,
+				Period,
+				Format,
+				NULL
+			);
+		}
+	}
+
+	//Hand back a clean client for the fallback - one whose initialization failed can't be relied on
+	if (FAILED(hr)) {
+		Client3.Release();
+
+		if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+			ReactivateClient(Device, Client);
+		}
+
+		return hr;
+	}
+
+	*pPeriodFrames = Period;
+
+	return S_OK;
+}
+
+VOID BuildClientFormat(WAVEFORMATEXTENSIBLE* pFormat, DWORD SampleRate, WORD Channels, DWORD ChannelMask, WORD BitsPerSample, WORD ValidBits, bool IsFloat) {
+	ZeroMemory(pFormat, sizeof(WAVEFORMATEXTENSIBLE));
+
+	pFormat->Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+	pFormat->Format.nChannels = Channels;
+	pFormat->Format.nSamplesPerSec = SampleRate;
+	pFormat->Format.wBitsPerSample = BitsPerSample;
+	pFormat->Format.nBlockAlign = Channels * BitsPerSample / 8;
+	pFormat->Format.nAvgBytesPerSec = SampleRate * pFormat->Format.nBlockAlign;
+	pFormat->Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+	pFormat->Samples.wValidBitsPerSample = ValidBits;
+	pFormat->dwChannelMask = ChannelMask;
+	pFormat->SubFormat = IsFloat ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+}
+
+VOID DescribeFormat(const WAVEFORMATEX* pFormat, DXAUDIO_ENDPOINT_FORMAT* pDesc) {
+	ZeroMemory(pDesc, sizeof(DXAUDIO_ENDPOINT_FORMAT));
+
+	pDesc->SampleRate = pFormat->nSamplesPerSec;
+	pDesc->Channels = pFormat->nChannels;
+	pDesc->BitsPerSample = pFormat->wBitsPerSample;
+	pDesc->ValidBits = pFormat->wBitsPerSample;
+	pDesc->IsFloat = pFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+
+	//Only the extensible format knows the speaker layout, and how many of the bits are used
+	if (pFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+		const WAVEFORMATEXTENSIBLE* pExtensible = (const WAVEFORMATEXTENSIBLE*)(pFormat);
+
+		pDesc->ChannelMask = pExtensible->dwChannelMask;
+		pDesc->IsFloat = pExtensible->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+
+		if (pExtensible->Samples.wValidBitsPerSample != 0) {
+			pDesc->ValidBits = pExtensible->Samples.wValidBitsPerSample;
+		}
+	}
+}
+
+HRESULT GetClientMixFormat(IAudioClient* Client, WAVEFORMATEXTENSIBLE** ppFormat) {
+	HRESULT hr = S_OK;
+	WAVEFORMATEX* pMixFormat = nullptr;
+	WAVEFORMATEXTENSIBLE* pFormat = nullptr;
+
+	hr = Client->GetMixFormat (
+		&pMixFormat
+	); if (FAILED(hr)) {
+		return hr;
+	}
+
+	//The client's own allocation is only as long as its cbSize says, which may not be room enough for the
+	//extensible fields - or for a client format stored over it later
+	pFormat = (WAVEFORMATEXTENSIBLE*)(CoTaskMemAlloc(sizeof(WAVEFORMATEXTENSIBLE)));
+
+	if (pFormat == nullptr) {
+		CoTaskMemFree(pMixFormat);
+		return E_OUTOFMEMORY;
+	}
+
+	ZeroMemory(pFormat, sizeof(WAVEFORMATEXTENSIBLE));
+
+	memcpy (
+		pFormat,
+		pMixFormat,
+		pMixFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE ? sizeof(WAVEFORMATEXTENSIBLE) : sizeof(WAVEFORMATEX)
+	);
+
+	CoTaskMemFree(pMixFormat);
+
+	//A plain format keeps its tag, so the client still sees the format it gave, but gets the sample type and
+	//valid bits it implies, for the code that reads them from the extensible fields
+	if (pFormat->Format.wFormatTag != WAVE_FORMAT_EXTENSIBLE) {
+		pFormat->Format.cbSize = 0;
+		pFormat->Samples.wValidBitsPerSample = pFormat->Format.wBitsPerSample;
+		pFormat->SubFormat = pFormat->Format.wFormatTag == WAVE_FORMAT_IEEE_FLOAT ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+	}
+
+	*ppFormat = pFormat;
+
+	return S_OK;
+}
+
+UINT ListExclusiveRates(FLOAT SampleRate, DWORD MixRate, DWORD* pRates, UINT MaxRates) {
+	DWORD Candidates[MAX_EXCLUSIVE_RATES];
+	UINT CandidateCount = 0;
+	UINT Count = 0;
+
+	//The application's own rate comes first - if the device takes it, there's nothing to resample
+	Candidates[CandidateCount++] = (DWORD)(floor(SampleRate + 0.5f));
+	Candidates[CandidateCount++] = MixRate;
+
+	for (UINT i = 0; i < ARRAYSIZE(s_StandardRates) && CandidateCount < MAX_EXCLUSIVE_RATES; i++) {
+		Candidates[CandidateCount++] = s_StandardRates[i];
+	}
+
+	//Selection sort by distance from the application's rate, dropping duplicates.  Ties go to the
+	//higher rate, since resampling up loses nothing.
+	while (Count < MaxRates) {
+		UINT Best = CandidateCount;
+
+		for (UINT i = 0; i < CandidateCount; i++) {
+			if (Candidates[i] == 0) continue;
+
+			if (Best == CandidateCount) {
+				Best = i;
+			} else {
+				const FLOAT Distance = fabsf(FLOAT(Candidates[i]) - SampleRate);
+				const FLOAT BestDistance = fabsf(FLOAT(Candidates[Best]) - SampleRate);
+
+				if (Distance < BestDistance || (Distance == BestDistance && Candidates[i] > Candidates[Best])) {
+					Best = i;
+				}
+			}
+		}
+
+		if (Best == CandidateCount) break;
+
+		pRates[Count++] = Candidates[Best];
+
+		//Remove every copy of the rate just taken
+		for (UINT i = 0; i < CandidateCount; i++) {
+			if (Candidates[i] == pRates[Count - 1]) {
+				Candidates[i] = 0;
+			}
+		}
+	}
+
+	return Count;
+}
+
+HRESULT ChooseExclusiveFormat(IAudioClient* Client, FLOAT SampleRate, const WAVEFORMATEXTENSIBLE* pMixFormat, WAVEFORMATEXTENSIBLE* pFormat) {
+	DWORD Rates[MAX_EXCLUSIVE_RATES];
+	WAVEFORMATEXTENSIBLE Candidate;
+	const UINT RateCount = ListExclusiveRates(SampleRate, pMixFormat->Format.nSamplesPerSec, Rates, MAX_EXCLUSIVE_RATES);
+
+	//Channel layouts: the mix format's first (devices often only take their native channel count),
+	//then plain stereo.  Anything under two channels can't be used by the converters.
+	const WORD ChannelCounts[] = { pMixFormat->Format.nChannels, 2 };
+	const DWORD ChannelMasks[] = { pMixFormat->dwChannelMask, KSAUDIO_SPEAKER_STEREO };
+
+	for (UINT r = 0; r < RateCount; r++) {
+		for (UINT c = 0; c < ARRAYSIZE(ChannelCounts); c++) {
+			if (ChannelCounts[c] < 2 || (c != 0 && ChannelCounts[c] == ChannelCounts[0])) continue;
+
+			for (UINT f = 0; f < ARRAYSIZE(s_SampleFormats); f++) {
+				BuildClientFormat (
+					&Candidate,
+					Rates[r],
+					ChannelCounts[c],
+					ChannelMasks[c],
+					s_SampleFormats[f].BitsPerSample,
+					s_SampleFormats[f].ValidBits,
+					s_SampleFormats[f].IsFloat
+				);
+
+				//Exclusive mode never suggests a closest match, so the last argument must be NULL
+				if (Client->IsFormatSupported(AUDCLNT_SHAREMODE_EXCLUSIVE, (WAVEFORMATEX*)(&Candidate), NULL) == S_OK) {
+					*pFormat = Candidate;
+					return S_OK;
+				}
+			}
+		}
+	}
+
+	return AUDCLNT_E_UNSUPPORTED_FORMAT;
+}
+
+HRESULT InitializeExclusiveClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, UINT BufferPeriods, FLOAT SampleRate, WAVEFORMATEXTENSIBLE* pFormat, REFERENCE_TIME* pPeriod) {
+	HRESULT hr = S_OK;
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+	UINT32 BufferFrames = 0;
+
+	hr = ChooseExclusiveFormat (
+		Client,
+		SampleRate,
+		pFormat,
+		&Format
+	); if (FAILED(hr)) {
+		return hr;
+	}
+
+	//Exclusive streams can run at the device's minimum period
+	hr = Client->GetDevicePeriod (
+		nullptr,
+		&Period
+	); if (FAILED(hr)) {
+		return hr;
+	}
+
+	hr = Client->Initialize (
+		AUDCLNT_SHAREMODE_EXCLUSIVE,
+		StreamFlags,
+		Period * BufferPeriods,
+		Period,
+		(WAVEFORMATEX*)(&Format),
+		NULL
+	);
+
+	//The buffer must be aligned to the device's transfer size.  The client tells us the closest aligned
+	//size, but it can't be initialized twice, so a new one has to be created for the second attempt.
+	if (hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED) {
+		hr = Client->GetBufferSize (
+			&BufferFrames
+		);
+
+		if (SUCCEEDED(hr)) {
+			Period = (REFERENCE_TIME)(floor(10000000.0 * BufferFrames / BufferPeriods / Format.Format.nSamplesPerSec + 0.5));
+
+			ReactivateClient(Device, Client);
+
+			if (Client == nullptr) {
+				return E_FAIL;
+			}
+
+			hr = Client->Initialize (
+				AUDCLNT_SHAREMODE_EXCLUSIVE,
+				StreamFlags,
+				Period * BufferPeriods,
+				Period,
+				(WAVEFORMATEX*)(&Format),
+				NULL
+			);
+		}
+	}
+
+	//Hand back a clean client for the shared-mode fallback
+	if (FAILED(hr)) {
+		if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+			ReactivateClient(Device, Client);
+		}
+
+		return hr;
+	}
+
+	*pFormat = Format;
+	*pPeriod = Period;
+
+	return S_OK;
+}
+
+HRESULT InitializeEngineConversionClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Period, FLOAT SampleRate, WAVEFORMATEXTENSIBLE* pFormat) {
+	HRESULT hr = S_OK;
+	WAVEFORMATEXTENSIBLE Format;
+
+	//The application's own format - stereo floats at its sample rate
+	BuildClientFormat (
+		&Format,
+		(DWORD)(floor(SampleRate + 0.5f)),
+		2,
+		KSAUDIO_SPEAKER_STEREO,
+		32,
+		32,
+		true
+	);
+
+	hr = Client->Initialize (
+		AUDCLNT_SHAREMODE_SHARED,
+		StreamFlags | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
+		BufferDuration,
+		Period,
+		(WAVEFORMATEX*)(&Format),
+		NULL
+	);
+
+	//Hand back a clean client for the fallback
+	if (FAILED(hr)) {
+		if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+			ReactivateClient(Device, Client);
+		}
+
+		return hr;
+	}
+
+	*pFormat = Format;
+
+	return S_OK;
+}
+
+UINT32 ChooseRenderFrames(bool IsExclusiveEvent, UINT32 BufferFrames, UINT32 Padding, UINT32 AvailableFrames, UINT32* pDataFrames) {
+	//All of an exclusive event-driven buffer has been played by the time the event is set, whatever the padding says
+	const UINT32 FreeFrames = IsExclusiveEvent ? BufferFrames : Padding < BufferFrames ? BufferFrames - Padding : 0;
+
+	*pDataFrames = AvailableFrames < FreeFrames ? AvailableFrames : FreeFrames;
+
+	return IsExclusiveEvent ? FreeFrames : *pDataFrames;
+}
\ No newline at end of file
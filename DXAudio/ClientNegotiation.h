@@ -0,0 +1,98 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <Audioclient.h>
+#include "DXAudio.h"
+
+/* ClientNegotiation holds the logic shared by ClientReader and ClientWriter for choosing how an
+** IAudioClient is initialized, and how much of its buffer to ask for.  None of it touches the stream
+** objects, so it only depends on the client interfaces it's handed. */
+
+/* Chooses the shared-mode engine period to request, given the values reported by
+** IAudioClient3::GetSharedModeEnginePeriod() (all in frames).  This is the smallest supported
+** period, rounded up to a multiple of the fundamental period, or [DefaultPeriod] if the values
+** make no sense. */
+UINT32 ChooseEnginePeriod(UINT32 DefaultPeriod, UINT32 FundamentalPeriod, UINT32 MinPeriod, UINT32 MaxPeriod);
+
+/* Initializes [Client] in shared mode with the smallest period the audio engine supports for [Format],
+** through IAudioClient3::InitializeSharedAudioStream().  [StreamFlags] are AUDCLNT_STREAMFLAGS values.
+** On success, [pPeriodFrames] receives the period that was used.  If the engine period is already locked
+** by another stream, that period is used instead, on a fresh client from [Device].  Returns E_NOINTERFACE
+** if the client doesn't implement IAudioClient3 (before Windows 10).  On any failure, [Client] is an
+** uninitialized client - replaced with a fresh one from [Device] if an initialization was attempted - so the
+** caller can fall back to IAudioClient::Initialize(). */
+HRESULT InitializeLowLatencyClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, const WAVEFORMATEX* Format, UINT32* pPeriodFrames);
+
+/* Fills [pFormat] with an extensible PCM or floating-point format.  [ValidBits] may be less than
+** [BitsPerSample], as with 24-bit samples in a 32-bit container.  Used for exclusive-mode candidates
+** and for the format requested from the engine in engine-conversion mode. */
+VOID BuildClientFormat(WAVEFORMATEXTENSIBLE* pFormat, DWORD SampleRate, WORD Channels, DWORD ChannelMask, WORD BitsPerSample, WORD ValidBits, bool IsFloat);
+
+/* Fills [pDesc] with the description of [pFormat] that's reported to the application - a WAVEFORMATEX, or a
+** WAVEFORMATEXTENSIBLE if its tag says so. */
+VOID DescribeFormat(const WAVEFORMATEX* pFormat, DXAUDIO_ENDPOINT_FORMAT* pDesc);
+
+/* Retrieves [Client]'s mix format into [ppFormat], always in an allocation the size of a WAVEFORMATEXTENSIBLE, so
+** that the format chosen by InitializeExclusiveClient() or InitializeEngineConversionClient() can be stored over
+** it.  A plain WAVEFORMATEX keeps its tag, but has the extensible fields it implies filled in.  The format must be
+** freed with CoTaskMemFree(). */
+HRESULT GetClientMixFormat(IAudioClient* Client, WAVEFORMATEXTENSIBLE** ppFormat);
+
+/* Fills [pRates] with up to [MaxRates] candidate endpoint sample rates, ordered from closest to
+** [SampleRate] to furthest, and returns how many were written.  [MixRate] is always a candidate. */
+UINT ListExclusiveRates(FLOAT SampleRate, DWORD MixRate, DWORD* pRates, UINT MaxRates);
+
+/* Walks the candidate formats for an exclusive-mode stream with IsFormatSupported(), and stores the
+** first one [Client] accepts in [pFormat].  Rates closest to [SampleRate] are tried first, and for each
+** rate, sample formats are tried from the cheapest for us to convert (32-bit float) to the most expensive.
+** [pMixFormat] supplies the channel layout to try first.  Returns AUDCLNT_E_UNSUPPORTED_FORMAT if none
+** of them are accepted. */
+HRESULT ChooseExclusiveFormat(IAudioClient* Client, FLOAT SampleRate, const WAVEFORMATEXTENSIBLE* pMixFormat, WAVEFORMATEXTENSIBLE* pFormat);
+
+/* Initializes [Client] as an exclusive-mode stream on [Device] at the device's minimum period, in the
+** format chosen by ChooseExclusiveFormat().  [BufferPeriods] is the size of the buffer in periods, which
+** must be one for an event-driven stream.  [pFormat] must have room for a whole WAVEFORMATEXTENSIBLE (see
+** GetClientMixFormat()).  On success, it receives the format in use and [pPeriod] the period in 100-nanosecond
+** units.  On failure, [Client] is replaced with a fresh, uninitialized client from [Device], so the caller can
+** fall back to shared mode. */
+HRESULT InitializeExclusiveClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, UINT BufferPeriods, FLOAT SampleRate, WAVEFORMATEXTENSIBLE* pFormat, REFERENCE_TIME* pPeriod);
+
+/* Initializes [Client] in shared mode with 32-bit float stereo at [SampleRate] (rounded to the nearest
+** Hz), letting the audio engine convert to and from the mix format with AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM.
+** [BufferDuration] and [Period] are passed to IAudioClient::Initialize().  On success, [pFormat], which must
+** have room for a whole WAVEFORMATEXTENSIBLE (see GetClientMixFormat()), receives the format in use.  On
+** failure, [Client] is replaced with a fresh, uninitialized client from [Device], so the caller can fall back
+** to converting the mix format itself. */
+HRESULT InitializeEngineConversionClient(IMMDevice* Device, CComPtr<IAudioClient>& Client, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Period, FLOAT SampleRate, WAVEFORMATEXTENSIBLE* pFormat);
+
+/* Returns how many frames a render client's GetBuffer() should be asked for, and stores how many of them
+** [AvailableFrames] of data can fill in [pDataFrames].  A shared-mode or polled client takes up to the free
+** space, [BufferFrames] less [Padding], so only what there's data for is asked for.  An exclusive event-driven
+** client ([IsExclusiveEvent]) refuses anything but its whole buffer with AUDCLNT_E_BUFFER_SIZE_ERROR, so all
+** of it is asked for, and the caller must render the rest as silence. */
+UINT32 ChooseRenderFrames(bool IsExclusiveEvent, UINT32 BufferFrames, UINT32 Padding, UINT32 AvailableFrames, UINT32* pDataFrames);
\ No newline at end of file
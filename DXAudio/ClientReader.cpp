@@ -21,17 +21,41 @@
 */
 
 #include "ClientReader.h"
+#include "ClientNegotiation.h"
 #include <math.h>
+#include <malloc.h>
+#include <string.h>
 
 #define FILENAME L"ClientReader.cpp"
-#define RETURN_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return E_FAIL; } else return hr; }
+#define RETURN_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { NoteFailure(Line, hr); return E_FAIL; } else return hr; }
 #define HALT_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); m_Stream.Halt(); return; } else return; }
 
 ClientReader::ClientReader(CDXAudioStream& Stream) :
 m_Stream(Stream),
 m_ResampleState(nullptr),
-m_WaveFormat(nullptr)
-{ }
+m_WaveFormat(nullptr),
+m_DeviceID(nullptr),
+m_FailureLine(0),
+m_FailureResult(S_OK),
+m_CoalescePeriods(1),
+m_LocalBuffer(nullptr),
+m_LocalBufferFrames(0),
+m_LocalFrames(0),
+m_LocalSilentFrames(0),
+m_WasSilent(false),
+m_IsBypassing(false),
+m_SilentPhase(0.0),
+m_IsEngineConversion(false),
+m_IsRateMatched(false),
+m_SampleRate(0.0f),
+m_BatchPosition(0),
+m_BatchTime(0),
+m_IsEventDriven(false),
+m_IsFirstPacket(true),
+m_Period(0)
+{
+	ZeroMemory(&m_EndpointInfo, sizeof(m_EndpointInfo));
+}
 
 ClientReader::~ClientReader() {
 	//Free all dynamically allocated data
@@ -45,27 +69,48 @@ ClientReader::~ClientReader() {
 		CoTaskMemFree(m_WaveFormat);
 		m_WaveFormat = nullptr;
 	}
+
+	if (m_DeviceID != nullptr) {
+		CoTaskMemFree(m_DeviceID);
+		m_DeviceID = nullptr;
+	}
+
+	if (m_LocalBuffer != nullptr) {
+		_aligned_free(m_LocalBuffer);
+		m_LocalBuffer = nullptr;
+	}
 }
 
-HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback) {
+HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, UINT CoalescePeriods, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback) {
+	HRESULT hr = Prepare(IsLoopback, SampleRate, WaitEvent, Flags, CoalescePeriods, InputDevice, Callback);
+
+	if (SUCCEEDED(hr)) {
+		PublishEndpointInfo();
+	} else if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+		m_Callback->OnObjectFailure(FILENAME, m_FailureLine, m_FailureResult);
+	}
+
+	return hr;
+}
+
+VOID ClientReader::GetFailure(LPCWSTR* pFile, UINT* pLine, HRESULT* pResult) {
+	*pFile = FILENAME;
+	*pLine = m_FailureLine;
+	*pResult = m_FailureResult;
+}
+
+HRESULT ClientReader::Prepare(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, UINT CoalescePeriods, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback) {
 	HRESULT hr = S_OK;
 	BYTE* Buffer = nullptr;
+	DWORD StreamFlags = NULL;
+	bool IsClientInitialized = false;
+	DXAUDIO_ENDPOINT_INFO Info;
 	int error = 0;
 
-	m_Callback = Callback;
+	ZeroMemory(&Info, sizeof(Info));
 
-	//Create the SRC_STATE object
-	m_ResampleState = src_new (
-		SRC_SINC_FASTEST, //More than adequate for a real time stream
-		2,				  //Two channels (stereo)
-		&error
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); return E_FAIL;
-	}
+	m_Callback = Callback;
+	m_CoalescePeriods = (CoalescePeriods > 1) ? CoalescePeriods : 1;
 
 	//"Activate" the device (create the IAudioClient interface)
 	hr = InputDevice->Activate (
@@ -75,6 +120,11 @@ HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitE
 		(void**)(&m_Client)
 	); RETURN_HR(__LINE__);
 
+	//Note which device this is, so that the stream can tell which notifications concern it
+	hr = InputDevice->GetId (
+		&m_DeviceID
+	); RETURN_HR(__LINE__);
+
 	//Retrieves the device period - this is how often new information is provided
 	//to the stream, in 100-nanosecond units.
 	hr = m_Client->GetDevicePeriod (
@@ -85,20 +135,115 @@ HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitE
 	//Retrieves the mix format - this is the format in which the audio endpoint gives
 	//us the data.  This data will need to be resampled, so we need to know what form
 	//it's in.
-	hr = m_Client->GetMixFormat (
-		(WAVEFORMATEX**)(&m_WaveFormat)
+	hr = GetClientMixFormat (
+		m_Client,
+		&m_WaveFormat
 	); RETURN_HR(__LINE__);
 
-	//Initialize the client, marking how we're going to be using it
-	hr = m_Client->Initialize (
-		AUDCLNT_SHAREMODE_SHARED, //Always use shared - exclusive is meant for drivers and is unpredictable otherwise
-		WaitEvent ? AUDCLNT_STREAMFLAGS_EVENTCALLBACK : NULL | //Use an event callback if specified
-		IsLoopback ? AUDCLNT_STREAMFLAGS_LOOPBACK : NULL, //Make this a loopback stream if specified
-		m_Period, //Creates a buffer large enough to store one packet
-		m_Period, //Use the endpoint's periodicity (this can't ve any other value)
-		(WAVEFORMATEX*)(m_WaveFormat), //Pass in the wave format we just retrieved
-		NULL //No audio session stuff
-	); RETURN_HR(__LINE__);
+	DescribeFormat((WAVEFORMATEX*)(m_WaveFormat), &Info.MixFormat);
+
+	//In native-rate mode, the application runs at whatever rate the endpoint does
+	if (SampleRate == 0.0f) {
+		SampleRate = FLOAT(m_WaveFormat->Format.nSamplesPerSec);
+	}
+
+	m_SampleRate = SampleRate;
+
+	if (WaitEvent != NULL) {
+		StreamFlags |= AUDCLNT_STREAMFLAGS_EVENTCALLBACK; //Use an event callback if specified
+	}
+
+	if (IsLoopback) {
+		StreamFlags |= AUDCLNT_STREAMFLAGS_LOOPBACK; //Make this a loopback stream if specified
+	}
+
+	//In exclusive mode, try to take over the device in the format closest to what the application asked for,
+	//at its minimum period.  Loopback can't be exclusive.  If the device refuses (it may already be in use, or
+	//exclusive mode may be disallowed), fall back to shared mode below.
+	if ((Flags & DXAUDIO_STREAM_FLAG_EXCLUSIVE) && !IsLoopback) {
+		hr = InitializeExclusiveClient (
+			InputDevice,
+			m_Client,
+			StreamFlags,
+			WaitEvent ? 1 : m_CoalescePeriods * 2, //Event-driven streams must use a single-period buffer
+			SampleRate,
+			m_WaveFormat,
+			&m_Period
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+			Info.IsExclusive = TRUE;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		}
+	}
+
+	//In engine-conversion mode, ask for the application's own format and rate and let the audio engine do the
+	//conversion, so that libsamplerate isn't needed at all.  If the engine won't, fall back to converting the
+	//mix format ourselves below.
+	if (!IsClientInitialized && (Flags & DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION)) {
+		hr = InitializeEngineConversionClient (
+			InputDevice,
+			m_Client,
+			StreamFlags,
+			m_Period * (m_CoalescePeriods > 1 ? m_CoalescePeriods * 2 : 4), //Leave room for a few late periods, or two batches if coalescing
+			m_Period,
+			SampleRate,
+			m_WaveFormat
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+			m_IsEngineConversion = true;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		}
+	}
+
+	//In low-latency mode, try running the endpoint at the smallest period the engine supports.  Loopback
+	//captures whatever period the render side runs at, and coalescing wants long periods, so neither
+	//applies.  If the engine can't do it, fall back to the default period below.
+	if (!IsClientInitialized && (Flags & DXAUDIO_STREAM_FLAG_LOW_LATENCY) && !IsLoopback && m_CoalescePeriods == 1) {
+		hr = InitializeLowLatencyClient (
+			InputDevice,
+			m_Client,
+			StreamFlags,
+			(WAVEFORMATEX*)(m_WaveFormat),
+			&m_PeriodFrames
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_Period = REFERENCE_TIME(m_PeriodFrames) * 10000000 / m_WaveFormat->Format.nSamplesPerSec;
+			Info.IsLowLatency = TRUE;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		}
+	}
+
+	if (!IsClientInitialized) {
+		//Initialize the client, marking how we're going to be using it
+		hr = m_Client->Initialize (
+			AUDCLNT_SHAREMODE_SHARED, //Shared mode - exclusive mode either wasn't requested or was refused above
+			StreamFlags, //Event callback and/or loopback, as set up above
+			m_Period * (m_CoalescePeriods > 1 ? m_CoalescePeriods * 2 : 4), //Leave room for a few late periods, or two batches if coalescing
+			m_Period, //Use the endpoint's periodicity (this can't ve any other value)
+			(WAVEFORMATEX*)(m_WaveFormat), //Pass in the wave format we just retrieved
+			NULL //No audio session stuff
+		); RETURN_HR(__LINE__);
+
+		//Calculate the number of frames the endpoint is going to give us each period.
+		m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+	}
 
 	//Create the IAudioCaptureClient interface
 	hr = m_Client->GetService (
@@ -112,14 +257,62 @@ HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitE
 		); RETURN_HR(__LINE__);
 	}
 
-	//Calculate the number of frames the endpoint is going to give us each period.
-	m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+	m_IsEventDriven = WaitEvent != NULL;
 
 	//Calculate the resample ratio - this is the ratio of the output sample rate to the input sample rate, IE
 	//the sample rate specified by the application developer divided by the sample rate used by the endpoint.
 	//This value is used by libsamplerate.
 	m_ResampleRatio = DOUBLE(SampleRate) / DOUBLE(m_WaveFormat->Format.nSamplesPerSec); //Output sample rate / input sample rate
 
+	//If the client ended up at the application's own rate, there's nothing to resample - the samples only need
+	//converting, just as they do in engine-conversion mode
+	m_IsRateMatched = !m_IsEngineConversion && m_ResampleRatio == 1.0;
+
+	//Create the SRC_STATE object, if it's needed at all
+	if (!m_IsEngineConversion && !m_IsRateMatched) {
+		m_ResampleState = src_new (
+			SRC_SINC_FASTEST, //More than adequate for a real time stream
+			2,				  //Two channels (stereo)
+			&error
+		); if (error != 0) {
+			NoteFailure(__LINE__, E_FAIL);
+			return E_FAIL;
+		}
+	}
+
+	//Retrieve the size of the endpoint buffer, which is the most that can ever be waiting for us at once
+	hr = m_Client->GetBufferSize (
+		&m_LocalBufferFrames
+	); RETURN_HR(__LINE__);
+
+	//Allocate the buffer that converted frames are gathered in before resampling.  It can hold the whole
+	//endpoint buffer, so that a late wakeup can catch up on every packet at once, and at least one period
+	//more than a batch when coalescing.
+	if (m_LocalBufferFrames < m_PeriodFrames * (m_CoalescePeriods + 1)) {
+		m_LocalBufferFrames = m_PeriodFrames * (m_CoalescePeriods + 1);
+	}
+
+	m_LocalFrames = 0;
+	m_LocalBuffer = (FLOAT*)(_aligned_malloc(sizeof(FLOAT) * 2 * m_LocalBufferFrames, 64));
+
+	if (m_LocalBuffer == nullptr) {
+		NoteFailure(__LINE__, E_OUTOFMEMORY);
+		return E_FAIL;
+	}
+
+	//Keep a note of how the endpoint ended up being set up, for the stream
+	if (m_IsEngineConversion) {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_ENGINE;
+	} else if (m_IsRateMatched) {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_FORMAT_ONLY;
+	} else {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_LIBSAMPLERATE;
+	}
+
+	Info.SampleRate = m_WaveFormat->Format.nSamplesPerSec;
+	Info.PeriodFrames = m_PeriodFrames;
+	m_EndpointInfo = Info;
+
 	return S_OK;
 }
 
@@ -129,121 +322,301 @@ VOID ClientReader::Clean() {
 	m_Client.Release();
 	CoTaskMemFree(m_WaveFormat);
 	m_WaveFormat = nullptr;
+	CoTaskMemFree(m_DeviceID);
+	m_DeviceID = nullptr;
 	src_delete(m_ResampleState);
 	m_ResampleState = nullptr;
 	m_ResampleRatio = 0.0;
 	m_PeriodFrames = 0;
 	m_Period = 0;
+	m_IsEngineConversion = false;
+	m_IsRateMatched = false;
+	m_SampleRate = 0.0f;
+	m_BatchPosition = 0;
+	m_BatchTime = 0;
+	m_IsEventDriven = false;
+	m_LocalFrames = 0;
+	m_LocalSilentFrames = 0;
+	m_WasSilent = false;
+	m_IsBypassing = false;
+	m_SilentPhase = 0.0;
+
+	if (m_LocalBuffer != nullptr) {
+		_aligned_free(m_LocalBuffer);
+		m_LocalBuffer = nullptr;
+	}
+
+	m_LocalBufferFrames = 0;
+	m_LocalFrames = 0;
 }
 
 VOID ClientReader::Start() {
 	HRESULT hr = S_OK;
+
+	//A client that was never opened, because its device wasn't present at the time, has nothing to be started
+	if (m_Client == nullptr) {
+		return;
+	}
+
 	hr = m_Client->Start();
 	HALT_HR(__LINE__);
+
+	m_IsFirstPacket = true;
 }
 
 VOID ClientReader::Stop() {
 	HRESULT hr = S_OK;
+
+	//A client that was never opened, because its device wasn't present at the time, has nothing to be stopped
+	if (m_Client == nullptr) {
+		return;
+	}
+
 	hr = m_Client->Stop();
 	HALT_HR(__LINE__);
 }
 
-VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead) {
+VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead, bool& IsSilent) {
 	HRESULT hr = S_OK;
-	const UINT32 ExcessChannels = m_WaveFormat->Format.nChannels - 2;
+	UINT32 ExcessChannels = 0;
 	BYTE* ByteBuffer = nullptr;
 	UINT32 FramesToRead = 0;
+	UINT32 NextPacketFrames = 0;
+	UINT Packets = 0;
 	DWORD Flags = NULL;
-
-	//_alloca is safe here, as this is not recursive and only takes up a few KB at most
-	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * m_PeriodFrames));
-	FLOAT* LocalBufferIndex = LocalBuffer;
+	UINT64 DevicePosition = 0;
+	UINT64 QPCPosition = 0;
+	LONGLONG ConversionStart = 0;
+	LONGLONG ConversionTicks = 0; //Time spent converting, summed over every packet
+	FLOAT* LocalBufferIndex = nullptr;
 	SRC_DATA Data;
 	int error = 0;
 
-	//Start using the input data, reading only one packet.
-	hr = m_CaptureClient->GetBuffer (
-		&ByteBuffer,
-		&FramesToRead,
-		&Flags,
-		NULL,
-		NULL
-	);
+	FramesRead = 0;
+	IsSilent = false;
 
-	//If the buffer is empty, that probably means we're in the middle of switching properties.
-	//There is a slight delay between when the stream stops and the message is sent that
-	//a property was changed, in which case GetBuffer will return AUDCLNT_S_BUFFER_EMPTY.
-	//This should not happen in any other situation, as the input device always drives
-	//the wait event, which is only set once every period.
-	if (hr != AUDCLNT_S_BUFFER_EMPTY) {
-		HALT_HR(__LINE__);
-	} else return;
+	//A client that was never opened, because its device wasn't present at the time or it failed to open, has
+	//nothing to read
+	if (m_Client == nullptr) {
+		return;
+	}
 
-	//Convert the byte buffer into a stereo floating-point format and store
-	//in LocalBuffer
-	if (m_WaveFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) { //PCM data
-		if (m_WaveFormat->Samples.wValidBitsPerSample == 16) { //16-bit signed int
-			for (UINT i = 0; i < FramesToRead; i++) {
-				for (UINT j = 0; j < 2; j++) { //Two channels
-					*LocalBufferIndex++ = FLOAT(*((INT16*)(ByteBuffer))) / 32767; //Convert to normalized float [-1.0, 1.0]
-					ByteBuffer += sizeof(INT16); //Move the byte pointer to the next channel or sample
-				}
+	ExcessChannels = m_WaveFormat->Format.nChannels - 2;
+
+	do {
+		//Start using the input data, one packet at a time.
+		StreamTracer::Begin(TRACE_SPAN_GET_BUFFER);
+
+		hr = m_CaptureClient->GetBuffer (
+			&ByteBuffer,
+			&FramesToRead,
+			&Flags,
+			&DevicePosition,
+			&QPCPosition
+		);
+
+		StreamTracer::End(TRACE_SPAN_GET_BUFFER);
+
+		//If the buffer is empty, that probably means we're in the middle of switching properties.
+		//There is a slight delay between when the stream stops and the message is sent that
+		//a property was changed, in which case GetBuffer will return AUDCLNT_S_BUFFER_EMPTY.
+		//This should not happen in any other situation, as the input device always drives
+		//the wait event, which is only set once every period.
+		if (hr != AUDCLNT_S_BUFFER_EMPTY) {
+			HALT_HR(__LINE__);
+		} else break;
+
+		//A capture packet can only be released whole, or not at all.  If this one doesn't fit next to the batch
+		//gathered so far, it's left queued for the next call, once the batch has been handed on.  The local buffer
+		//holds at least the whole endpoint buffer, so a packet always fits into an empty one.
+		if (FramesToRead > m_LocalBufferFrames - m_LocalFrames) {
+			hr = m_CaptureClient->ReleaseBuffer (
+				0
+			); HALT_HR(__LINE__);
+
+			ByteBuffer = nullptr;
+			break;
+		}
 
-				//Ignore excess channels by skipping over those bytes
-				ByteBuffer += sizeof(INT16) * ExcessChannels;
-			}
-		} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //24-bit unsigned (never signed)
-			for (UINT i = 0; i < FramesToRead; i++) {
-				for (UINT j = 0; j < 2; j++) {
-					*LocalBufferIndex++ = (FLOAT(*((UINT32*)(ByteBuffer))) / 8388607) - 1.0f;
-					ByteBuffer += 3;
+		//Record any glitches the endpoint flagged.  The first packet after starting always claims a discontinuity,
+		//since there's nothing before it to follow on from, so that one isn't counted.
+		if ((Flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) && !m_IsFirstPacket) {
+			m_Stream.ReportGlitch(DXAUDIO_GLITCH_TYPE_DISCONTINUITY);
+		}
+
+		if (Flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) {
+			m_Stream.ReportGlitch(DXAUDIO_GLITCH_TYPE_TIMESTAMP_ERROR);
+		}
+
+		m_IsFirstPacket = false;
+
+		//The first packet of a batch marks where the data handed to the application starts
+		if (m_LocalFrames == 0) {
+			m_BatchPosition = DevicePosition;
+			m_BatchTime = (Flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) ? 0 : QPCPosition;
+		}
+
+		//Convert the byte buffer into a stereo floating-point format and append it to
+		//the local buffer
+		LocalBufferIndex = m_LocalBuffer + m_LocalFrames * 2;
+		ConversionStart = StreamPerformance::GetTicks();
+		StreamTracer::Begin(TRACE_SPAN_CONVERT);
+
+		if (Flags & AUDCLNT_BUFFERFLAGS_SILENT) { //Silence - the packet's contents are meaningless, so don't convert them
+			ZeroMemory(LocalBufferIndex, sizeof(FLOAT) * 2 * FramesToRead);
+			m_LocalSilentFrames += FramesToRead;
+		} else if (m_WaveFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) { //PCM data
+			if (m_WaveFormat->Samples.wValidBitsPerSample == 16) { //16-bit signed int
+				for (UINT i = 0; i < FramesToRead; i++) {
+					for (UINT j = 0; j < 2; j++) { //Two channels
+						*LocalBufferIndex++ = FLOAT(*((INT16*)(ByteBuffer))) / 32767; //Convert to normalized float [-1.0, 1.0]
+						ByteBuffer += sizeof(INT16); //Move the byte pointer to the next channel or sample
+					}
+
+					//Ignore excess channels by skipping over those bytes
+					ByteBuffer += sizeof(INT16) * ExcessChannels;
 				}
+			} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //Packed 24-bit signed int
+				for (UINT i = 0; i < FramesToRead; i++) {
+					for (UINT j = 0; j < 2; j++) {
+						//Assemble the three bytes and sign-extend them - reading a whole INT32 would run past the last sample
+						const INT32 Sample = INT32((UINT32(ByteBuffer[0]) | (UINT32(ByteBuffer[1]) << 8) | (UINT32(ByteBuffer[2]) << 16)) << 8) >> 8;
 
-				ByteBuffer += 3 * ExcessChannels;
+						*LocalBufferIndex++ = FLOAT(Sample) / 8388608;
+						ByteBuffer += 3;
+					}
+
+					ByteBuffer += 3 * ExcessChannels;
+				}
+			} else { //32-bit signed
+				for (UINT i = 0; i < FramesToRead; i++) {
+					for (UINT j = 0; j < 2; j++) {
+						*LocalBufferIndex++ = FLOAT(*((INT32*)(ByteBuffer))) / 2147483647;
+						ByteBuffer += sizeof(INT32);
+					}
+
+					ByteBuffer += sizeof(INT32) * ExcessChannels;
+				}
 			}
-		} else { //32-bit signed
+		} else { //32-bit floating-point
 			for (UINT i = 0; i < FramesToRead; i++) {
 				for (UINT j = 0; j < 2; j++) {
-					*LocalBufferIndex++ = FLOAT(*((INT32*)(ByteBuffer))) / 2147483647;
-					ByteBuffer += sizeof(INT32);
+					*LocalBufferIndex++ = *((FLOAT*)(ByteBuffer));
+					ByteBuffer += sizeof(FLOAT);
 				}
 
-				ByteBuffer += sizeof(INT32) * ExcessChannels;
+				ByteBuffer += sizeof(FLOAT) * ExcessChannels;
 			}
 		}
-	} else { //32-bit floating-point
-		for (UINT i = 0; i < FramesToRead; i++) {
-			for (UINT j = 0; j < 2; j++) {
-				*LocalBufferIndex++ = *((FLOAT*)(ByteBuffer));
-				ByteBuffer += sizeof(FLOAT);
-			}
 
-			ByteBuffer += sizeof(FLOAT) * ExcessChannels;
-		}
+		StreamTracer::End(TRACE_SPAN_CONVERT);
+		ConversionTicks += StreamPerformance::GetTicks() - ConversionStart;
+		m_LocalFrames += FramesToRead;
+		m_Stream.GetStreamPerformance().OnFramesIn(FramesToRead);
+		Packets++;
+
+		//We're done using the input data
+		StreamTracer::Begin(TRACE_SPAN_RELEASE_BUFFER);
+
+		hr = m_CaptureClient->ReleaseBuffer (
+			FramesToRead
+		);
+
+		StreamTracer::End(TRACE_SPAN_RELEASE_BUFFER);
+		HALT_HR(__LINE__);
+
+		ByteBuffer = nullptr;
+
+		//If the thread woke up late, more packets will be waiting.  Take every one of them now (as long
+		//as it fits), otherwise they would stay queued and the stream would fall permanently behind.
+		hr = m_CaptureClient->GetNextPacketSize (
+			&NextPacketFrames
+		); HALT_HR(__LINE__);
+	} while (NextPacketFrames != 0 && NextPacketFrames <= m_LocalBufferFrames - m_LocalFrames);
+
+	//Record how far behind this wakeup was
+	if (Packets != 0) {
+		m_Stream.GetStreamStatistics().OnCaptureWakeup(Packets);
+		m_Stream.GetStreamPerformance().OnConversion(ConversionTicks);
+	}
+
+	//The endpoint sets the event once per packet, so finding several waiting means we missed a deadline
+	if (Packets > 1 && m_IsEventDriven) {
+		m_Stream.ReportGlitch(DXAUDIO_GLITCH_TYPE_MISSED_DEADLINE);
+	}
+
+	//Nothing to resample yet - either there was no data, or the batch isn't complete.  A batch counts
+	//as complete once it holds more than (batch - 1) periods, since packet sizes can vary slightly.
+	if (m_LocalFrames == 0 || m_LocalFrames <= m_PeriodFrames * (m_CoalescePeriods - 1)) {
+		return;
+	}
+
+	//Let the stream know when this data was captured (the resampler's own short delay isn't accounted for)
+	m_Stream.SetCaptureTiming (
+		m_BatchPosition,
+		m_BatchTime,
+		m_WaveFormat->Format.nSamplesPerSec
+	);
+
+	IsSilent = m_LocalSilentFrames == m_LocalFrames;
+
+	//The engine has already converted the data to the application's rate, or the endpoint already runs at it, so
+	//there's nothing to resample
+	if (m_IsEngineConversion || m_IsRateMatched) {
+		memcpy(Buffer, m_LocalBuffer, sizeof(FLOAT) * 2 * m_LocalFrames);
+		FramesRead = m_LocalFrames;
+		m_LocalFrames = 0;
+		m_LocalSilentFrames = 0;
+		return;
 	}
 
-	//We're done using the input data
-	hr = m_CaptureClient->ReleaseBuffer (
-		FramesToRead
-	); HALT_HR(__LINE__);
+	//Once a whole batch of silence has gone through, the resampler holds nothing but zeros, and another silent
+	//batch would only produce more of them.  Skip it and produce the same number of frames it would have.
+	if (IsSilent && m_WasSilent) {
+		m_SilentPhase += DOUBLE(m_LocalFrames) * m_ResampleRatio;
+		FramesRead = (UINT)(m_SilentPhase) < BufferLength ? (UINT)(m_SilentPhase) : BufferLength;
+		m_SilentPhase -= FramesRead;
+
+		ZeroMemory(Buffer, sizeof(FLOAT) * 2 * FramesRead);
+
+		m_LocalFrames = 0;
+		m_LocalSilentFrames = 0;
+		m_IsBypassing = true;
+		return;
+	}
+
+	//Sound is back - start the resampler from scratch, which is exactly the state silence would have left it in
+	if (m_IsBypassing) {
+		src_reset(m_ResampleState);
+		m_IsBypassing = false;
+		m_SilentPhase = 0.0;
+	}
 
-	ByteBuffer = nullptr;
+	m_WasSilent = IsSilent;
 
 	//Fill the SRC_DATA structure
-	Data.data_in = LocalBuffer;	//Use the converted stereo samples
+	Data.data_in = m_LocalBuffer; //Use the converted stereo samples
 	Data.data_out = Buffer;	//Store the result in the output buffer
 	Data.end_of_input = 0; //Since this is realtime, there is never an end of input
-	Data.input_frames = FramesToRead; //This is equal to m_PeriodFrames
+	Data.input_frames = m_LocalFrames; //Every packet read this wakeup (usually m_PeriodFrames), or a whole batch when coalescing
 	Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
 	Data.output_frames = BufferLength; //Notify src_process of the length of the output buffer (always enough to store everything)
 	Data.output_frames_gen = 0;	//Zero out this value (it's an out value generated by src_process)
 	Data.src_ratio = m_ResampleRatio; //Use the current resample ratio
 
 	//Resample the data to the sample rate specified by the application developer
+	ConversionStart = StreamPerformance::GetTicks();
+	StreamTracer::Begin(TRACE_SPAN_RESAMPLE);
+
 	error = src_process (
 		m_ResampleState,
 		&Data
-	); if (error != 0) {
+	);
+
+	StreamTracer::End(TRACE_SPAN_RESAMPLE);
+	m_Stream.GetStreamPerformance().OnResample(StreamPerformance::GetTicks() - ConversionStart);
+
+	if (error != 0) {
 		m_Callback->OnObjectFailure (
 			FILENAME,
 			__LINE__,
@@ -251,6 +624,9 @@ VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead) {
 		); m_Stream.Halt(); return;
 	}
 
+	m_LocalFrames = 0;
+	m_LocalSilentFrames = 0;
+
 	//Let the application developer know how many samples are available
 	FramesRead = Data.output_frames_gen;
 }
@@ -261,6 +637,11 @@ HRESULT ClientReader::VerifyClient() {
 	//This will return AUDCLNT_E_DEVICE_INVALIDATED if the IAudioClient object
 	//becomes outdated.  This occurs if a property has been changed, such as
 	//the sample rate or bit depth of the endpoint.  Otherwise, it will return S_OK,
-	//verifying that the client is still valid.
+	//verifying that the client is still valid.  A client that was never opened, because its
+	//device wasn't present at the time, counts as outdated.
+	if (m_Client == nullptr) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
 	return m_Client->GetBufferSize(&BufferFrames);
 }
\ No newline at end of file
@@ -26,6 +26,7 @@
 #include <atlbase.h>
 #include <mmdeviceapi.h>
 #include <Audioclient.h>
+#include <math.h>
 #include "DXAudio.h"
 #include "samplerate.h"
 #include "CDXAudioStream.h"
@@ -41,9 +42,26 @@ public:
 	/* This initializes the reader by creating the necessary interfaces and data.  [IsLoopback] is
 	** used to indicate whether or not this is a loopback stream.  [SampleRate] is the desired sample
 	** rate to be used by the stream callback.  The endpoint data will automatically be resampled
-	** to this format.  [WaitEvent] is the event handle for the event callback mechanism - if NULL,
-	** there will be no event callback on this end. */
-	HRESULT Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback);
+	** to this format - if it's zero, the endpoint's own rate is used (see GetSampleRate()).
+	** [WaitEvent] is the event handle for the event callback mechanism - if NULL, there will be no
+	** event callback on this end.  [Flags] are the stream's DXAUDIO_STREAM_FLAG values.
+	** [CoalescePeriods] is the number of device periods to gather before resampling them in one chunk and
+	** returning them from Read() - one for every period. */
+	HRESULT Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, UINT CoalescePeriods, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback);
+
+	/* This does everything Initialize() does except tell the stream how the endpoint was set up and report failures,
+	** so that it can be called on a thread other than the stream thread to prepare a standby reader.
+	** PublishEndpointInfo() has to be called on the stream thread once the reader is put to use, and failures other
+	** than AUDCLNT_E_DEVICE_INVALIDATED reported there from GetFailure(). */
+	HRESULT Prepare(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, UINT CoalescePeriods, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback);
+
+	/* Tells where and why the last call to Prepare() failed, with the HRESULT it failed on rather than E_FAIL */
+	VOID GetFailure(LPCWSTR* pFile, UINT* pLine, HRESULT* pResult);
+
+	/* Passes the endpoint info gathered by Prepare() on to the stream. */
+	VOID PublishEndpointInfo() {
+		m_Stream.SetEndpointInfo(true, m_EndpointInfo, m_DeviceID);
+	}
 
 	/* This releases all interfaces and dynamically allocated data and sets the object to a pre-initialized state. */
 	VOID Clean();
@@ -54,10 +72,12 @@ public:
 	/* This stops the stream. */
 	VOID Stop();
 
-	/* This should be called to read the input data from the stream.  [BufferLength] is the size of the buffer,
-	** which may or may not be the expected number of frames to be generated.  [FramesRead] stores the actual
-	** number of frames read from the input stream. */
-	VOID Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead);
+	/* This should be called to read the input data from the stream.  Every packet waiting in the endpoint
+	** buffer is read, converted and resampled together.  [BufferLength] is the size of the buffer, which should
+	** be GetMaxReadFrames().  [FramesRead] stores the actual number of frames read from the input stream.
+	** When coalescing, this is zero until a full batch of periods has been gathered.  [IsSilent] is set if the
+	** endpoint flagged every packet that went into the result as silent. */
+	VOID Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead, bool& IsSilent);
 
 	/* This determines if the client is still in a valid, usable state. */
 	HRESULT VerifyClient();
@@ -73,12 +93,29 @@ public:
 	}
 
 
+	/* Returns the sample rate the application runs at - the one given to Initialize(), or the endpoint's own if
+	** that was zero. */
+	FLOAT GetSampleRate() {
+		return m_SampleRate;
+	}
+
 	/* Returns the resample ratio, which is equal to (application sample rate) / (endpoint sample rate) */
 	DOUBLE GetRatio() {
 		return m_ResampleRatio;
 	}
 
+	/* Returns the largest number of frames a single call to Read() can produce at the application sample rate */
+	UINT GetMaxReadFrames() {
+		return (UINT)(ceil(DOUBLE(m_LocalBufferFrames) * m_ResampleRatio)) + 1;
+	}
+
 private:
+	/* Keeps a note of a failure in Prepare() for GetFailure() */
+	VOID NoteFailure(UINT Line, HRESULT hr) {
+		m_FailureLine = Line;
+		m_FailureResult = hr;
+	}
+
 	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting
 	CComPtr<IAudioClient> m_Client; //Audio client interface (WASAPI)
 	CComPtr<IAudioCaptureClient> m_CaptureClient; //Capture client interface (WASAPI)
@@ -86,6 +123,25 @@ private:
 	DOUBLE m_ResampleRatio; //The resample ratio for the stream
 	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object)
 	UINT32 m_PeriodFrames; //Number of frames in a period
+	UINT m_CoalescePeriods; //Number of periods gathered before resampling
+	FLOAT* m_LocalBuffer; //Converted stereo frames waiting to be resampled
+	UINT32 m_LocalBufferFrames; //Capacity of m_LocalBuffer in frames (at least the endpoint buffer size)
+	UINT32 m_LocalFrames; //Number of frames currently in m_LocalBuffer
+	UINT32 m_LocalSilentFrames; //Number of those frames the endpoint flagged as silent
+	bool m_WasSilent; //True if the previous batch was silent, so the resampler holds nothing but zeros
+	bool m_IsBypassing; //True while silent batches skip the resampler (it must be reset before it's used again)
+	DOUBLE m_SilentPhase; //Fractional output frame carried between bypassed batches
+	bool m_IsEngineConversion; //True if the audio engine converts to the application's rate, so libsamplerate is bypassed
+	bool m_IsRateMatched; //True if the client runs at the application's rate, so libsamplerate isn't needed either
+	FLOAT m_SampleRate; //The application's sample rate - the endpoint's own in native-rate mode
+	UINT64 m_BatchPosition; //Device position of the first frame in m_LocalBuffer
+	UINT64 m_BatchTime; //Capture time of the first frame in m_LocalBuffer (zero if the endpoint reported a timestamp error)
+	bool m_IsEventDriven; //True if the endpoint sets the wait event, so more than one packet per wakeup means we were late
+	DXAUDIO_ENDPOINT_INFO m_EndpointInfo; //How the endpoint was set up, as passed on by PublishEndpointInfo()
+	LPWSTR m_DeviceID; //The endpoint device's unique identifier, also passed on by PublishEndpointInfo()
+	UINT m_FailureLine; //Where the last call to Prepare() failed, as returned by GetFailure()
+	HRESULT m_FailureResult; //Why it failed
+	bool m_IsFirstPacket; //True until the first packet after Start() has been read (it's always flagged as a discontinuity)
 	REFERENCE_TIME m_Period; //Periodicity of the endpoint
 	CDXAudioStream& m_Stream; //Stream reference
 };
\ No newline at end of file
@@ -21,17 +21,49 @@
 */
 
 #include "ClientWriter.h"
+#include "ClientNegotiation.h"
 #include <math.h>
+#include <malloc.h>
 
 #define FILENAME L"ClientWriter.cpp"
-#define RETURN_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return E_FAIL; } else return hr; }
+#define RETURN_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { NoteFailure(Line, hr); return E_FAIL; } else return hr; }
 #define HALT_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); m_Stream.Halt(); return; } else return; }
 
+//Adaptive mode: the margin grows by half a period after every underrun, and shrinks by an eighth of a
+//period after ADAPT_SHRINK_PERIODS periods (about 10 seconds) of the callback using under a quarter of its budget.
+#define ADAPT_GROW_DIVISOR 2
+#define ADAPT_SHRINK_DIVISOR 8
+#define ADAPT_SHRINK_PERIODS 1000
+
 ClientWriter::ClientWriter(CDXAudioStream& Stream) :
 m_Stream(Stream),
 m_ResampleState(nullptr),
-m_WaveFormat(nullptr)
-{ }
+m_WaveFormat(nullptr),
+m_DeviceID(nullptr),
+m_FailureLine(0),
+m_FailureResult(S_OK),
+m_PeriodFrames(0),
+m_BufferFrames(0),
+m_LocalBuffer(nullptr),
+m_ClockFrequency(0),
+m_FramesWritten(0),
+m_LastPadding(0),
+m_WasSilent(false),
+m_IsBypassing(false),
+m_SilentFrames(0.0),
+m_LatencyMode(DXAUDIO_LATENCY_MODE_DEFAULT),
+m_MarginFrames(0),
+m_MinMarginFrames(0),
+m_MaxMarginFrames(0),
+m_TrimFrames(0),
+m_FastPeriods(0),
+m_IsEngineConversion(false),
+m_IsRateMatched(false),
+m_IsExclusiveEvent(false),
+m_SampleRate(0.0f)
+{
+	ZeroMemory(&m_EndpointInfo, sizeof(m_EndpointInfo));
+}
 
 ClientWriter::~ClientWriter() {
 	//Free all dynamically allocated data
@@ -45,27 +77,48 @@ ClientWriter::~ClientWriter() {
 		CoTaskMemFree(m_WaveFormat);
 		m_WaveFormat = nullptr;
 	}
+
+	if (m_DeviceID != nullptr) {
+		CoTaskMemFree(m_DeviceID);
+		m_DeviceID = nullptr;
+	}
+
+	if (m_LocalBuffer != nullptr) {
+		_aligned_free(m_LocalBuffer);
+		m_LocalBuffer = nullptr;
+	}
+}
+
+HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, DXAUDIO_LATENCY_MODE LatencyMode, UINT PrefillFrames, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback) {
+	HRESULT hr = Prepare(SampleRate, WaitEvent, Flags, LatencyMode, PrefillFrames, OutputDevice, Callback);
+
+	if (SUCCEEDED(hr)) {
+		PublishEndpointInfo();
+	} else if (hr != AUDCLNT_E_DEVICE_INVALIDATED) {
+		m_Callback->OnObjectFailure(FILENAME, m_FailureLine, m_FailureResult);
+	}
+
+	return hr;
 }
 
-HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback) {
+VOID ClientWriter::GetFailure(LPCWSTR* pFile, UINT* pLine, HRESULT* pResult) {
+	*pFile = FILENAME;
+	*pLine = m_FailureLine;
+	*pResult = m_FailureResult;
+}
+
+HRESULT ClientWriter::Prepare(FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, DXAUDIO_LATENCY_MODE LatencyMode, UINT PrefillFrames, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback) {
 	HRESULT hr = S_OK;
 	BYTE* Buffer = nullptr;
+	DWORD StreamFlags = WaitEvent ? AUDCLNT_STREAMFLAGS_EVENTCALLBACK : NULL; //Use an event callback if specified
+	bool IsClientInitialized = false;
+	DXAUDIO_ENDPOINT_INFO Info;
 	int error = 0;
 
-	m_Callback = Callback;
+	ZeroMemory(&Info, sizeof(Info));
 
-	//Create the SRC_STATE object
-	m_ResampleState = src_new (
-		SRC_SINC_FASTEST, //More than adequate for a real time stream
-		2,				  //Two channels (stereo)
-		&error
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); return E_FAIL;
-	}
+	m_Callback = Callback;
+	m_LatencyMode = LatencyMode;
 
 	//"Activate" the device (create the IAudioClient interface)
 	hr = OutputDevice->Activate (
@@ -75,6 +128,11 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 		(void**)(&m_Client)
 	); RETURN_HR(__LINE__);
 
+	//Note which device this is, so that the stream can tell which notifications concern it
+	hr = OutputDevice->GetId (
+		&m_DeviceID
+	); RETURN_HR(__LINE__);
+
 	//Retrieves the device period - this is how often we need to provide new information
 	//to the stream, in 100-nanosecond units.
 	hr = m_Client->GetDevicePeriod (
@@ -84,25 +142,154 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 
 	//Retrieves the mix format - this is the format in which we must deliver the audio data
 	//to the endpoint.
-	hr = m_Client->GetMixFormat (
-		(WAVEFORMATEX**)(&m_WaveFormat)
+	hr = GetClientMixFormat (
+		m_Client,
+		&m_WaveFormat
 	); RETURN_HR(__LINE__);
 
-	//Initialize the client, marking how we're going to be using it
-	hr = m_Client->Initialize (
-		AUDCLNT_SHAREMODE_SHARED, //Always use shared - exclusive is meant for drivers and is unpredictable otherwise
-		WaitEvent ? AUDCLNT_STREAMFLAGS_EVENTCALLBACK : NULL, //Use an event callback if specified
-		m_Period * 4, //Creates a buffer large enough to store four packets - important for duplex streams
-		m_Period, //Use the endpoint's periodicity (this can't ve any other value)
-		(WAVEFORMATEX*)(m_WaveFormat), //Pass in the wave format we just retrieved
-		NULL //No audio session stuff
-	); RETURN_HR(__LINE__);
+	DescribeFormat((WAVEFORMATEX*)(m_WaveFormat), &Info.MixFormat);
+
+	//In native-rate mode, the application runs at whatever rate the endpoint does
+	if (SampleRate == 0.0f) {
+		SampleRate = FLOAT(m_WaveFormat->Format.nSamplesPerSec);
+	}
+
+	m_SampleRate = SampleRate;
+
+	//Calculate the resample ratio - this is the ratio of the output sample rate to the input sample rate, IE
+	//the sample rate specified used by the endpoint divided by that which is specified by the application developer.
+	//This value is used by libsamplerate.
+	m_ResampleRatio = DOUBLE(m_WaveFormat->Format.nSamplesPerSec) / DOUBLE(SampleRate);
+
+	//In exclusive mode, try to take over the device in the format closest to what the application asked for,
+	//at its minimum period.  If the device refuses (it may already be in use, or exclusive mode may be
+	//disallowed), fall back to shared mode below.
+	if (Flags & DXAUDIO_STREAM_FLAG_EXCLUSIVE) {
+		hr = InitializeExclusiveClient (
+			OutputDevice,
+			m_Client,
+			StreamFlags,
+			WaitEvent ? 1 : 4, //Event-driven streams must use a single-period buffer
+			SampleRate,
+			m_WaveFormat,
+			&m_Period
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+			m_ResampleRatio = DOUBLE(m_WaveFormat->Format.nSamplesPerSec) / DOUBLE(SampleRate);
+			ChooseMargin(PrefillFrames);
+			m_IsExclusiveEvent = WaitEvent != NULL;
+			Info.IsExclusive = TRUE;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		}
+	}
+
+	//In engine-conversion mode, give the audio engine the application's own format and rate and let it do the
+	//conversion, so that libsamplerate isn't needed at all.  If the engine won't, fall back to converting to
+	//the mix format ourselves below.
+	if (!IsClientInitialized && (Flags & DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION)) {
+		m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period) * SampleRate / 10000000));
+		m_ResampleRatio = 1.0;
+		ChooseMargin(PrefillFrames);
+
+		hr = InitializeEngineConversionClient (
+			OutputDevice,
+			m_Client,
+			StreamFlags,
+			m_Period * ChooseBufferPeriods(),
+			m_Period,
+			SampleRate,
+			m_WaveFormat
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+			m_IsEngineConversion = true;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		} else {
+			m_ResampleRatio = DOUBLE(m_WaveFormat->Format.nSamplesPerSec) / DOUBLE(SampleRate);
+		}
+	}
+
+	//In low-latency mode, try running the endpoint at the smallest period the engine supports.  The engine
+	//chooses the buffer size in that case.  If it can't be done, fall back to the default period below.
+	if (!IsClientInitialized && (Flags & DXAUDIO_STREAM_FLAG_LOW_LATENCY)) {
+		hr = InitializeLowLatencyClient (
+			OutputDevice,
+			m_Client,
+			StreamFlags,
+			(WAVEFORMATEX*)(m_WaveFormat),
+			&m_PeriodFrames
+		);
+
+		if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+			return hr;
+		} else if (SUCCEEDED(hr)) {
+			m_Period = REFERENCE_TIME(m_PeriodFrames) * 10000000 / m_WaveFormat->Format.nSamplesPerSec;
+			ChooseMargin(PrefillFrames);
+			Info.IsLowLatency = TRUE;
+			IsClientInitialized = true;
+		} else if (m_Client == nullptr) {
+			RETURN_HR(__LINE__);
+		}
+	}
+
+	if (!IsClientInitialized) {
+		//Calculate the number of frames the endpoint is going to need from us each period.
+		m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+
+		ChooseMargin(PrefillFrames);
+
+		//Initialize the client, marking how we're going to be using it
+		hr = m_Client->Initialize (
+			AUDCLNT_SHAREMODE_SHARED, //Shared mode - exclusive mode either wasn't requested or was refused above
+			StreamFlags, //Use an event callback if specified
+			m_Period * ChooseBufferPeriods(), //Creates a buffer large enough to store the margin and a few packets - important for duplex streams
+			m_Period, //Use the endpoint's periodicity (this can't ve any other value)
+			(WAVEFORMATEX*)(m_WaveFormat), //Pass in the wave format we just retrieved
+			NULL //No audio session stuff
+		); RETURN_HR(__LINE__);
+	}
+
+	//If the client ended up at the application's own rate, there's nothing to resample - the samples only need
+	//converting, just as they do in engine-conversion mode
+	m_IsRateMatched = !m_IsEngineConversion && m_ResampleRatio == 1.0;
+
+	//Create the SRC_STATE object, if it's needed at all
+	if (!m_IsEngineConversion && !m_IsRateMatched) {
+		m_ResampleState = src_new (
+			SRC_SINC_FASTEST, //More than adequate for a real time stream
+			2,				  //Two channels (stereo)
+			&error
+		); if (error != 0) {
+			NoteFailure(__LINE__, E_FAIL);
+			return E_FAIL;
+		}
+	}
 
 	//Create the IAudioRenderClient interface
 	hr = m_Client->GetService (
 		IID_PPV_ARGS(&m_RenderClient)
 	); RETURN_HR(__LINE__);
 
+	//Create the IAudioClock interface, which tells us how far playback has progressed
+	hr = m_Client->GetService (
+		IID_PPV_ARGS(&m_Clock)
+	); RETURN_HR(__LINE__);
+
+	hr = m_Clock->GetFrequency (
+		&m_ClockFrequency
+	); RETURN_HR(__LINE__);
+
 	//If using an event callback mechanism, provide the event handle (this is from CDXAudioStream)
 	if (WaitEvent != NULL) {
 		hr = m_Client->SetEventHandle (
@@ -110,28 +297,69 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 		); RETURN_HR(__LINE__);
 	}
 
-	//Calculate the number of frames the endpoint is going to need from us each period.
-	m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+	//Retrieve the actual size of the endpoint buffer, which may be larger than what we asked for
+	hr = m_Client->GetBufferSize (
+		&m_BufferFrames
+	); RETURN_HR(__LINE__);
+
+	//Allocate the scratch buffer - a single render can never be larger than the endpoint buffer
+	m_LocalBuffer = (FLOAT*)(_aligned_malloc(sizeof(FLOAT) * 2 * m_BufferFrames, 64));
+
+	if (m_LocalBuffer == nullptr) {
+		NoteFailure(__LINE__, E_OUTOFMEMORY);
+		return E_FAIL;
+	}
+
+	//Allocate the carry-over FIFO.  Whatever the endpoint can't take right away waits here, so it needs
+	//room for a full endpoint buffer on top of what a single call can produce.
+	hr = m_Carry.Initialize (
+		m_BufferFrames * 2
+	); RETURN_HR(__LINE__);
+
+	//The margin can never take up the whole buffer - there must be room left to write a period into
+	m_MaxMarginFrames = m_BufferFrames > m_PeriodFrames * 2 ? m_BufferFrames - m_PeriodFrames : m_PeriodFrames;
+
+	if (m_MarginFrames > m_MaxMarginFrames) {
+		m_MarginFrames = m_MaxMarginFrames;
+	}
+
+	//An exclusive event-driven endpoint is always given its whole buffer, starting with the silence below
+	if (m_IsExclusiveEvent) {
+		m_MarginFrames = m_BufferFrames;
+	}
+
+	m_TrimFrames = 0;
+	m_FastPeriods = 0;
 
-	//We need to initialize the client with a little bit of slience.  The endpoint requires one period
-	//worth of silence before Start() is called to even work.  We should give it two just in case the stream
-	//runs a little bit behind to prevent pops and clicks, which happen even under a light CPU load.
-	//This increases latency by ~10ms, but that's a tradeoff we have to take for the audio to "sound good."
+	//We need to initialize the client with the margin's worth of silence.  The endpoint requires one period
+	//worth of silence before Start() is called to even work; anything more is a safety net against the
+	//stream running behind, at the cost of latency.
 	hr = m_RenderClient->GetBuffer (
-		m_PeriodFrames * 2,
+		m_MarginFrames,
 		&Buffer
 	); RETURN_HR(__LINE__);
 
 	//ReleaseBuffer() has to be called to unlock the buffer resource for the audio engine to use.
 	hr = m_RenderClient->ReleaseBuffer (
-		m_PeriodFrames * 2,
+		m_MarginFrames,
 		AUDCLNT_BUFFERFLAGS_SILENT
 	); RETURN_HR(__LINE__);
 
-	//Calculate the resample ratio - this is the ratio of the output sample rate to the input sample rate, IE
-	//the sample rate specified used by the endpoint divided by that which is specified by the application developer.
-	//This value is used by libsamplerate.
-	m_ResampleRatio = DOUBLE(m_WaveFormat->Format.nSamplesPerSec) / DOUBLE(SampleRate);
+	m_FramesWritten = m_MarginFrames;
+	m_LastPadding = m_MarginFrames;
+
+	//Keep a note of how the endpoint ended up being set up, for the stream
+	if (m_IsEngineConversion) {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_ENGINE;
+	} else if (m_IsRateMatched) {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_FORMAT_ONLY;
+	} else {
+		Info.ConversionPath = DXAUDIO_CONVERSION_PATH_LIBSAMPLERATE;
+	}
+
+	Info.SampleRate = m_WaveFormat->Format.nSamplesPerSec;
+	Info.PeriodFrames = m_PeriodFrames;
+	m_EndpointInfo = Info;
 
 	return S_OK;
 }
@@ -139,89 +367,351 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 VOID ClientWriter::Clean() {
 	//Release all interfaces, free all memory, zero all values...
 	m_RenderClient.Release();
+	m_Clock.Release();
 	m_Client.Release();
 	CoTaskMemFree(m_WaveFormat);
 	m_WaveFormat = nullptr;
+	CoTaskMemFree(m_DeviceID);
+	m_DeviceID = nullptr;
 	src_delete(m_ResampleState);
 	m_ResampleState = nullptr;
 	m_ResampleRatio = 0.0;
 	m_PeriodFrames = 0;
+	m_BufferFrames = 0;
 	m_Period = 0;
+	m_IsEngineConversion = false;
+	m_IsRateMatched = false;
+	m_IsExclusiveEvent = false;
+	m_SampleRate = 0.0f;
+	m_MarginFrames = 0;
+	m_TrimFrames = 0;
+	m_FastPeriods = 0;
+	m_ClockFrequency = 0;
+	m_FramesWritten = 0;
+	m_LastPadding = 0;
+	m_WasSilent = false;
+	m_IsBypassing = false;
+	m_SilentFrames = 0.0;
+	m_Carry.Clean();
+
+	if (m_LocalBuffer != nullptr) {
+		_aligned_free(m_LocalBuffer);
+		m_LocalBuffer = nullptr;
+	}
 }
 
 VOID ClientWriter::Start() {
 	HRESULT hr = S_OK;
+
+	//A client that was never opened, because its device wasn't present at the time, has nothing to be started
+	if (m_Client == nullptr) {
+		return;
+	}
+
 	hr = m_Client->Start();
 	HALT_HR(__LINE__);
+
+	UpdatePresentationTiming();
 }
 
 VOID ClientWriter::Stop() {
 	HRESULT hr = S_OK;
+
+	//A client that was never opened, because its device wasn't present at the time, has nothing to be stopped
+	if (m_Client == nullptr) {
+		return;
+	}
+
 	hr = m_Client->Stop();
 	HALT_HR(__LINE__);
 }
 
-VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
+VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength, bool IsSilent) {
 	HRESULT hr = S_OK;
-	UINT32 ExcessChannels = m_WaveFormat->Format.nChannels - 2;
+	UINT32 Padding = 0;
+	UINT32 FramesToWrite = 0;
+	UINT32 DataFrames = 0;
 	BYTE* ByteBuffer = nullptr;
-
-	//_alloca is safe here, as this is not recursive and only takes up a few KB at most
-	//The size of the local buffer needs to be larger than just its period frames in the
-	//case that the periodicity of the input device on a duplex stream is greater than
-	//the periodicity of the output device.  Multiplying its period frames by 1.5
-	//provides for adequate uncertainty.
-	const UINT LocalBufferSize = (UINT)(m_PeriodFrames * 1.5);
-	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * LocalBufferSize));
-	FLOAT* LocalBufferIndex = LocalBuffer;
 	SRC_DATA Data;
 	int error = 0;
+	LONGLONG StageStart = 0;
 
-	LocalBufferIndex = LocalBuffer;
-
-	//Start by resampling the data given to us by the application developer.
+	//Start by resampling the data given to us by the application developer.  The input is fed through
+	//in as many passes as it takes to fit the scratch buffer, and every pass is queued on the carry-over
+	//FIFO, so nothing src_process produces is ever thrown away.
 	Data.data_in = Buffer; //Use the data given to us
-	Data.data_out = LocalBuffer; //Store the resampled frames in the local buffer
+	Data.input_frames = BufferLength; //This is usually m_PeriodFrames / m_ResampleRatio
 	Data.end_of_input = 0; //Since this is realtime, there is never an end of input
-	Data.input_frames = BufferLength; //This is equal to m_PeriodFrames / m_ResampleRatio
-	Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
-	Data.output_frames = LocalBufferSize; //This is the number of frames to give the endpoint
-	Data.output_frames_gen = 0; //Zero out this value (it's an out value generated by src_process)
 	Data.src_ratio = m_ResampleRatio; //Use the current resample ratio
 
-	//Resample the data to the sample rate used by the endpoint
-	error = src_process (
-		m_ResampleState,
-		&Data
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); m_Stream.Halt(); return;
+	//Once a whole write of silence has gone through, the resampler holds nothing but zeros and another silent
+	//write would only produce more of them.  Just count the frames it would have produced, and render them
+	//behind the carry-over FIFO with AUDCLNT_BUFFERFLAGS_SILENT instead of converting anything.
+	if (IsSilent && m_WasSilent) {
+		m_SilentFrames += m_IsEngineConversion ? DOUBLE(BufferLength) : DOUBLE(BufferLength) * m_ResampleRatio;
+		m_IsBypassing = true;
+		Data.input_frames = 0;
+	} else {
+		//Sound is back - whatever silence is still owed goes ahead of it, and the resampler starts from scratch,
+		//which is exactly the state silence would have left it in
+		if (m_IsBypassing) {
+			ZeroMemory(m_LocalBuffer, sizeof(FLOAT) * 2 * m_BufferFrames);
+
+			m_Carry.Write (
+				m_LocalBuffer,
+				(UINT)(m_SilentFrames) < m_BufferFrames ? (UINT)(m_SilentFrames) : m_BufferFrames
+			);
+
+			if (m_ResampleState != nullptr) {
+				src_reset(m_ResampleState);
+			}
+
+			m_IsBypassing = false;
+			m_SilentFrames = 0.0;
+		}
+
+		//The buffer's contents are meaningless, so make sure silence is what gets resampled
+		if (IsSilent) {
+			ZeroMemory(Buffer, sizeof(FLOAT) * 2 * BufferLength);
+		}
 	}
 
-	//Lock the buffer resource
-	hr = m_RenderClient->GetBuffer (
-		Data.output_frames_gen,
-		&ByteBuffer
+	m_WasSilent = IsSilent;
+
+	//The engine converts from the application's rate itself, or the endpoint already runs at it, so the data can
+	//be queued as-is
+	if ((m_IsEngineConversion || m_IsRateMatched) && !m_IsBypassing) {
+		m_Carry.Write (
+			Buffer,
+			BufferLength
+		);
+
+		Data.input_frames = 0;
+	}
+
+	StageStart = StreamPerformance::GetTicks();
+	StreamTracer::Begin(TRACE_SPAN_RESAMPLE);
+
+	while (Data.input_frames > 0) {
+		Data.data_out = m_LocalBuffer; //Store the resampled frames in the local buffer
+		Data.output_frames = m_BufferFrames; //The most a single pass can produce
+		Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
+		Data.output_frames_gen = 0; //Zero out this value (it's an out value generated by src_process)
+
+		//Resample the data to the sample rate used by the endpoint
+		error = src_process (
+			m_ResampleState,
+			&Data
+		); if (error != 0) {
+			StreamTracer::End(TRACE_SPAN_RESAMPLE);
+
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				E_FAIL
+			); m_Stream.Halt(); return;
+		}
+
+		//Queue the result.  This can only fall short if the application keeps producing more than the
+		//endpoint consumes, in which case the newest frames are dropped.
+		m_Carry.Write (
+			m_LocalBuffer,
+			Data.output_frames_gen
+		);
+
+		Data.data_in += Data.input_frames_used * 2;
+		Data.input_frames -= Data.input_frames_used;
+
+		//Guard against a pass that makes no progress at all
+		if (Data.input_frames_used == 0 && Data.output_frames_gen == 0) break;
+	}
+
+	StreamTracer::End(TRACE_SPAN_RESAMPLE);
+
+	if (m_ResampleState != nullptr && !m_IsBypassing) {
+		m_Stream.GetStreamPerformance().OnResample(StreamPerformance::GetTicks() - StageStart);
+	}
+
+	//An exclusive event-driven endpoint has a single-period buffer, all of which has been played by the time the
+	//event is set.  Its padding says nothing about how well we're keeping up, and there's no margin to keep.
+	if (!m_IsExclusiveEvent) {
+		//Find out how much of the endpoint buffer is still waiting to be played
+		hr = m_Client->GetCurrentPadding (
+			&Padding
+		); HALT_HR(__LINE__);
+
+		//An empty buffer means the endpoint ran dry.  Otherwise, if well over a period has been played since
+		//the last write, we woke up late and only the margin saved us.
+		if (Padding == 0) {
+			m_Stream.ReportGlitch(DXAUDIO_GLITCH_TYPE_RENDER_UNDERRUN);
+		} else if (m_LastPadding > Padding + m_PeriodFrames + m_PeriodFrames / 2) {
+			m_Stream.ReportGlitch(DXAUDIO_GLITCH_TYPE_MISSED_DEADLINE);
+		}
+
+		AdaptMargin(Padding);
+
+		//If the margin just shrank, the latency only actually goes down once that much less is queued.  The
+		//application's audio is never dropped for it - only silence we still owe the endpoint, which nobody can hear.
+		//Until the application goes quiet, the lower margin just means fewer silence top-ups below.
+		if (m_TrimFrames != 0 && m_SilentFrames >= 1.0) {
+			const UINT32 Trimmed = m_TrimFrames < (UINT32)(m_SilentFrames) ? m_TrimFrames : (UINT32)(m_SilentFrames);
+
+			m_SilentFrames -= Trimmed;
+			m_TrimFrames -= Trimmed;
+		}
+	}
+
+	//Fill exactly the free space, or as much of it as we have data for.  An exclusive event-driven endpoint only
+	//takes its whole buffer, so whatever there's no data for is padded out with silence instead.
+	FramesToWrite = ChooseRenderFrames (
+		m_IsExclusiveEvent,
+		m_BufferFrames,
+		Padding,
+		m_Carry.GetReadAvailable(),
+		&DataFrames
 	);
 
-	//If GetBuffer() returns AUDCLNT_E_BUFFER_TOO_LARGE, this is because
-	//the endpoint is in the middle of switching properties, but hasn't
-	//notified us of the change just yet.  Until then, the stream remains
-	//in a stopped state, but may still call our event (or, if a duplex stream,
-	//the input device will be the one calling the event, basically pushing
-	//the stream data into a brick wall).  In this case, just skip this frame.
-	if (hr != AUDCLNT_E_BUFFER_TOO_LARGE) {
+	if (FramesToWrite != 0) {
+		//Lock the buffer resource
+		StreamTracer::Begin(TRACE_SPAN_GET_BUFFER);
+
+		hr = m_RenderClient->GetBuffer (
+			FramesToWrite,
+			&ByteBuffer
+		);
+
+		StreamTracer::End(TRACE_SPAN_GET_BUFFER);
+
+		//If GetBuffer() returns AUDCLNT_E_BUFFER_TOO_LARGE, this is because
+		//the endpoint is in the middle of switching properties, but hasn't
+		//notified us of the change just yet.  Until then, the stream remains
+		//in a stopped state, but may still call our event (or, if a duplex stream,
+		//the input device will be the one calling the event, basically pushing
+		//the stream data into a brick wall).  In this case, just skip this period -
+		//the data stays in the carry-over FIFO.
+		if (hr != AUDCLNT_E_BUFFER_TOO_LARGE) {
+			HALT_HR(__LINE__);
+		} else return;
+
+		//Pull the frames we're about to render out of the carry-over FIFO
+		m_Carry.Read (
+			m_LocalBuffer,
+			DataFrames
+		);
+
+		//Any padding stands in for silence we owe the endpoint, if there is some
+		if (DataFrames < FramesToWrite && m_IsBypassing) {
+			m_SilentFrames = m_SilentFrames > FramesToWrite - DataFrames ? m_SilentFrames - (FramesToWrite - DataFrames) : 0.0;
+		}
+
+		//Nothing but padding can be rendered straight from the flag, without converting anything
+		if (DataFrames != 0) {
+			ZeroMemory(m_LocalBuffer + DataFrames * 2, sizeof(FLOAT) * 2 * (FramesToWrite - DataFrames));
+
+			StageStart = StreamPerformance::GetTicks();
+			StreamTracer::Begin(TRACE_SPAN_CONVERT);
+
+			//Convert the local buffer into the endpoint format and store it in the buffer resource
+			ConvertToEndpoint (
+				ByteBuffer,
+				FramesToWrite
+			);
+
+			StreamTracer::End(TRACE_SPAN_CONVERT);
+			m_Stream.GetStreamPerformance().OnConversion(StreamPerformance::GetTicks() - StageStart);
+		}
+
+		//We're done using the data
+		StreamTracer::Begin(TRACE_SPAN_RELEASE_BUFFER);
+
+		hr = m_RenderClient->ReleaseBuffer (
+			FramesToWrite,
+			DataFrames != 0 ? NULL : AUDCLNT_BUFFERFLAGS_SILENT
+		);
+
+		StreamTracer::End(TRACE_SPAN_RELEASE_BUFFER);
 		HALT_HR(__LINE__);
-	} else return;
 
-	//Convert the local buffer into the endpoint format and store it
-	//in the buffer resource
+		Padding += FramesToWrite;
+		m_FramesWritten += FramesToWrite;
+		m_Stream.GetStreamPerformance().OnFramesOut(FramesToWrite);
+	}
+
+	//In exclusive event-driven mode, the padding above took care of any silence we owe, and there's nothing to top up
+	if (m_IsExclusiveEvent) {
+		UpdatePresentationTiming();
+		return;
+	}
+
+	//While bypassing, the silence we owe follows whatever was left in the carry-over FIFO.  It's rendered
+	//straight from the flag, without locking any samples for conversion.
+	if (m_IsBypassing && m_Carry.GetReadAvailable() == 0) {
+		FramesToWrite = m_BufferFrames - Padding;
+
+		if (FramesToWrite > (UINT32)(m_SilentFrames)) {
+			FramesToWrite = (UINT32)(m_SilentFrames);
+		}
+
+		if (FramesToWrite != 0) {
+			hr = m_RenderClient->GetBuffer (
+				FramesToWrite,
+				&ByteBuffer
+			);
+
+			if (hr != AUDCLNT_E_BUFFER_TOO_LARGE) {
+				HALT_HR(__LINE__);
+			} else return;
+
+			hr = m_RenderClient->ReleaseBuffer (
+				FramesToWrite,
+				AUDCLNT_BUFFERFLAGS_SILENT
+			); HALT_HR(__LINE__);
+
+			m_SilentFrames -= FramesToWrite;
+			Padding += FramesToWrite;
+			m_FramesWritten += FramesToWrite;
+			m_Stream.GetStreamPerformance().OnFramesOut(FramesToWrite);
+		}
+	}
+
+	//If the endpoint holds noticeably less than the margin, it may run dry before we're woken up again.
+	//Top it up with silence instead - this costs a little latency, but an explicit gap is far less audible
+	//than an underrun in the middle of the engine's mix.  Half a period of slack keeps the ordinary
+	//frame-to-frame jitter of the resampler from triggering this.
+	if (Padding + m_PeriodFrames / 2 < m_MarginFrames) {
+		FramesToWrite = m_MarginFrames - Padding;
+
+		hr = m_RenderClient->GetBuffer (
+			FramesToWrite,
+			&ByteBuffer
+		);
+
+		if (hr != AUDCLNT_E_BUFFER_TOO_LARGE) {
+			HALT_HR(__LINE__);
+		} else return;
+
+		hr = m_RenderClient->ReleaseBuffer (
+			FramesToWrite,
+			AUDCLNT_BUFFERFLAGS_SILENT
+		); HALT_HR(__LINE__);
+
+		Padding += FramesToWrite;
+		m_FramesWritten += FramesToWrite;
+		m_Stream.GetStreamPerformance().OnFramesOut(FramesToWrite);
+	}
+
+	m_LastPadding = Padding;
+
+	UpdatePresentationTiming();
+}
+
+VOID ClientWriter::ConvertToEndpoint(BYTE* ByteBuffer, UINT32 Frames) {
+	const UINT32 ExcessChannels = m_WaveFormat->Format.nChannels - 2;
+	FLOAT* LocalBufferIndex = m_LocalBuffer;
+
 	if (m_WaveFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) { //PCM data
 		if (m_WaveFormat->Samples.wValidBitsPerSample == 16) { //16-bit signed int
-			for (long i = 0; i < Data.output_frames_gen; i++) {
+			for (UINT32 i = 0; i < Frames; i++) {
 				for (UINT j = 0; j < 2; j++) { //Two channels
 					*(INT16*)(ByteBuffer) = (INT16)(*LocalBufferIndex * 32767); //Convert from normalized float [-1.0, 1.0]
 					ByteBuffer += sizeof(INT16); //Move the byte pointer to the next channel or sample
@@ -232,10 +722,16 @@ VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 				ZeroMemory(ByteBuffer, ExcessChannels * sizeof(INT16));
 				ByteBuffer += sizeof(INT16) * ExcessChannels;
 			}
-		} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //24-bit unsigned (never signed)
-			for (long i = 0; i < Data.output_frames_gen; i++) {
+		} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //Packed 24-bit signed int
+			for (UINT32 i = 0; i < Frames; i++) {
 				for (UINT j = 0; j < 2; j++) {
-					*(UINT32*)(ByteBuffer) = (UINT32)((*LocalBufferIndex + 1.0f) * 8388607);
+					//Clamp to the 24-bit range and store the three low bytes - a whole INT32 would run past the last sample
+					const FLOAT Scaled = *LocalBufferIndex * 8388608;
+					const INT32 Sample = Scaled >= 8388607.0f ? 8388607 : Scaled <= -8388608.0f ? -8388608 : (INT32)(Scaled);
+
+					ByteBuffer[0] = (BYTE)(Sample);
+					ByteBuffer[1] = (BYTE)(Sample >> 8);
+					ByteBuffer[2] = (BYTE)(Sample >> 16);
 					ByteBuffer += 3;
 					LocalBufferIndex++;
 				}
@@ -244,7 +740,7 @@ VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 				ByteBuffer += 3 * ExcessChannels;
 			}
 		} else { //32-bit signed
-			for (long i = 0; i < Data.output_frames_gen; i++) {
+			for (UINT32 i = 0; i < Frames; i++) {
 				for (UINT j = 0; j < 2; j++) {
 					*(INT32*)(ByteBuffer) = (INT32)(*LocalBufferIndex * 2147483647);
 					ByteBuffer += sizeof(INT32);
@@ -256,7 +752,7 @@ VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 			}
 		}
 	} else { //32-bit floating-point
-		for (long i = 0; i < Data.output_frames_gen; i++) {
+		for (UINT32 i = 0; i < Frames; i++) {
 			for (UINT j = 0; j < 2; j++) {
 				*(FLOAT*)(ByteBuffer) = *LocalBufferIndex;
 				ByteBuffer += sizeof(FLOAT);
@@ -267,12 +763,104 @@ VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 			ByteBuffer += sizeof(FLOAT) * ExcessChannels;
 		}
 	}
+}
 
-	//We're done using the data
-	hr = m_RenderClient->ReleaseBuffer (
-		Data.output_frames_gen,
-		NULL
+VOID ClientWriter::ChooseMargin(UINT PrefillFrames) {
+	//Choose the margin - the number of frames we try to keep queued in the endpoint buffer right after
+	//each write.  The endpoint needs at least one period of it to start at all.  Since we're woken up
+	//once a period has been played, an adaptive stream keeps a sliver more than that, so that a wakeup
+	//that's merely on time is never mistaken for an underrun.
+	m_MinMarginFrames = m_PeriodFrames;
+
+	if (m_LatencyMode == DXAUDIO_LATENCY_MODE_ADAPTIVE) {
+		m_MinMarginFrames += m_PeriodFrames / ADAPT_SHRINK_DIVISOR;
+	}
+
+	if (PrefillFrames != 0) {
+		m_MarginFrames = (UINT32)(ceil(PrefillFrames * m_ResampleRatio));
+	} else if (m_LatencyMode == DXAUDIO_LATENCY_MODE_DEFAULT) {
+		//Two periods, just in case the stream runs a little bit behind, to prevent pops and clicks
+		//which happen even under a light CPU load.
+		m_MarginFrames = m_PeriodFrames * 2;
+	} else {
+		m_MarginFrames = m_PeriodFrames;
+	}
+
+	if (m_MarginFrames < m_MinMarginFrames) {
+		m_MarginFrames = m_MinMarginFrames;
+	}
+}
+
+UINT32 ClientWriter::ChooseBufferPeriods() {
+	//The buffer needs the margin plus room for a couple of periods to be written into.  Adaptive streams
+	//get extra room so that the margin can grow.
+	UINT32 BufferPeriods = (m_MarginFrames + m_PeriodFrames - 1) / m_PeriodFrames + 2;
+
+	if (BufferPeriods < 4) {
+		BufferPeriods = 4;
+	}
+
+	if (m_LatencyMode == DXAUDIO_LATENCY_MODE_ADAPTIVE && BufferPeriods < 8) {
+		BufferPeriods = 8;
+	}
+
+	return BufferPeriods;
+}
+
+VOID ClientWriter::AdaptMargin(UINT32 Padding) {
+	UINT32 Step = 0;
+
+	if (m_LatencyMode != DXAUDIO_LATENCY_MODE_ADAPTIVE) {
+		return;
+	}
+
+	if (Padding == 0) {
+		//The endpoint ran dry before we got to it - grow the margin (the top-up fills the difference)
+		Step = m_PeriodFrames / ADAPT_GROW_DIVISOR;
+		m_MarginFrames = m_MarginFrames + Step < m_MaxMarginFrames ? m_MarginFrames + Step : m_MaxMarginFrames;
+		m_TrimFrames = 0;
+		m_FastPeriods = 0;
+	} else if (m_Stream.GetLastProcessTime() < m_Period / 4) {
+		//The callback is well under budget - after long enough, give some of the margin back
+		if (++m_FastPeriods >= ADAPT_SHRINK_PERIODS) {
+			Step = m_PeriodFrames / ADAPT_SHRINK_DIVISOR;
+
+			if (m_MarginFrames - Step < m_MinMarginFrames) {
+				Step = m_MarginFrames - m_MinMarginFrames;
+			}
+
+			m_MarginFrames -= Step;
+			m_TrimFrames += Step;
+			m_FastPeriods = 0;
+		}
+	} else {
+		m_FastPeriods = 0;
+	}
+}
+
+VOID ClientWriter::UpdatePresentationTiming() {
+	HRESULT hr = S_OK;
+	const UINT SampleRate = m_WaveFormat->Format.nSamplesPerSec;
+	UINT64 Position = 0;
+	UINT64 QPCPosition = 0;
+
+	//Find out which frame is being played right now, and when that was measured
+	hr = m_Clock->GetPosition (
+		&Position,
+		&QPCPosition
 	); HALT_HR(__LINE__);
+
+	//The next frame we're given lands behind everything in the endpoint buffer and the carry-over FIFO.  This
+	//doesn't account for the resampler's own short delay, or for silence we may have to insert later.
+	const UINT64 PlayedFrames = (UINT64)(DOUBLE(Position) * SampleRate / DOUBLE(m_ClockFrequency));
+	const UINT64 NextFrame = m_FramesWritten + m_Carry.GetReadAvailable() + (UINT64)(m_SilentFrames);
+	const UINT64 AheadFrames = NextFrame > PlayedFrames ? NextFrame - PlayedFrames : 0;
+
+	m_Stream.SetPresentationTiming (
+		NextFrame,
+		QPCPosition + AheadFrames * 10000000 / SampleRate,
+		SampleRate
+	);
 }
 
 HRESULT ClientWriter::VerifyClient() {
@@ -281,6 +869,11 @@ HRESULT ClientWriter::VerifyClient() {
 	//This will return AUDCLNT_E_DEVICE_INVALIDATED if the IAudioClient object
 	//becomes outdated.  This occurs if a property has been changed, such as
 	//the sample rate or bit depth of the endpoint.  Otherwise, it will return S_OK,
-	//verifying that the client is still valid.
+	//verifying that the client is still valid.  A client that was never opened, because its
+	//device wasn't present at the time, counts as outdated.
+	if (m_Client == nullptr) {
+		return AUDCLNT_E_DEVICE_INVALIDATED;
+	}
+
 	return m_Client->GetBufferSize(&BufferFrames);
 }
\ No newline at end of file
@@ -29,6 +29,7 @@
 #include "DXAudio.h"
 #include "samplerate.h"
 #include "CDXAudioStream.h"
+#include "RingBuffer.h"
 
 /* ClientWriter is used to write stream data to an endpoint.  This can only be
 ** used with output endpoints. */
@@ -40,9 +41,26 @@ public:
 
 	/* This initializes the writer by creating the necessary interfaces and data. [SampleRate] is the desired
 	** sample rate to be used by the stream callback.  The endpoint data will automatically be resampled
-	** from this format.  [WaitEvent] is the event handle for the event callback mechanism - if NULL,
-	** there will be no event callback on this end. */
-	HRESULT Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback);
+	** from this format - if it's zero, the endpoint's own rate is used (see GetSampleRate()).
+	** [WaitEvent] is the event handle for the event callback mechanism - if NULL, there will be no
+	** event callback on this end.  [Flags] are the stream's DXAUDIO_STREAM_FLAG values.
+	** [LatencyMode] and [PrefillFrames] determine the margin of silence kept queued ahead of the endpoint
+	** (see DXAUDIO_STREAM_DESC). */
+	HRESULT Initialize(FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, DXAUDIO_LATENCY_MODE LatencyMode, UINT PrefillFrames, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback);
+
+	/* This does everything Initialize() does except tell the stream how the endpoint was set up and report failures,
+	** so that it can be called on a thread other than the stream thread to prepare a standby writer.
+	** PublishEndpointInfo() has to be called on the stream thread once the writer is put to use, and failures other
+	** than AUDCLNT_E_DEVICE_INVALIDATED reported there from GetFailure(). */
+	HRESULT Prepare(FLOAT SampleRate, HANDLE WaitEvent, DWORD Flags, DXAUDIO_LATENCY_MODE LatencyMode, UINT PrefillFrames, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback);
+
+	/* Tells where and why the last call to Prepare() failed, with the HRESULT it failed on rather than E_FAIL */
+	VOID GetFailure(LPCWSTR* pFile, UINT* pLine, HRESULT* pResult);
+
+	/* Passes the endpoint info gathered by Prepare() on to the stream. */
+	VOID PublishEndpointInfo() {
+		m_Stream.SetEndpointInfo(false, m_EndpointInfo, m_DeviceID);
+	}
 
 	/* This releases all interfaces and dynamically allocated data and sets the object to a pre-initialized state. */
 	VOID Clean();
@@ -54,8 +72,11 @@ public:
 	VOID Stop();
 
 	/* This should be called to write the output data to the stream.  [BufferLength] is the size of the buffer,
-	** which is the number of frames to be provided. */
-	VOID Write(FLOAT* Buffer, UINT BufferLength);
+	** which is the number of frames to be provided.  The data is resampled into a carry-over FIFO, and only as
+	** many frames as the endpoint buffer has room for are rendered - the rest wait for the next call.  If the
+	** endpoint is about to run dry, it is topped up with silence.  If [IsSilent] is true, the contents of [Buffer]
+	** are ignored, and once the resampler has settled the frames are rendered as silence without being converted. */
+	VOID Write(FLOAT* Buffer, UINT BufferLength, bool IsSilent);
 
 	/* This determines if the client is still in a valid, usable state. */
 	HRESULT VerifyClient();
@@ -70,6 +91,17 @@ public:
 		return m_PeriodFrames;
 	}
 
+	/* Returns the margin currently kept queued in the endpoint buffer, in frames at the endpoint sample rate. */
+	UINT32 GetMarginFrames() {
+		return m_MarginFrames;
+	}
+
+	/* Returns the sample rate the application runs at - the one given to Initialize(), or the endpoint's own if
+	** that was zero. */
+	FLOAT GetSampleRate() {
+		return m_SampleRate;
+	}
+
 	/* Returns the resample ratio, which is equal to (endpoint sample rate) / (application sample rate) */
 	DOUBLE GetRatio() {
 		return m_ResampleRatio;
@@ -79,10 +111,56 @@ private:
 	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting
 	CComPtr<IAudioClient> m_Client; //Audio client interface (WASAPI)
 	CComPtr<IAudioRenderClient> m_RenderClient; //Render client interface (WASAPI)
+	CComPtr<IAudioClock> m_Clock; //Clock interface (WASAPI), used to estimate presentation times
+	UINT64 m_ClockFrequency; //Units per second of the positions reported by m_Clock
+	UINT64 m_FramesWritten; //Frames rendered to the endpoint since the client was initialized, silence included
+	UINT32 m_LastPadding; //Frames left in the endpoint buffer at the end of the previous write
+	bool m_WasSilent; //True if the previous write was silent, so the resampler holds nothing but zeros
+	bool m_IsBypassing; //True while silent writes skip the resampler (it must be reset before it's used again)
+	DOUBLE m_SilentFrames; //Silent frames owed to the endpoint while bypassing, at the endpoint rate
 	WAVEFORMATEXTENSIBLE* m_WaveFormat; //The wave format of the endpoint
 	DOUBLE m_ResampleRatio; //The resample ratio for the stream
 	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object)
 	UINT32 m_PeriodFrames; //Number of frames in a period
+	UINT32 m_BufferFrames; //Size of the endpoint buffer in frames
+	RingBuffer m_Carry; //Resampled frames waiting for room in the endpoint buffer
+	FLOAT* m_LocalBuffer; //Scratch space for resampling and rendering, m_BufferFrames long
+	DXAUDIO_LATENCY_MODE m_LatencyMode; //How the margin is chosen
+	UINT32 m_MarginFrames; //Frames the endpoint buffer should hold right after each write
+	UINT32 m_MinMarginFrames; //Lower bound for m_MarginFrames
+	UINT32 m_MaxMarginFrames; //Upper bound for m_MarginFrames
+	UINT32 m_TrimFrames; //Frames of owed silence still to be dropped after the margin shrank
+	UINT m_FastPeriods; //Consecutive periods the callback has stayed well under budget (adaptive mode)
+	bool m_IsEngineConversion; //True if the audio engine converts from the application's rate, so libsamplerate is bypassed
+	bool m_IsRateMatched; //True if the client runs at the application's rate, so libsamplerate isn't needed either
+	bool m_IsExclusiveEvent; //True if the client is exclusive and event-driven, so every write must fill its whole buffer
+	FLOAT m_SampleRate; //The application's sample rate - the endpoint's own in native-rate mode
+	DXAUDIO_ENDPOINT_INFO m_EndpointInfo; //How the endpoint was set up, as passed on by PublishEndpointInfo()
+	LPWSTR m_DeviceID; //The endpoint device's unique identifier, also passed on by PublishEndpointInfo()
+	UINT m_FailureLine; //Where the last call to Prepare() failed, as returned by GetFailure()
+	HRESULT m_FailureResult; //Why it failed
+
+	/* Keeps a note of a failure in Prepare() for GetFailure() */
+	VOID NoteFailure(UINT Line, HRESULT hr) {
+		m_FailureLine = Line;
+		m_FailureResult = hr;
+	}
+
+	/* Converts [Frames] stereo frames from the local buffer into the endpoint format, and stores them in [ByteBuffer] */
+	VOID ConvertToEndpoint(BYTE* ByteBuffer, UINT32 Frames);
+
+	/* Sets the initial margin and its lower bound from the period and the stream description */
+	VOID ChooseMargin(UINT PrefillFrames);
+
+	/* Returns the size of the shared-mode buffer to ask for, in periods, from the margin */
+	UINT32 ChooseBufferPeriods();
+
+	/* Adjusts the margin after a write.  [Padding] is what was left in the endpoint buffer when we woke up. */
+	VOID AdaptMargin(UINT32 Padding);
+
+	/* Estimates when the next frame given to Write() will be played and passes it on to the stream */
+	VOID UpdatePresentationTiming();
+
 	REFERENCE_TIME m_Period; //Periodicity of the endpoint
 	CDXAudioStream& m_Stream; //Stream reference
 };
\ No newline at end of file
@@ -26,6 +26,9 @@
 #include "CDXAudioLoopbackStream.h"
 #include "CDXAudioDuplexStream.h"
 #include "CDXAudioEchoStream.h"
+#include "ClientNegotiation.h"
+#include "NotificationHub.h"
+#include "EndpointCache.h"
 
 #include <atlbase.h>
 
@@ -33,7 +36,7 @@
 
 /* Creates an output stream. */
 static HRESULT DXAudioCreateOutputStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -41,7 +44,7 @@ static HRESULT DXAudioCreateOutputStream (
 
 	CComPtr<CDXAudioOutputStream> OutputStream = new CDXAudioOutputStream();
 
-	hr = OutputStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = OutputStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -55,7 +58,7 @@ static HRESULT DXAudioCreateOutputStream (
 
 /* Creates an input stream. */
 static HRESULT DXAudioCreateInputStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -63,7 +66,7 @@ static HRESULT DXAudioCreateInputStream (
 
 	CComPtr<CDXAudioInputStream> InputStream = new CDXAudioInputStream();
 
-	hr = InputStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = InputStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -77,7 +80,7 @@ static HRESULT DXAudioCreateInputStream (
 
 /* Creates a loopback stream. */
 static HRESULT DXAudioCreateLoopbackStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -85,7 +88,7 @@ static HRESULT DXAudioCreateLoopbackStream (
 
 	CComPtr<CDXAudioLoopbackStream> LoopbackStream = new CDXAudioLoopbackStream();
 
-	hr = LoopbackStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = LoopbackStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -99,7 +102,7 @@ static HRESULT DXAudioCreateLoopbackStream (
 
 /* Creates a duplex stream. */
 static HRESULT DXAudioCreateDuplexStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -107,7 +110,7 @@ static HRESULT DXAudioCreateDuplexStream (
 
 	CComPtr<CDXAudioDuplexStream> DuplexStream = new CDXAudioDuplexStream();
 
-	hr = DuplexStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = DuplexStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -121,7 +124,7 @@ static HRESULT DXAudioCreateDuplexStream (
 
 /* Creates an echo stream. */
 static HRESULT DXAudioCreateEchoStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -129,7 +132,7 @@ static HRESULT DXAudioCreateEchoStream (
 
 	CComPtr<CDXAudioEchoStream> EchoStream = new CDXAudioEchoStream();
 
-	hr = EchoStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = EchoStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -141,6 +144,30 @@ static HRESULT DXAudioCreateEchoStream (
 	return S_OK;
 }
 
+/* Creates an offline stream - an output stream, or a duplex stream if the callback can process both ways. */
+static HRESULT DXAudioCreateOfflineStream (
+	const DXAUDIO_STREAM_DESC* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream
+) {
+	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
+	CComPtr<IDXAudioReadWriteCallback> ReadWriteCallback;
+
+	if (SUCCEEDED(Callback.QueryInterface(&ReadWriteCallback))) {
+		return DXAudioCreateDuplexStream (
+			pDesc,
+			pDXAudioCallback,
+			ppDXAudioStream
+		);
+	}
+
+	return DXAudioCreateOutputStream (
+		pDesc,
+		pDXAudioCallback,
+		ppDXAudioStream
+	);
+}
+
 /* Entry point into the dll - creates a stream as specified by the application. */
 HRESULT DXAudioCreateStream (
 	const DXAUDIO_STREAM_DESC* pDesc,
@@ -152,10 +179,15 @@ HRESULT DXAudioCreateStream (
 		return E_POINTER;
 	}
 
+	//A description from an older header is laid out differently, and can't be read as this one
+	if (pDesc->Size != sizeof(DXAUDIO_STREAM_DESC)) {
+		return E_INVALIDARG;
+	}
+
 	switch (pDesc->Type) {
 		case DXAUDIO_STREAM_TYPE_OUTPUT: {
 			return DXAudioCreateOutputStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -163,7 +195,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_INPUT: {
 			return DXAudioCreateInputStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -171,7 +203,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_LOOPBACK: {
 			return DXAudioCreateLoopbackStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -179,7 +211,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_DUPLEX: {
 			return DXAudioCreateDuplexStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -187,7 +219,15 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_ECHO: {
 			return DXAudioCreateEchoStream (
-				pDesc->SampleRate,
+				pDesc,
+				pDXAudioCallback,
+				ppDXAudioStream
+			);
+		} break;
+
+		case DXAUDIO_STREAM_TYPE_OFFLINE: {
+			return DXAudioCreateOfflineStream (
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -195,4 +235,222 @@ HRESULT DXAudioCreateStream (
 	}
 
 	return E_INVALIDARG;
+}
+
+/* Describes the mix format of a default endpoint, for choosing a stream's rate before creating it. */
+HRESULT DXAudioGetEndpointFormat (
+	BOOL IsCapture,
+	DXAUDIO_ENDPOINT_FORMAT* pFormat
+) {
+	HRESULT hr = S_OK;
+	CComPtr<IMMDeviceEnumerator> Enumerator;
+	CComPtr<IMMDevice> Device;
+	CComPtr<IAudioClient> Client;
+	WAVEFORMATEX* pMixFormat = nullptr;
+
+	if (pFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	//The caller's thread may not have COM initialized - if it does, in whatever mode, that's fine too
+	const HRESULT InitResult = CoInitializeEx (
+		NULL,
+		COINIT_MULTITHREADED
+	);
+
+	hr = CoCreateInstance (
+		__uuidof(MMDeviceEnumerator),
+		NULL,
+		CLSCTX_ALL,
+		__uuidof(IMMDeviceEnumerator),
+		(void**)(&Enumerator)
+	);
+
+	if (SUCCEEDED(hr)) {
+		hr = Enumerator->GetDefaultAudioEndpoint (
+			IsCapture ? eCapture : eRender,
+			eConsole,
+			&Device
+		);
+	}
+
+	if (SUCCEEDED(hr)) {
+		hr = Device->Activate (
+			__uuidof(IAudioClient),
+			CLSCTX_ALL,
+			nullptr,
+			(void**)(&Client)
+		);
+	}
+
+	if (SUCCEEDED(hr)) {
+		hr = Client->GetMixFormat (
+			&pMixFormat
+		);
+	}
+
+	if (SUCCEEDED(hr)) {
+		DescribeFormat(pMixFormat, pFormat);
+		CoTaskMemFree(pMixFormat);
+	}
+
+	//Everything has to be released before COM is uninitialized
+	Client.Release();
+	Device.Release();
+	Enumerator.Release();
+
+	if (SUCCEEDED(InitResult)) {
+		CoUninitialize();
+	}
+
+	return hr;
+}
+
+/* Creates a stream and hands back the event that's set once it has opened its devices. */
+HRESULT DXAudioCreateStreamAsync (
+	const DXAUDIO_STREAM_DESC* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream,
+	HANDLE* phReady
+) {
+	HRESULT hr = S_OK;
+
+	if (phReady == nullptr) {
+		return E_POINTER;
+	}
+
+	*phReady = NULL;
+
+	hr = DXAudioCreateStream (
+		pDesc,
+		pDXAudioCallback,
+		ppDXAudioStream
+	);
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	*phReady = (*ppDXAudioStream)->GetReadyEvent();
+
+	return S_OK;
+}
+
+/* Creates several streams, and waits for all of them to open their devices - they do so in parallel, each on its own thread. */
+HRESULT DXAudioCreateStreams (
+	UINT Count,
+	const DXAUDIO_STREAM_DESC* pDescs,
+	IDXAudioCallback* const* ppDXAudioCallbacks,
+	IDXAudioStream** ppDXAudioStreams,
+	HRESULT* pResults
+) {
+	HRESULT Result = S_OK;
+
+	if (pDescs == nullptr || ppDXAudioCallbacks == nullptr ||
+		ppDXAudioStreams == nullptr) {
+		return E_POINTER;
+	}
+
+	//Start every stream before waiting for any of them
+	for (UINT i = 0; i < Count; i++) {
+		HRESULT hr = DXAudioCreateStream (
+			&pDescs[i],
+			ppDXAudioCallbacks[i],
+			&ppDXAudioStreams[i]
+		);
+
+		if (FAILED(hr)) {
+			ppDXAudioStreams[i] = nullptr;
+
+			if (SUCCEEDED(Result)) {
+				Result = hr;
+			}
+		}
+
+		if (pResults != nullptr) {
+			pResults[i] = hr;
+		}
+	}
+
+	//Then collect them - the total wait is only as long as the slowest one
+	for (UINT i = 0; i < Count; i++) {
+		if (ppDXAudioStreams[i] == nullptr) {
+			continue;
+		}
+
+		HRESULT hr = ppDXAudioStreams[i]->WaitForReady(INFINITE);
+
+		if (FAILED(hr)) {
+			ppDXAudioStreams[i]->Release();
+			ppDXAudioStreams[i] = nullptr;
+
+			if (SUCCEEDED(Result)) {
+				Result = hr;
+			}
+		}
+
+		if (pResults != nullptr) {
+			pResults[i] = hr;
+		}
+	}
+
+	return Result;
+}
+
+/* Lists the active endpoints of one flow, from the cached snapshot if there's one. */
+HRESULT DXAudioEnumerateEndpoints (
+	BOOL IsCapture,
+	DXAUDIO_ENDPOINT_DESC* pEndpoints,
+	UINT MaxEndpoints,
+	UINT* pCount
+) {
+	HRESULT hr = S_OK;
+	CComPtr<IMMDeviceEnumerator> Enumerator;
+
+	if (pCount == nullptr || (pEndpoints == nullptr && MaxEndpoints != 0)) {
+		return E_POINTER;
+	}
+
+	*pCount = 0;
+
+	//The caller's thread may not have COM initialized - if it does, in whatever mode, that's fine too
+	const HRESULT InitResult = CoInitializeEx (
+		NULL,
+		COINIT_MULTITHREADED
+	);
+
+	//While streams on the system's devices exist, their enumerator is registered for notifications, which is what
+	//lets the snapshot be kept - without them, a new enumerator gathers it afresh
+	hr = NotificationHub::GetEnumerator (
+		&Enumerator
+	);
+
+	if (FAILED(hr)) {
+		hr = CoCreateInstance (
+			__uuidof(MMDeviceEnumerator),
+			NULL,
+			CLSCTX_ALL,
+			__uuidof(IMMDeviceEnumerator),
+			(void**)(&Enumerator)
+		);
+	}
+
+	if (SUCCEEDED(hr)) {
+		hr = EndpointCache::Enumerate (
+			Enumerator,
+			IsCapture ? eCapture : eRender,
+			pEndpoints,
+			MaxEndpoints,
+			pCount
+		);
+	}
+
+	//Everything has to be released before COM is uninitialized
+	Enumerator.Release();
+
+	if (SUCCEEDED(InitResult)) {
+		CoUninitialize();
+	}
+
+	return hr;
 }
\ No newline at end of file
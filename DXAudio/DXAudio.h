@@ -30,17 +30,199 @@ enum DXAUDIO_STREAM_TYPE {
 	DXAUDIO_STREAM_TYPE_INPUT,      //An input stream from the default audio input endpoint
 	DXAUDIO_STREAM_TYPE_LOOPBACK,   //An input stream from the default audio output endpoint (reads what's currently playing)
 	DXAUDIO_STREAM_TYPE_DUPLEX,		//A duplex stream between the default audio input and output endpoints
-	DXAUDIO_STREAM_TYPE_ECHO		//A duplex stream between the default audio output endpoint and itself (IE, a loopback stream with output functionality)
+	DXAUDIO_STREAM_TYPE_ECHO,		//A duplex stream between the default audio output endpoint and itself (IE, a loopback stream with output functionality)
+	DXAUDIO_STREAM_TYPE_OFFLINE		//An output or duplex stream on simulated endpoints that runs as fast as it can be processed (see IDXAudioOfflineCallback)
+};
+
+/* DXAUDIO_LATENCY_MODE determines how much silence is queued ahead of the output endpoint, trading latency for safety */
+enum DXAUDIO_LATENCY_MODE {
+	DXAUDIO_LATENCY_MODE_DEFAULT = 0, //Two device periods of margin - about 10ms of added latency, but robust under light load
+	DXAUDIO_LATENCY_MODE_MINIMUM,     //One device period of margin - the lowest latency shared mode allows, at the risk of glitches
+	DXAUDIO_LATENCY_MODE_ADAPTIVE     //Starts at the minimum, grows after every underrun, and shrinks slowly while the callback is fast
+};
+
+/* DXAUDIO_STREAM_FLAG values can be combined in DXAUDIO_STREAM_DESC::Flags to opt in to optional behavior */
+enum DXAUDIO_STREAM_FLAG {
+	DXAUDIO_STREAM_FLAG_LOW_LATENCY = 0x1, //Run the endpoint(s) at the smallest shared-mode period the engine supports (Windows 10 and later)
+	DXAUDIO_STREAM_FLAG_EXCLUSIVE = 0x2,   //Take exclusive control of the endpoint(s) in the closest native format, bypassing the engine's mixer
+	DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION = 0x4, //Let the audio engine convert to and from the stream's rate and format instead of libsamplerate
+	DXAUDIO_STREAM_FLAG_WARM_STANDBY = 0x8, //Open a new default device on a background thread, then switch to it without a gap (input and output streams)
+	DXAUDIO_STREAM_FLAG_NATIVE_RATE = 0x10 //Run the stream at the endpoint's own mix rate instead of SampleRate, so that nothing is resampled (see "Native rate")
+};
+
+/* DXAUDIO_SIMULATED_FAULT values can be combined in DXAUDIO_SIMULATED_DEVICE_DESC::FaultTypes to choose the faults
+** injected into the simulated devices */
+enum DXAUDIO_SIMULATED_FAULT {
+	DXAUDIO_SIMULATED_FAULT_INVALIDATE = 0x1,     //Every client is invalidated and a property change is notified, as when the audio engine restarts
+	DXAUDIO_SIMULATED_FAULT_DEFAULT_CHANGE = 0x2, //Each device is replaced by another with a new ID as the default, and the change is notified
+	DXAUDIO_SIMULATED_FAULT_FORMAT_CHANGE = 0x4,  //The mix format switches between 44100 and 48000Hz, invalidating every client, and a property change is notified
+	DXAUDIO_SIMULATED_FAULT_GETBUFFER = 0x8       //The next GetBuffer() call fails with AUDCLNT_E_DEVICE_INVALIDATED, without a notification
+};
+
+/* DXAUDIO_SIMULATED_DEVICE_DESC describes the virtual endpoints a stream runs against when it's created with
+** DXAUDIO_STREAM_DESC::pSimulatedDevice set.  The simulated devices run on their own clock, in real time, and behave
+** like shared-mode WASAPI endpoints without any hardware (or an audio service) behind them.  Zeroed fields take the
+** defaults noted below. */
+struct DXAUDIO_SIMULATED_DEVICE_DESC {
+	UINT SampleRate; //Sample rate of the mix format (48000 if zero)
+	UINT Channels; //Channels in the mix format, at least two (two if zero)
+	UINT BitsPerSample; //16, 24 (in a 32-bit container) or 32 - 32-bit floating-point samples if zero
+	BOOL IsFloat; //TRUE for floating-point samples (only with 32 bits per sample)
+	UINT PeriodFrames; //Frames per device period at the mix format's rate (10ms if zero)
+	UINT JitterMicroseconds; //Most that each period's event may be delayed by, chosen pseudo-randomly
+	FLOAT DriftPPM; //How much faster (or, if negative, slower) the device clock runs than the performance counter, in parts per million
+	UINT Seed; //Seeds the jitter sequence, so that a run can be repeated
+	FLOAT ToneFrequency; //Frequency of the sine wave captured by the simulated input, in Hz - zero captures silence
+	LPCWSTR CaptureFileName; //If not NULL, a file the simulated input captures in a loop instead of the tone - a WAV file's format replaces the input's mix format (copied on creation)
+	LPCWSTR RenderFileName; //If not NULL, a file everything the simulated output is given is written to, in the format it's given (copied on creation)
+	BOOL IsRawFile; //TRUE if both files are headerless samples in the mix format described above, rather than WAV files
+	UINT FaultIntervalMilliseconds; //If nonzero, a fault is injected into both devices this often, taking each of FaultTypes in turn
+	DWORD FaultTypes; //A combination of DXAUDIO_SIMULATED_FAULT values (every fault if zero)
 };
 
 /* DXAUDIO_STREAM_DESC is used for creating an audio stream to determine its properties */
 struct DXAUDIO_STREAM_DESC {
-	FLOAT SampleRate; //Sample rate of the stream
+	UINT Size; //Must be sizeof(DXAUDIO_STREAM_DESC) - lets the structure grow without misreading one from an older header
+	FLOAT SampleRate; //Sample rate of the stream (with DXAUDIO_STREAM_FLAG_NATIVE_RATE, only used until the endpoint's rate is known - 48000 if zero)
 	DXAUDIO_STREAM_TYPE Type; //Type of the stream to be created (see enum above)
+	UINT BufferFrames; //Capacity of the push-mode ring buffer(s) in frames - zero for a callback (pull-mode) stream
+	UINT BlockFrames; //If nonzero, OnProcess() is always called with exactly this many frames (ignored in push mode)
+	UINT CoalescePeriods; //If greater than one, OnProcess() is called once per this many device periods (input, loopback and output streams only)
+	DXAUDIO_LATENCY_MODE LatencyMode; //How the output margin is chosen (output, duplex and echo streams only)
+	UINT PrefillFrames; //If nonzero, overrides the initial output margin, in frames at the stream's sample rate
+	DWORD Flags; //A combination of DXAUDIO_STREAM_FLAG values
+	const DXAUDIO_SIMULATED_DEVICE_DESC* pSimulatedDevice; //If not NULL, the stream uses simulated endpoints instead of the system's devices (copied on creation)
+	LPCWSTR OfflineFileName; //Offline streams only - if not NULL, takes the place of DXAUDIO_SIMULATED_DEVICE_DESC::RenderFileName (copied on creation)
+	LPCWSTR InputDeviceID; //If not NULL, the capture endpoint to use instead of the default one, as reported by DXAudioEnumerateEndpoints() (copied on creation)
+	LPCWSTR OutputDeviceID; //If not NULL, the render endpoint to use instead of the default one - loopback and echo streams capture from it too (copied on creation)
+};
+
+/* DXAUDIO_CONVERSION_PATH identifies who converts an endpoint's audio to and from the stream's rate and format */
+enum DXAUDIO_CONVERSION_PATH {
+	DXAUDIO_CONVERSION_PATH_NONE = 0,      //The stream doesn't use this endpoint (or it hasn't been initialized yet)
+	DXAUDIO_CONVERSION_PATH_LIBSAMPLERATE, //DXAudio converts the samples and resamples them with libsamplerate
+	DXAUDIO_CONVERSION_PATH_ENGINE,        //The audio engine converts the format and rate (DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION)
+	DXAUDIO_CONVERSION_PATH_FORMAT_ONLY    //DXAudio converts the samples, but the client runs at the stream's rate, so nothing is resampled
+};
+
+/* DXAUDIO_ENDPOINT_FORMAT describes an endpoint's mix format - the format the audio engine runs it at in shared mode */
+struct DXAUDIO_ENDPOINT_FORMAT {
+	UINT SampleRate; //Frames per second
+	UINT Channels; //Number of channels
+	DWORD ChannelMask; //Speaker positions of the channels, as SPEAKER_ values (zero if the format doesn't say)
+	UINT BitsPerSample; //Size of each sample's container in bits
+	UINT ValidBits; //Bits of each sample that are used, which may be fewer (as with 24-bit samples in 32 bits)
+	BOOL IsFloat; //TRUE for floating-point samples, FALSE for integer PCM
+};
+
+/* DXAUDIO_ENDPOINT_INFO describes how one side of a stream ended up being set up */
+struct DXAUDIO_ENDPOINT_INFO {
+	DXAUDIO_CONVERSION_PATH ConversionPath; //Who converts the audio
+	BOOL IsExclusive; //TRUE if the endpoint is open in exclusive mode
+	BOOL IsLowLatency; //TRUE if the endpoint runs at a reduced shared-mode engine period
+	UINT SampleRate; //Sample rate the client runs at (the stream's own rate in engine-conversion mode)
+	UINT PeriodFrames; //Frames per device period at that sample rate
+	DXAUDIO_ENDPOINT_FORMAT MixFormat; //The endpoint's mix format, whichever way the client was set up
+};
+
+/* DXAUDIO_STREAM_INFO is filled in by IDXAudioStream::GetStreamInfo() */
+struct DXAUDIO_STREAM_INFO {
+	DXAUDIO_ENDPOINT_INFO Input; //The capture (or loopback) side
+	DXAUDIO_ENDPOINT_INFO Output; //The render side
+};
+
+/* DXAUDIO_STREAM_STATISTICS is filled in by IDXAudioStream::GetStatistics() */
+struct DXAUDIO_STREAM_STATISTICS {
+	UINT64 Wakeups; //Number of times the stream thread woke up to process the endpoint(s)
+	UINT64 CapturePackets; //Number of packets read from the capture endpoint (input, loopback, duplex and echo streams)
+	UINT64 CatchUpWakeups; //Number of wakeups that found more than one capture packet waiting (the thread was late)
+	UINT64 CatchUpPackets; //Number of extra capture packets drained by those late wakeups
+	UINT MaxPacketsPerWakeup; //The most capture packets drained by a single wakeup
+	UINT64 Discontinuities; //Number of capture packets flagged as not following on from the previous one (data was lost)
+	UINT64 TimestampErrors; //Number of capture packets whose timestamp the endpoint couldn't vouch for
+	UINT64 RenderUnderruns; //Number of times the render endpoint had played everything we'd given it by the time we woke up
+	UINT64 MissedDeadlines; //Number of wakeups that came more than half a period late, without (yet) causing an underrun
+};
+
+#define DXAUDIO_MAX_DEVICE_ID 256 //Capacity of DXAUDIO_ENDPOINT_DESC::DeviceID in characters, including the terminator
+#define DXAUDIO_MAX_DEVICE_NAME 128 //Capacity of DXAUDIO_ENDPOINT_DESC::FriendlyName in characters, including the terminator
+
+/* DXAUDIO_ENDPOINT_DESC describes one of the system's active endpoints, as listed by DXAudioEnumerateEndpoints() */
+struct DXAUDIO_ENDPOINT_DESC {
+	WCHAR DeviceID[DXAUDIO_MAX_DEVICE_ID]; //The endpoint's ID, for DXAUDIO_STREAM_DESC::InputDeviceID or OutputDeviceID
+	WCHAR FriendlyName[DXAUDIO_MAX_DEVICE_NAME]; //The name the user knows the endpoint by (truncated if it's longer)
+	BOOL IsCapture; //TRUE for a capture endpoint, FALSE for a render endpoint
+	BOOL IsDefault; //TRUE if it's the default endpoint of its kind
+	DXAUDIO_ENDPOINT_FORMAT MixFormat; //The endpoint's mix format (all zero if it couldn't be read)
+};
+
+#define DXAUDIO_HISTOGRAM_BUCKETS 32 //Number of buckets in a DXAUDIO_HISTOGRAM
+
+/* DXAUDIO_HISTOGRAM summarizes a series of measurements.  Bucket 0 counts zeros, and bucket i counts values from
+** 2^(i-1) up to 2^i - 1, so each bucket is twice as wide as the one before it.  The last bucket also counts every
+** larger value. */
+struct DXAUDIO_HISTOGRAM {
+	UINT64 Count; //Number of measurements
+	UINT64 Total; //Sum of all measurements (divide by Count for the mean)
+	UINT64 Max; //Largest measurement
+	UINT64 Buckets[DXAUDIO_HISTOGRAM_BUCKETS]; //Number of measurements in each bucket
 };
 
-/* IDXAudioStream is the interface for all DXAudio streams. */
-struct __declspec(uuid("58127943-2ecc-4e74-845b-e4933263a880")) IDXAudioStream : public IUnknown {
+/* DXAUDIO_STREAM_PERFORMANCE is filled in by IDXAudioStream::GetPerformance().  Times are in microseconds. */
+struct DXAUDIO_STREAM_PERFORMANCE {
+	DXAUDIO_HISTOGRAM WakeupJitter; //How far each wakeup strayed from one device period (or batch) after the previous one
+	DXAUDIO_HISTOGRAM ConversionTime; //Time spent converting between the endpoint's sample format and floating point, per period
+	DXAUDIO_HISTOGRAM ResampleTime; //Time spent in libsamplerate, per period
+	DXAUDIO_HISTOGRAM CallbackTime; //Time spent in the application's OnProcess() method, per call
+	DXAUDIO_HISTOGRAM Utilization; //Time spent processing each period, as a percentage of the device period (over 100 is late)
+	DXAUDIO_HISTOGRAM ReinitializeTime; //Time taken to re-open the endpoint(s) after a device or property change
+	DXAUDIO_HISTOGRAM RecoveryTime; //Time from a device or property change notification to the first period processed on the re-opened endpoint(s)
+	DXAUDIO_HISTOGRAM SwitchTime; //Time the stream thread spent switching to an endpoint prepared in advance (DXAUDIO_STREAM_FLAG_WARM_STANDBY)
+	UINT64 FramesIn; //Frames read from the capture endpoint, at its own sample rate
+	UINT64 FramesOut; //Frames rendered to the render endpoint, at its own sample rate (including inserted silence)
+	UINT64 Reinitializations; //Number of times the endpoint(s) were re-opened
+	UINT64 StandbySwitches; //Number of times the stream switched to an endpoint prepared in advance (not counted as re-openings)
+	DOUBLE RealtimeFactor; //Offline streams only - seconds of audio produced per second spent producing it (zero for other streams)
+};
+
+/* DXAUDIO_GLITCH_TYPE identifies the kind of problem recorded in a DXAUDIO_GLITCH_EVENT */
+enum DXAUDIO_GLITCH_TYPE {
+	DXAUDIO_GLITCH_TYPE_DISCONTINUITY = 1, //The capture endpoint dropped data (AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY)
+	DXAUDIO_GLITCH_TYPE_TIMESTAMP_ERROR,   //A capture packet's timestamp is unreliable (AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR)
+	DXAUDIO_GLITCH_TYPE_RENDER_UNDERRUN,   //The render endpoint ran dry
+	DXAUDIO_GLITCH_TYPE_MISSED_DEADLINE    //The stream thread woke up late
+};
+
+/* DXAUDIO_GLITCH_EVENT describes a single glitch, as returned by IDXAudioStream::GetGlitchEvents() */
+struct DXAUDIO_GLITCH_EVENT {
+	DXAUDIO_GLITCH_TYPE Type; //What went wrong
+	UINT64 Time; //When it was detected, as a performance counter reading in 100-nanosecond units
+	UINT64 FramePosition; //Frames passed to the callback by then, at the stream's sample rate (see DXAUDIO_PERIOD_INFO)
+};
+
+/* DXAUDIO_PERIOD_FLAG values are combined in DXAUDIO_PERIOD_INFO::Flags */
+enum DXAUDIO_PERIOD_FLAG {
+	DXAUDIO_PERIOD_FLAG_SILENT_INPUT = 0x1, //Set by DXAudio if the endpoint reported every input frame in the buffer as silent
+	DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT = 0x2 //Set by the callback if its output is silent - the contents of the output buffer are then ignored
+};
+
+/* DXAUDIO_PERIOD_INFO is passed to the OnProcessEx() method of the extended callbacks.  Times are performance counter
+** values converted to 100-nanosecond units (the same clock WASAPI uses for its own timestamps), and device positions
+** are in frames at the endpoint's sample rate, counted from when its client was initialized.  Fields for an endpoint
+** the stream doesn't use are zero. */
+struct DXAUDIO_PERIOD_INFO {
+	UINT64 FramePosition; //Frames passed to the callback before this call, at the stream's sample rate - the index of the buffer's first frame
+	UINT64 InputDevicePosition; //Capture endpoint position of the first input frame in this buffer
+	UINT64 InputTime; //Time at which the first input frame in this buffer was captured (zero if the endpoint reported a timestamp error)
+	UINT64 OutputDevicePosition; //Estimated render endpoint position of the first output frame in this buffer
+	UINT64 OutputTime; //Estimated time at which the first output frame in this buffer will be presented
+	DWORD Flags; //A combination of DXAUDIO_PERIOD_FLAG values - the callback may add DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT
+};
+
+/* IDXAudioStream is the interface for all DXAudio streams.  Its IID changed when it grew past GetStreamType(), and
+** a stream still answers to the original one (58127943-2ecc-4e74-845b-e4933263a880) with this interface, whose
+** first four methods are unchanged. */
+struct __declspec(uuid("385fab7a-26f2-4efc-bfc7-4708aa3fcd86")) IDXAudioStream : public IUnknown {
 	/* Start() causes the stream to become active.  When this happens, your stream callback will
 	** be called repeatedly on a separate thread that is unique to the stream.  Note that the
 	** stream is initialized in a stopped state, so this must be called for the stream to
@@ -52,13 +234,74 @@ struct __declspec(uuid("58127943-2ecc-4e74-845b-e4933263a880")) IDXAudioStream :
 
 	/* GetSampleRate() returns the sample rate of the stream.  Note that this value remains
 	** constant throughout the lifetime of the stream.  If you want to change the sample
-	** rate, you will need to re-create the stream object. */
+	** rate, you will need to re-create the stream object.  The exception is a stream created with
+	** DXAUDIO_STREAM_FLAG_NATIVE_RATE, which returns the endpoint's rate once the stream is ready, and follows it
+	** if the endpoint is re-opened at another (see IDXAudioRateCallback). */
 	virtual FLOAT STDMETHODCALLTYPE GetSampleRate() PURE;
 
 	/* GetStreamType() returns the type of the stream.  Like the sample rate, this is bound
 	** to the stream object.  To use a different stream type, you will need to create a
 	** different stream object. */
 	virtual DXAUDIO_STREAM_TYPE STDMETHODCALLTYPE GetStreamType() PURE;
+
+	/* Write() queues output data on a push-mode stream (one created with a nonzero BufferFrames).  [AudioOut]
+	** holds [Frames] interleaved stereo samples at the stream's sample rate.  If [Blocking] is FALSE, as many
+	** frames as will fit are copied and the call returns immediately; otherwise it waits for the stream to make
+	** room until everything is written.  [pFramesWritten] receives the number of frames that were queued and
+	** may be NULL.  Returns S_FALSE if not everything was written, E_ABORT if the stream closed while waiting,
+	** and E_ILLEGAL_METHOD_CALL if the stream has no output ring buffer.  Only one thread may write at a time. */
+	virtual HRESULT STDMETHODCALLTYPE Write(const FLOAT* AudioOut, UINT Frames, UINT* pFramesWritten, BOOL Blocking) PURE;
+
+	/* Read() dequeues input data from a push-mode stream.  The semantics mirror Write(): a non-blocking call
+	** returns whatever is available, and a blocking call waits until [Frames] frames have been read.  Only one
+	** thread may read at a time. */
+	virtual HRESULT STDMETHODCALLTYPE Read(FLOAT* AudioIn, UINT Frames, UINT* pFramesRead, BOOL Blocking) PURE;
+
+	/* GetReadAvailable() returns the number of input frames waiting to be read (the fill level of the input ring). */
+	virtual UINT STDMETHODCALLTYPE GetReadAvailable() PURE;
+
+	/* GetWriteAvailable() returns the number of output frames that can be written without blocking.  The fill level
+	** of the output ring is BufferFrames (rounded up to a power of two) minus this value. */
+	virtual UINT STDMETHODCALLTYPE GetWriteAvailable() PURE;
+
+	/* GetAddedLatency() returns the latency, in frames at the stream's sample rate, that DXAudio adds on top of
+	** the endpoint's own buffering - for example, the re-blocking delay of a stream with a fixed BlockFrames,
+	** or the batching delay of a stream with CoalescePeriods. */
+	virtual UINT STDMETHODCALLTYPE GetAddedLatency() PURE;
+
+	/* GetStatistics() fills [pStatistics] with the stream's running counters.  These are updated by the stream
+	** thread, so the values are only approximately consistent with one another. */
+	virtual VOID STDMETHODCALLTYPE GetStatistics(DXAUDIO_STREAM_STATISTICS* pStatistics) PURE;
+
+	/* ResetStatistics() sets every counter reported by GetStatistics() back to zero. */
+	virtual VOID STDMETHODCALLTYPE ResetStatistics() PURE;
+
+	/* GetPerformance() fills [pPerformance] with timing histograms and throughput counters for the stream thread.
+	** Like GetStatistics(), the values are updated without locking and are only approximately consistent. */
+	virtual VOID STDMETHODCALLTYPE GetPerformance(DXAUDIO_STREAM_PERFORMANCE* pPerformance) PURE;
+
+	/* ResetPerformance() empties every histogram and zeroes every counter reported by GetPerformance(). */
+	virtual VOID STDMETHODCALLTYPE ResetPerformance() PURE;
+
+	/* GetGlitchEvents() copies up to [MaxEvents] of the most recent glitches into [pEvents], oldest first, and
+	** returns how many were copied.  Only the last few dozen are kept.  ResetStatistics() clears them as well. */
+	virtual UINT STDMETHODCALLTYPE GetGlitchEvents(DXAUDIO_GLITCH_EVENT* pEvents, UINT MaxEvents) PURE;
+
+	/* GetStreamInfo() fills [pInfo] with the way each endpoint was actually set up - exclusive or shared, its
+	** period, and whether DXAudio or the audio engine converts its audio.  Because the requested modes fall back
+	** quietly when the device can't support them, this is the way to find out which one is in effect.  It can
+	** change whenever the stream re-initializes after a device change. */
+	virtual VOID STDMETHODCALLTYPE GetStreamInfo(DXAUDIO_STREAM_INFO* pInfo) PURE;
+
+	/* GetReadyEvent() returns a manual-reset event that is set once the stream thread has finished opening its
+	** devices, whether it succeeded or not - streams are created without waiting for that.  The handle belongs to the
+	** stream: wait on it as much as you like, but don't close it or use it after releasing the stream. */
+	virtual HANDLE STDMETHODCALLTYPE GetReadyEvent() PURE;
+
+	/* WaitForReady() waits up to [Milliseconds] for the stream thread to finish opening its devices and returns the
+	** result - S_OK if the stream is ready to start, or the error that made it fail (which is also reported through
+	** OnObjectFailure()).  Returns E_PENDING if it's still opening them when the time runs out. */
+	virtual HRESULT STDMETHODCALLTYPE WaitForReady(DWORD Milliseconds) PURE;
 };
 
 /* IDXAudioCallback is the parent interface for all stream callbacks.   This should not be directly inherited.
@@ -75,12 +318,41 @@ struct __declspec(uuid("b19d3575-b174-409c-9a27-1b8bf5d938d4")) IDXAudioCallback
 	virtual VOID STDMETHODCALLTYPE OnThreadInit() PURE;
 };
 
-/* IDXAudioReadCallback is the callback interface for input and loopback streams. */
+/* IDXAudioGlitchCallback can optionally be implemented by any stream callback object.  If it answers QueryInterface()
+** for this interface, the stream notifies it of every glitch as well as recording it. */
+struct __declspec(uuid("56046658-fc72-4260-96ef-48d5fb84df20")) IDXAudioGlitchCallback : public IUnknown {
+	/* OnGlitch() is called on the stream thread as each glitch is detected.  It should return quickly, since
+	** it's called in the middle of processing a period. */
+	virtual VOID STDMETHODCALLTYPE OnGlitch(const DXAUDIO_GLITCH_EVENT* pEvent) PURE;
+};
+
+/* IDXAudioRateCallback can optionally be implemented by the callback object of a stream created with
+** DXAUDIO_STREAM_FLAG_NATIVE_RATE.  If it answers QueryInterface() for this interface, the stream tells it whenever
+** re-opening the endpoint changes the stream's sample rate. */
+struct __declspec(uuid("ffa772f6-2f23-4ef4-a0b4-83a20316e51e")) IDXAudioRateCallback : public IUnknown {
+	/* OnSampleRateChanged() is called on the stream thread, between periods, once the endpoint has been re-opened at
+	** [NewSampleRate].  The next OnProcess() call is the first at the new rate, and GetSampleRate() returns it from now
+	** on.  It isn't called for the rate the stream first opens at - wait for the stream to be ready and ask it. */
+	virtual VOID STDMETHODCALLTYPE OnSampleRateChanged(FLOAT OldSampleRate, FLOAT NewSampleRate) PURE;
+};
+
+/* IDXAudioOfflineCallback can optionally be implemented by the callback object of an offline stream, to receive the
+** rendered output in memory. */
+struct __declspec(uuid("3f0b7c42-8d1e-4a59-b6c3-9e27d5a14f86")) IDXAudioOfflineCallback : public IUnknown {
+	/* OnRender() is called on the stream thread with each block of output as the simulated render endpoint receives
+	** it - after resampling and conversion, in [pFormat].  [pData] holds [Frames] frames, and is only valid during
+	** the call.  This starts with the silence queued ahead of the first period (see "Output latency"). */
+	virtual VOID STDMETHODCALLTYPE OnRender(const WAVEFORMATEX* pFormat, const BYTE* pData, UINT Frames) PURE;
+};
+
+/* IDXAudioReadCallback is the callback interface for input and loopback streams.  Push-mode streams still require
+** the appropriate callback interface for error reporting, but never call OnProcess() on it. */
 struct __declspec(uuid("63366a5b-5a66-43bf-8d3b-36421d4036d3")) IDXAudioReadCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This provides the input data from the default endpoint
 	** as it arrives, at the given sample rate.  [Frames] represents the number of floating-point stereo samples
 	** available in the [AudioIn] buffer.  Note that this value is likely to frequently change between calls due to
-	** the process of resampling the input.  You should write your application to be flexible of this number.
+	** the process of resampling the input.  You should write your application to be flexible of this number,
+	** or set DXAUDIO_STREAM_DESC::BlockFrames to get a constant block size.
 	** Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames) PURE;
 };
@@ -94,12 +366,31 @@ public:
 
 #endif
 
+/* IDXAudioReadCallbackEx extends IDXAudioReadCallback with timing information.  If the callback object answers
+** QueryInterface() for this interface, OnProcessEx() is called instead of OnProcess(). */
+struct __declspec(uuid("e18d4e8a-f028-464d-8a14-4db2ed5d30d5")) IDXAudioReadCallbackEx : public IDXAudioReadCallback {
+	/* OnProcessEx() is the same as OnProcess(), with [pInfo] describing when the data in [AudioIn] was captured. */
+	virtual VOID STDMETHODCALLTYPE OnProcessEx(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames, DXAUDIO_PERIOD_INFO* pInfo) PURE;
+};
+
+#ifndef _DXAUDIO_DLL_PROJECT
+
+class CDXAudioReadCallbackEx abstract : public IDXAudioReadCallbackEx {
+public:
+	virtual VOID STDMETHODCALLTYPE OnThreadInit() { }
+
+	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames) { }
+};
+
+#endif
+
 /* IDXAudioWriteCallback is the callback interface for output streams. */
 struct __declspec(uuid("34ae23e3-6e51-4c41-86dd-37d0461ac6ae")) IDXAudioWriteCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This delivers your output data to the default endpoint
 	** at the given sample rate.  [Frames] represents the number of floating-point stereo samples you must produce
 	** to the [AudioOut] buffer.  Note that this value is likely to frequently change between calls due to
-	** the process of resampling the output.  You should write your application to be flexible of this number.
+	** the process of resampling the output.  You should write your application to be flexible of this number,
+	** or set DXAUDIO_STREAM_DESC::BlockFrames to get a constant block size.
 	** Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames) PURE;
 };
@@ -113,6 +404,25 @@ public:
 
 #endif
 
+/* IDXAudioWriteCallbackEx extends IDXAudioWriteCallback with timing information.  If the callback object answers
+** QueryInterface() for this interface, OnProcessEx() is called instead of OnProcess(). */
+struct __declspec(uuid("244c3fb8-1a2d-4d18-b62e-611f826fdf36")) IDXAudioWriteCallbackEx : public IDXAudioWriteCallback {
+	/* OnProcessEx() is the same as OnProcess(), with [pInfo] estimating when the data in [AudioOut] will be heard.  If
+	** the output is silent, set DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT in [pInfo]->Flags instead of filling [AudioOut]. */
+	virtual VOID STDMETHODCALLTYPE OnProcessEx(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames, DXAUDIO_PERIOD_INFO* pInfo) PURE;
+};
+
+#ifndef _DXAUDIO_DLL_PROJECT
+
+class CDXAudioWriteCallbackEx abstract : public IDXAudioWriteCallbackEx {
+public:
+	virtual VOID STDMETHODCALLTYPE OnThreadInit() { }
+
+	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames) { }
+};
+
+#endif
+
 /* IDXAudioReadWriteCallback is the callback interface for duplex and echo streams. */
 struct __declspec(uuid("857d0781-1b48-4494-b829-24f3b731ff6b")) IDXAudioReadWriteCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This retrieves input data from the default input endpoint and
@@ -120,7 +430,8 @@ struct __declspec(uuid("857d0781-1b48-4494-b829-24f3b731ff6b")) IDXAudioReadWrit
 	** [Frames] represents the number of floating-point stereo samples available in the [AudioIn] buffer, as well as
 	** the number of samples you must produce to the [AudioOut] buffer.
 	** Note that this value is likely to frequently change between calls due to the process of resampling.
-	** You should write your application to be flexible of this number.
+	** You should write your application to be flexible of this number,
+	** or set DXAUDIO_STREAM_DESC::BlockFrames to get a constant block size.
 	** Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames) PURE;
 };
@@ -134,6 +445,26 @@ public:
 
 #endif
 
+/* IDXAudioReadWriteCallbackEx extends IDXAudioReadWriteCallback with timing information.  If the callback object
+** answers QueryInterface() for this interface, OnProcessEx() is called instead of OnProcess(). */
+struct __declspec(uuid("23ce5de3-31c2-4160-af8a-597026e9627f")) IDXAudioReadWriteCallbackEx : public IDXAudioReadWriteCallback {
+	/* OnProcessEx() is the same as OnProcess(), with [pInfo] describing when the data in [AudioIn] was captured
+	** and when the data in [AudioOut] will be heard.  If the output is silent, set DXAUDIO_PERIOD_FLAG_SILENT_OUTPUT
+	** in [pInfo]->Flags instead of filling [AudioOut]. */
+	virtual VOID STDMETHODCALLTYPE OnProcessEx(FLOAT SampleRate, FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames, DXAUDIO_PERIOD_INFO* pInfo) PURE;
+};
+
+#ifndef _DXAUDIO_DLL_PROJECT
+
+class CDXAudioReadWriteCallbackEx abstract : public IDXAudioReadWriteCallbackEx {
+public:
+	virtual VOID STDMETHODCALLTYPE OnThreadInit() { }
+
+	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames) { }
+};
+
+#endif
+
 #ifndef _DXAUDIO_EXPORT_TAG
 	#ifdef _DXAUDIO_DLL_PROJECT
 		#define _DXAUDIO_EXPORT_TAG __declspec(dllexport)
@@ -150,3 +481,48 @@ extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateStream (
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 );
+
+/* DXAudioGetEndpointFormat() fills [pFormat] with the mix format of the default capture endpoint if [IsCapture] is
+** TRUE, or of the default render endpoint otherwise, so that a stream's SampleRate can be chosen to match it before
+** the stream is created.  COM is initialized on the calling thread for the duration of the call if it isn't already.
+** Once a stream exists, GetStreamInfo() reports the mix format of each of its endpoints. */
+extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioGetEndpointFormat (
+	BOOL IsCapture,
+	DXAUDIO_ENDPOINT_FORMAT* pFormat
+);
+
+/* DXAudioCreateStreamAsync() creates a stream just like DXAudioCreateStream(), and also hands back its ready event in
+** [phReady] (see IDXAudioStream::GetReadyEvent()) so that it can be waited on alongside the application's own
+** handles.  Once it's set, IDXAudioStream::WaitForReady(0) tells whether the stream opened its devices. */
+extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateStreamAsync (
+	const DXAUDIO_STREAM_DESC* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream,
+	HANDLE* phReady
+);
+
+/* DXAudioCreateStreams() creates [Count] streams at once, from [pDescs] and [ppDXAudioCallbacks], and waits until
+** every one of them has opened its devices or failed to.  The streams open their devices in parallel, and share a
+** single device enumerator and notification registration.  [ppDXAudioStreams] receives the streams, with nullptr
+** in place of each one that failed, and [pResults] - which may be NULL - receives each one's result.  Returns S_OK
+** if every stream is ready, or else the first failure it came across. */
+extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateStreams (
+	UINT Count,
+	const DXAUDIO_STREAM_DESC* pDescs,
+	IDXAudioCallback* const* ppDXAudioCallbacks,
+	IDXAudioStream** ppDXAudioStreams,
+	HRESULT* pResults
+);
+
+/* DXAudioEnumerateEndpoints() lists the system's active capture endpoints if [IsCapture] is TRUE, or its active
+** render endpoints otherwise.  Up to [MaxEndpoints] of them are written to [pEndpoints], and [pCount] receives how
+** many there are in all - pass NULL and zero to only count them.  Returns S_FALSE if [pEndpoints] was too small.
+** While any stream on the system's devices exists, the list is kept between calls and only gathered again once an
+** endpoint is added, removed, enabled or disabled, or changes its name, format or the default, so polling it is
+** cheap.  COM is initialized on the calling thread for the duration of the call if it isn't already. */
+extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioEnumerateEndpoints (
+	BOOL IsCapture,
+	DXAUDIO_ENDPOINT_DESC* pEndpoints,
+	UINT MaxEndpoints,
+	UINT* pCount
+);
@@ -0,0 +1,294 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "EndpointCache.h"
+#include "ClientNegotiation.h"
+
+static SRWLOCK s_Lock = SRWLOCK_INIT; //Guards everything below
+static bool s_IsWatched = false; //True between Watch() and Unwatch()
+static UINT64 s_Generation = 0; //Bumped whenever the snapshot goes stale, so that one gathered meanwhile isn't kept
+static bool s_IsValid[2] = { false, false }; //True if s_Endpoints holds the current snapshot, by flow
+static std::vector<DXAUDIO_ENDPOINT_DESC> s_Endpoints[2]; //The last snapshot of each flow (eRender, eCapture)
+static std::map<std::wstring, CComPtr<IMMDevice>> s_Devices; //Every endpoint opened by ID so far, by ID
+
+/* Fills [pDesc] from [pDevice].  Only the ID has to be read - the name and format are left zeroed if they can't be. */
+static HRESULT DescribeEndpoint(IMMDevice* pDevice, EDataFlow Flow, LPCWSTR DefaultID, DXAUDIO_ENDPOINT_DESC* pDesc) {
+	HRESULT hr = S_OK;
+	LPWSTR DeviceID = nullptr;
+	CComPtr<IPropertyStore> Properties;
+	PROPVARIANT Name;
+	PROPVARIANT Format;
+
+	ZeroMemory(pDesc, sizeof(DXAUDIO_ENDPOINT_DESC));
+
+	hr = pDevice->GetId (
+		&DeviceID
+	); if (FAILED(hr)) return hr;
+
+	//A truncated ID would name some other endpoint, or none
+	if (wcslen(DeviceID) >= DXAUDIO_MAX_DEVICE_ID) {
+		CoTaskMemFree(DeviceID);
+		return E_NOT_SUFFICIENT_BUFFER;
+	}
+
+	wcsncpy_s(pDesc->DeviceID, DeviceID, _TRUNCATE);
+	pDesc->IsCapture = Flow == eCapture;
+	pDesc->IsDefault = DefaultID != nullptr && wcscmp(DeviceID, DefaultID) == 0;
+	CoTaskMemFree(DeviceID);
+
+	PropVariantInit(&Name);
+
+	hr = pDevice->OpenPropertyStore (
+		STGM_READ,
+		&Properties
+	);
+
+	if (SUCCEEDED(hr)) {
+		hr = Properties->GetValue (
+			PKEY_Device_FriendlyName,
+			&Name
+		);
+	}
+
+	if (SUCCEEDED(hr) && Name.vt == VT_LPWSTR) {
+		wcsncpy_s(pDesc->FriendlyName, Name.pwszVal, _TRUNCATE);
+	}
+
+	PropVariantClear(&Name);
+
+	//The engine's format is read from the same store, which is far cheaper than activating a client for its mix format
+	PropVariantInit(&Format);
+
+	if (SUCCEEDED(hr)) {
+		hr = Properties->GetValue (
+			PKEY_AudioEngine_DeviceFormat,
+			&Format
+		);
+	}
+
+	if (SUCCEEDED(hr) && Format.vt == VT_BLOB && Format.blob.cbSize >= sizeof(WAVEFORMATEX)) {
+		DescribeFormat((const WAVEFORMATEX*)(Format.blob.pBlobData), &pDesc->MixFormat);
+	}
+
+	PropVariantClear(&Format);
+
+	return S_OK;
+}
+
+/* Fills [Endpoints] with the active endpoints of [Flow], as they are right now */
+static HRESULT GatherEndpoints(IMMDeviceEnumerator* pEnumerator, EDataFlow Flow, std::vector<DXAUDIO_ENDPOINT_DESC>& Endpoints) {
+	HRESULT hr = S_OK;
+	CComPtr<IMMDeviceCollection> Collection;
+	CComPtr<IMMDevice> DefaultDevice;
+	LPWSTR DefaultID = nullptr;
+	UINT Count = 0;
+
+	hr = pEnumerator->EnumAudioEndpoints (
+		Flow,
+		DEVICE_STATE_ACTIVE,
+		&Collection
+	); if (FAILED(hr)) return hr;
+
+	hr = Collection->GetCount (
+		&Count
+	); if (FAILED(hr)) return hr;
+
+	//There's no default endpoint when there are no endpoints at all
+	hr = pEnumerator->GetDefaultAudioEndpoint (
+		Flow,
+		eConsole,
+		&DefaultDevice
+	);
+
+	if (SUCCEEDED(hr)) {
+		DefaultDevice->GetId(&DefaultID);
+	}
+
+	Endpoints.reserve(Count);
+
+	for (UINT i = 0; i < Count; i++) {
+		CComPtr<IMMDevice> Device;
+		DXAUDIO_ENDPOINT_DESC Desc;
+
+		//An endpoint that goes away while we're at it is left out
+		hr = Collection->Item (
+			i,
+			&Device
+		);
+
+		if (SUCCEEDED(hr)) {
+			hr = DescribeEndpoint(Device, Flow, DefaultID, &Desc);
+		}
+
+		if (SUCCEEDED(hr)) {
+			Endpoints.push_back(Desc);
+		}
+	}
+
+	CoTaskMemFree(DefaultID);
+
+	return S_OK;
+}
+
+HRESULT EndpointCache::Enumerate(IMMDeviceEnumerator* pEnumerator, EDataFlow Flow, DXAUDIO_ENDPOINT_DESC* pEndpoints, UINT MaxEndpoints, UINT* pCount) {
+	HRESULT hr = S_OK;
+	std::vector<DXAUDIO_ENDPOINT_DESC> Endpoints;
+	const UINT Index = Flow == eCapture ? 1 : 0;
+	UINT64 Generation = 0;
+	bool IsCached = false;
+
+	AcquireSRWLockShared(&s_Lock);
+
+	IsCached = s_IsValid[Index];
+	Generation = s_Generation;
+
+	if (IsCached) {
+		Endpoints = s_Endpoints[Index];
+	}
+
+	ReleaseSRWLockShared(&s_Lock);
+
+	if (!IsCached) {
+		hr = GatherEndpoints(pEnumerator, Flow, Endpoints);
+		if (FAILED(hr)) return hr;
+
+		//The snapshot is only kept if nothing changed while it was being gathered
+		AcquireSRWLockExclusive(&s_Lock);
+
+		if (s_IsWatched && s_Generation == Generation) {
+			s_Endpoints[Index] = Endpoints;
+			s_IsValid[Index] = true;
+		}
+
+		ReleaseSRWLockExclusive(&s_Lock);
+	}
+
+	*pCount = UINT(Endpoints.size());
+
+	for (UINT i = 0; i < MaxEndpoints && i < *pCount; i++) {
+		pEndpoints[i] = Endpoints[i];
+	}
+
+	return *pCount > MaxEndpoints ? S_FALSE : S_OK;
+}
+
+HRESULT EndpointCache::GetDevice(IMMDeviceEnumerator* pEnumerator, LPCWSTR DeviceID, IMMDevice** ppDevice) {
+	HRESULT hr = S_OK;
+	bool IsFound = false;
+
+	AcquireSRWLockShared(&s_Lock);
+
+	auto i = s_Devices.find(DeviceID);
+
+	if (i != s_Devices.end()) {
+		hr = i->second.CopyTo(ppDevice);
+		IsFound = true;
+	}
+
+	ReleaseSRWLockShared(&s_Lock);
+
+	if (IsFound) {
+		return hr;
+	}
+
+	hr = pEnumerator->GetDevice (
+		DeviceID,
+		ppDevice
+	); if (FAILED(hr)) return hr;
+
+	//If another stream got here first, its device is kept and this one is simply handed back
+	AcquireSRWLockExclusive(&s_Lock);
+
+	if (s_IsWatched) {
+		s_Devices.emplace(DeviceID, *ppDevice);
+	}
+
+	ReleaseSRWLockExclusive(&s_Lock);
+
+	return S_OK;
+}
+
+VOID EndpointCache::Watch() {
+	AcquireSRWLockExclusive(&s_Lock);
+
+	//Anything gathered before the hub registered could have missed a change
+	s_IsWatched = true;
+	s_Generation++;
+
+	ReleaseSRWLockExclusive(&s_Lock);
+}
+
+VOID EndpointCache::Invalidate() {
+	AcquireSRWLockExclusive(&s_Lock);
+
+	s_IsValid[0] = false;
+	s_IsValid[1] = false;
+	s_Generation++;
+
+	ReleaseSRWLockExclusive(&s_Lock);
+}
+
+VOID EndpointCache::Forget(LPCWSTR DeviceID) {
+	CComPtr<IMMDevice> Device;
+
+	AcquireSRWLockExclusive(&s_Lock);
+
+	auto i = s_Devices.find(DeviceID);
+
+	if (i != s_Devices.end()) {
+		Device.Attach(i->second.Detach());
+		s_Devices.erase(i);
+	}
+
+	ReleaseSRWLockExclusive(&s_Lock);
+
+	//The device is released here, outside the lock
+	Device.Release();
+}
+
+VOID EndpointCache::Unwatch() {
+	std::map<std::wstring, CComPtr<IMMDevice>> Devices;
+
+	AcquireSRWLockExclusive(&s_Lock);
+
+	s_IsWatched = false;
+	s_IsValid[0] = false;
+	s_IsValid[1] = false;
+	s_Generation++;
+	s_Endpoints[0].clear();
+	s_Endpoints[1].clear();
+	Devices.swap(s_Devices);
+
+	ReleaseSRWLockExclusive(&s_Lock);
+
+	//The devices are released here, outside the lock
+	Devices.clear();
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include "DXAudio.h"
+
+/* EndpointCache keeps what's worth sharing about the system's endpoints between calls and streams: a snapshot of the
+** active endpoints of each flow for DXAudioEnumerateEndpoints(), and the device object of every endpoint a stream
+** has opened by ID, so that any number of streams on the same endpoint share one instead of each looking it up.
+** The snapshot reads each endpoint's name and format from its property store, never activating a client for it.
+** Neither is kept unless NotificationHub is registered, since that's what tells it when they go stale - the hub
+** calls Invalidate() for every notification that could change the snapshot, and Unwatch() when it unregisters. */
+class EndpointCache {
+public:
+	/* Fills up to [MaxEndpoints] entries of [pEndpoints] with the active endpoints of [Flow], and [pCount] with how
+	** many there are, using [pEnumerator] if the snapshot has to be gathered.  Returns S_FALSE if some didn't fit. */
+	static HRESULT Enumerate(IMMDeviceEnumerator* pEnumerator, EDataFlow Flow, DXAUDIO_ENDPOINT_DESC* pEndpoints, UINT MaxEndpoints, UINT* pCount);
+
+	/* Fills [ppDevice] with the endpoint whose ID is [DeviceID], looking it up with [pEnumerator] the first time */
+	static HRESULT GetDevice(IMMDeviceEnumerator* pEnumerator, LPCWSTR DeviceID, IMMDevice** ppDevice);
+
+	/* Called by NotificationHub once it's registered - from then on, what's gathered is kept */
+	static VOID Watch();
+
+	/* Called by NotificationHub when an endpoint is added, removed, enabled or disabled, or changes its name,
+	** format or the default - the next Enumerate() gathers a new snapshot */
+	static VOID Invalidate();
+
+	/* Called by NotificationHub when the endpoint whose ID is [DeviceID] is unplugged - its device object is dropped,
+	** and the next GetDevice() for it looks it up again */
+	static VOID Forget(LPCWSTR DeviceID);
+
+	/* Called by NotificationHub before it unregisters, on a thread with COM initialized - drops everything kept */
+	static VOID Unwatch();
+};
\ No newline at end of file
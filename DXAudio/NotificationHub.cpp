@@ -0,0 +1,196 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <atlbase.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <vector>
+
+#include "NotificationHub.h"
+#include "CMMNotificationClient.h"
+#include "EndpointCache.h"
+
+/* HubDispatcher receives the notifications from the one registration and passes them on to the listeners */
+class HubDispatcher : public CMMNotificationClientListener {
+public:
+	virtual VOID OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) final;
+
+	virtual VOID OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY& Key) final;
+
+	virtual VOID OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) final;
+};
+
+static SRWLOCK s_RegistrationLock = SRWLOCK_INIT; //Guards s_Enumerator and the registration (held across Register/Unregister)
+static SRWLOCK s_ListenerLock = SRWLOCK_INIT; //Guards s_Listeners, and is held shared while they're notified
+static std::vector<CMMNotificationClientListener*> s_Listeners; //Every subscribed listener
+static CComPtr<IMMDeviceEnumerator> s_Enumerator; //The enumerator the hub is registered with, while anyone's subscribed
+static HubDispatcher s_Dispatcher;
+static CMMNotificationClient s_Client(s_Dispatcher);
+
+VOID HubDispatcher::OnDefaultDeviceChanged(EDataFlow Flow, ERole Role, LPCWSTR DeviceID) {
+	if (!NotificationHub::IsRelevantRole(Role)) {
+		return;
+	}
+
+	EndpointCache::Invalidate(); //The snapshot says which endpoint is the default
+
+	AcquireSRWLockShared(&s_ListenerLock);
+
+	for (CMMNotificationClientListener* pListener : s_Listeners) {
+		pListener->OnDefaultDeviceChanged(Flow, Role, DeviceID);
+	}
+
+	ReleaseSRWLockShared(&s_ListenerLock);
+}
+
+VOID HubDispatcher::OnPropertyValueChanged(LPCWSTR DeviceID, const PROPERTYKEY& Key) {
+	const bool IsRelevant = NotificationHub::IsRelevantProperty(Key);
+
+	//The snapshot has each endpoint's format, and its name as well, which no stream cares about
+	if (IsRelevant || Key == PKEY_Device_FriendlyName) {
+		EndpointCache::Invalidate();
+	}
+
+	if (!IsRelevant) {
+		return;
+	}
+
+	AcquireSRWLockShared(&s_ListenerLock);
+
+	for (CMMNotificationClientListener* pListener : s_Listeners) {
+		pListener->OnPropertyValueChanged(DeviceID, Key);
+	}
+
+	ReleaseSRWLockShared(&s_ListenerLock);
+}
+
+VOID HubDispatcher::OnDeviceStateChanged(LPCWSTR DeviceID, DWORD State) {
+	EndpointCache::Invalidate();
+
+	//An endpoint that's unplugged may never come back, and its device object isn't kept waiting for it
+	if (State == DEVICE_STATE_NOTPRESENT) {
+		EndpointCache::Forget(DeviceID);
+	}
+
+	if (!NotificationHub::IsRelevantState(State)) {
+		return;
+	}
+
+	AcquireSRWLockShared(&s_ListenerLock);
+
+	for (CMMNotificationClientListener* pListener : s_Listeners) {
+		pListener->OnDeviceStateChanged(DeviceID, State);
+	}
+
+	ReleaseSRWLockShared(&s_ListenerLock);
+}
+
+HRESULT NotificationHub::Subscribe(CMMNotificationClientListener* pListener) {
+	HRESULT hr = S_OK;
+
+	AcquireSRWLockExclusive(&s_RegistrationLock);
+
+	if (s_Enumerator == nullptr) {
+		hr = CoCreateInstance (
+			__uuidof(MMDeviceEnumerator),
+			NULL,
+			CLSCTX_ALL,
+			__uuidof(IMMDeviceEnumerator),
+			(void**)(&s_Enumerator)
+		);
+
+		if (SUCCEEDED(hr)) {
+			hr = s_Enumerator->RegisterEndpointNotificationCallback (
+				&s_Client
+			);
+
+			if (FAILED(hr)) {
+				s_Enumerator.Release();
+			} else {
+				EndpointCache::Watch();
+			}
+		}
+	}
+
+	if (SUCCEEDED(hr)) {
+		AcquireSRWLockExclusive(&s_ListenerLock);
+		s_Listeners.push_back(pListener);
+		ReleaseSRWLockExclusive(&s_ListenerLock);
+	}
+
+	ReleaseSRWLockExclusive(&s_RegistrationLock);
+
+	return hr;
+}
+
+VOID NotificationHub::Unsubscribe(CMMNotificationClientListener* pListener) {
+	bool IsLast = false;
+
+	AcquireSRWLockExclusive(&s_RegistrationLock);
+	AcquireSRWLockExclusive(&s_ListenerLock);
+
+	for (auto i = s_Listeners.begin(); i != s_Listeners.end(); i++) {
+		if (*i == pListener) {
+			s_Listeners.erase(i);
+			break;
+		}
+	}
+
+	IsLast = s_Listeners.empty();
+
+	ReleaseSRWLockExclusive(&s_ListenerLock);
+
+	//Unregistering waits for any notification in progress, which may be waiting for the listener lock - so it
+	//mustn't be held here
+	if (IsLast && s_Enumerator != nullptr) {
+		s_Enumerator->UnregisterEndpointNotificationCallback (
+			&s_Client
+		);
+
+		EndpointCache::Unwatch();
+		s_Enumerator.Release();
+	}
+
+	ReleaseSRWLockExclusive(&s_RegistrationLock);
+}
+
+HRESULT NotificationHub::GetEnumerator(IMMDeviceEnumerator** ppEnumerator) {
+	HRESULT hr = S_OK;
+
+	AcquireSRWLockShared(&s_RegistrationLock);
+
+	if (s_Enumerator == nullptr) {
+		*ppEnumerator = nullptr;
+		hr = E_ILLEGAL_METHOD_CALL;
+	} else {
+		hr = s_Enumerator.CopyTo(ppEnumerator);
+	}
+
+	ReleaseSRWLockShared(&s_RegistrationLock);
+
+	return hr;
+}
+
+bool NotificationHub::IsRelevantProperty(const PROPERTYKEY& Key) {
+	return Key == PKEY_AudioEngine_DeviceFormat;
+}
\ No newline at end of file
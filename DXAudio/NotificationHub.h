@@ -0,0 +1,66 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <mmdeviceapi.h>
+
+#include "CMMNotificationClientListener.h"
+
+/* NotificationHub shares one endpoint notification registration between every stream in the process that runs on
+** the system's devices, instead of each stream registering its own.  Notifications that can't concern any stream -
+** default changes for roles other than eConsole, property changes other than the device format, and endpoints going
+** anywhere but active - are dropped once here, and the rest are passed on to every subscribed listener, which decides
+** for itself whether the flow or device is one of its own (see IsRelevantRole(), IsRelevantProperty() and
+** IsRelevantState()).  Every notification that could change the list of endpoints invalidates EndpointCache first.
+** Streams on simulated devices keep registering with their own enumerator.  The enumerator it registers with is
+** shared by the subscribers as well, so that streams created together don't each create one of their own (see
+** GetEnumerator()). */
+class NotificationHub {
+public:
+	/* Adds [pListener] to the listeners, registering with the system's device enumerator if it's the first.  Must be
+	** called on a thread with COM initialized. */
+	static HRESULT Subscribe(CMMNotificationClientListener* pListener);
+
+	/* Removes [pListener], unregistering if it was the last.  It's never called again once this returns. */
+	static VOID Unsubscribe(CMMNotificationClientListener* pListener);
+
+	/* Fills [ppEnumerator] with the system's device enumerator that the hub is registered with.  Only valid between
+	** Subscribe() and Unsubscribe() - the device objects are free-threaded, so any subscriber's thread can use it. */
+	static HRESULT GetEnumerator(IMMDeviceEnumerator** ppEnumerator);
+
+	/* Returns true if a default device change for [Role] can concern a stream - they all use the console role */
+	static bool IsRelevantRole(ERole Role) {
+		return Role == eConsole;
+	}
+
+	/* Returns true if a change of property [Key] can invalidate a stream's clients */
+	static bool IsRelevantProperty(const PROPERTYKEY& Key);
+
+	/* Returns true if an endpoint changing to [State] can concern a stream - one coming back has to be re-opened by
+	** the streams that chose it, while one going away only stops delivering events until then */
+	static bool IsRelevantState(DWORD State) {
+		return State == DEVICE_STATE_ACTIVE;
+	}
+};
\ No newline at end of file
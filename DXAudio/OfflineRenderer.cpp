@@ -0,0 +1,64 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <algorithm>
+
+#include "OfflineRenderer.h"
+#include "CSimulatedAudioClient.h"
+
+OfflineRenderer::OfflineRenderer() :
+m_pTracker(nullptr)
+{
+	//A stream has at most a render and a capture client, plus one of each while it re-initializes
+	m_Clients.reserve(4);
+}
+
+OfflineRenderer::~OfflineRenderer() { }
+
+VOID OfflineRenderer::Initialize(CComPtr<IDXAudioOfflineCallback> Callback, AllocationTracker* pTracker) {
+	m_Callback = Callback;
+	m_pTracker = pTracker;
+}
+
+VOID OfflineRenderer::AddClient(CSimulatedAudioClient* pClient) {
+	m_Clients.push_back(pClient);
+}
+
+VOID OfflineRenderer::RemoveClient(CSimulatedAudioClient* pClient) {
+	m_Clients.erase(std::remove(m_Clients.begin(), m_Clients.end(), pClient), m_Clients.end());
+}
+
+VOID OfflineRenderer::AdvancePeriod() {
+	for (size_t i = 0; i < m_Clients.size(); i++) {
+		m_Clients[i]->AdvanceOfflinePeriod();
+	}
+}
+
+VOID OfflineRenderer::OnRender(const WAVEFORMATEX* pFormat, const BYTE* pData, UINT32 Frames) {
+	if (m_Callback != nullptr) {
+		m_pTracker->Pause();
+		m_Callback->OnRender(pFormat, pData, Frames);
+		m_pTracker->Resume();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <vector>
+#include "DXAudio.h"
+#include "AllocationTracker.h"
+
+class CSimulatedAudioClient;
+
+/* OfflineRenderer drives the simulated endpoints of an offline stream.  Their clients have no clock threads of
+** their own - the stream thread calls AdvancePeriod() before processing each period instead, so the devices move
+** exactly as fast as the stream can keep up with them.  Everything the render client is given is passed on to the
+** application's IDXAudioOfflineCallback (the simulated render device writes the file itself).  Only the stream
+** thread uses this class. */
+class OfflineRenderer {
+public:
+	OfflineRenderer();
+
+	~OfflineRenderer();
+
+	/* [Callback] may be NULL.  [pTracker] is paused while the callback runs. */
+	VOID Initialize(CComPtr<IDXAudioOfflineCallback> Callback, AllocationTracker* pTracker);
+
+	/* Registers a client created on one of the simulated devices */
+	VOID AddClient(CSimulatedAudioClient* pClient);
+
+	/* Forgets a client, when it's released */
+	VOID RemoveClient(CSimulatedAudioClient* pClient);
+
+	/* Moves every started client on by one device period */
+	VOID AdvancePeriod();
+
+	/* Called by the render client with [Frames] frames of [pFormat] it was just given */
+	VOID OnRender(const WAVEFORMATEX* pFormat, const BYTE* pData, UINT32 Frames);
+
+private:
+	std::vector<CSimulatedAudioClient*> m_Clients; //Clients currently alive on the simulated devices
+	CComPtr<IDXAudioOfflineCallback> m_Callback; //The application's offline callback, if it implements one
+	AllocationTracker* m_pTracker; //The stream's allocation tracker
+};
\ No newline at end of file
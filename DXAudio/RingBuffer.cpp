@@ -0,0 +1,146 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#include "RingBuffer.h"
+#include <malloc.h>
+#include <string.h>
+
+#define FRAME_SIZE (sizeof(FLOAT) * 2)
+
+RingBuffer::RingBuffer() :
+m_Buffer(nullptr),
+m_Capacity(0),
+m_Mask(0),
+m_WriteIndex(0),
+m_CachedReadIndex(0),
+m_ReadIndex(0),
+m_CachedWriteIndex(0)
+{ }
+
+RingBuffer::~RingBuffer() {
+	Clean();
+}
+
+HRESULT RingBuffer::Initialize(UINT Frames) {
+	UINT Capacity = 1;
+
+	Clean();
+
+	if (Frames == 0 || Frames > 0x40000000) {
+		return E_INVALIDARG;
+	}
+
+	//Round up to the next power of two
+	while (Capacity < Frames) {
+		Capacity <<= 1;
+	}
+
+	m_Buffer = (FLOAT*)(_aligned_malloc(FRAME_SIZE * Capacity, CACHE_LINE_SIZE));
+
+	if (m_Buffer == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	m_Capacity = Capacity;
+	m_Mask = Capacity - 1;
+	m_WriteIndex.store(0, std::memory_order_relaxed);
+	m_ReadIndex.store(0, std::memory_order_relaxed);
+	m_CachedReadIndex = 0;
+	m_CachedWriteIndex = 0;
+
+	return S_OK;
+}
+
+VOID RingBuffer::Clean() {
+	if (m_Buffer != nullptr) {
+		_aligned_free(m_Buffer);
+		m_Buffer = nullptr;
+	}
+
+	m_Capacity = 0;
+	m_Mask = 0;
+	m_WriteIndex.store(0, std::memory_order_relaxed);
+	m_ReadIndex.store(0, std::memory_order_relaxed);
+	m_CachedReadIndex = 0;
+	m_CachedWriteIndex = 0;
+}
+
+UINT RingBuffer::Write(const FLOAT* Buffer, UINT Frames) {
+	const UINT WriteIndex = m_WriteIndex.load(std::memory_order_relaxed);
+	UINT Free = m_Capacity - (WriteIndex - m_CachedReadIndex);
+
+	//Only touch the consumer's cache line if the cached index says we're out of room
+	if (Free < Frames) {
+		m_CachedReadIndex = m_ReadIndex.load(std::memory_order_acquire);
+		Free = m_Capacity - (WriteIndex - m_CachedReadIndex);
+	}
+
+	if (Frames > Free) {
+		Frames = Free;
+	}
+
+	if (Frames == 0) {
+		return 0;
+	}
+
+	//Copy in at most two pieces - up to the end of the storage, then from the beginning
+	const UINT Offset = WriteIndex & m_Mask;
+	const UINT FirstPart = (Frames < m_Capacity - Offset) ? Frames : m_Capacity - Offset;
+
+	memcpy(m_Buffer + Offset * 2, Buffer, FirstPart * FRAME_SIZE);
+	memcpy(m_Buffer, Buffer + FirstPart * 2, (Frames - FirstPart) * FRAME_SIZE);
+
+	//Publish the frames to the consumer
+	m_WriteIndex.store(WriteIndex + Frames, std::memory_order_release);
+
+	return Frames;
+}
+
+UINT RingBuffer::Read(FLOAT* Buffer, UINT Frames) {
+	const UINT ReadIndex = m_ReadIndex.load(std::memory_order_relaxed);
+	UINT Available = m_CachedWriteIndex - ReadIndex;
+
+	//Only touch the producer's cache line if the cached index says we're out of data
+	if (Available < Frames) {
+		m_CachedWriteIndex = m_WriteIndex.load(std::memory_order_acquire);
+		Available = m_CachedWriteIndex - ReadIndex;
+	}
+
+	if (Frames > Available) {
+		Frames = Available;
+	}
+
+	if (Frames == 0) {
+		return 0;
+	}
+
+	const UINT Offset = ReadIndex & m_Mask;
+	const UINT FirstPart = (Frames < m_Capacity - Offset) ? Frames : m_Capacity - Offset;
+
+	memcpy(Buffer, m_Buffer + Offset * 2, FirstPart * FRAME_SIZE);
+	memcpy(Buffer + FirstPart * 2, m_Buffer, (Frames - FirstPart) * FRAME_SIZE);
+
+	//Hand the space back to the producer
+	m_ReadIndex.store(ReadIndex + Frames, std::memory_order_release);
+
+	return Frames;
+}
@@ -0,0 +1,97 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#pragma once
+
+#include <comdef.h>
+#include <atomic>
+
+#define CACHE_LINE_SIZE 64
+
+/* RingBuffer is a lock-free single-producer, single-consumer FIFO of stereo floating-point
+** frames.  Exactly one thread may call Write() and exactly one other thread may call Read();
+** neither call ever blocks or waits on the other.  The capacity is always a power of two so
+** that indices can be wrapped with a mask. */
+class RingBuffer {
+public:
+	RingBuffer();
+
+	~RingBuffer();
+
+	/* Allocates the buffer.  [Frames] is the minimum capacity, and is rounded up to the next
+	** power of two.  This must not be called while another thread is using the buffer. */
+	HRESULT Initialize(UINT Frames);
+
+	/* Frees the buffer and sets the object to a pre-initialized state. */
+	VOID Clean();
+
+	/* Copies up to [Frames] frames from [Buffer] into the ring and returns the number of frames
+	** actually written.  This is only to be called from the producer thread. */
+	UINT Write(const FLOAT* Buffer, UINT Frames);
+
+	/* Copies up to [Frames] frames out of the ring into [Buffer] and returns the number of frames
+	** actually read.  This is only to be called from the consumer thread. */
+	UINT Read(FLOAT* Buffer, UINT Frames);
+
+	/* Returns the number of frames waiting to be read.  This can be called from any thread - from a thread other
+	** than the producer and consumer, the answer may already be out of date, but it's always within the capacity. */
+	UINT GetReadAvailable() const {
+		//The read index is loaded first: it can only catch up with the write index, never pass it, so the write
+		//index loaded after it is never behind it.  The consumer may still move on in between, which can leave the
+		//difference above the capacity if the producer refilled the ring meanwhile.
+		const UINT ReadIndex = m_ReadIndex.load(std::memory_order_acquire);
+		const UINT Available = m_WriteIndex.load(std::memory_order_acquire) - ReadIndex;
+
+		return Available < m_Capacity ? Available : m_Capacity;
+	}
+
+	/* Returns the number of frames that can be written without overflowing.  This can be called from any thread. */
+	UINT GetWriteAvailable() const {
+		return m_Capacity - GetReadAvailable();
+	}
+
+	/* Returns the capacity of the ring in frames. */
+	UINT GetCapacity() const {
+		return m_Capacity;
+	}
+
+	/* Returns true if the buffer has been allocated. */
+	bool IsInitialized() const {
+		return m_Buffer != nullptr;
+	}
+
+private:
+	FLOAT* m_Buffer; //The frame storage, aligned to a cache line
+	UINT m_Capacity; //Capacity in frames (always a power of two)
+	UINT m_Mask; //m_Capacity - 1, used for wrapping indices
+
+	//The indices only ever increase and are allowed to wrap around UINT_MAX.  Each one is written
+	//by one side only, and lives on its own cache line (along with that side's cached copy of
+	//the other index) so that the producer and consumer never contend for the same line.
+	alignas(CACHE_LINE_SIZE) std::atomic<UINT> m_WriteIndex; //Next frame to be written (owned by the producer)
+	UINT m_CachedReadIndex; //The producer's last observed read index
+
+	alignas(CACHE_LINE_SIZE) std::atomic<UINT> m_ReadIndex; //Next frame to be read (owned by the consumer)
+	UINT m_CachedWriteIndex; //The consumer's last observed write index
+
+	BYTE m_Padding[CACHE_LINE_SIZE - sizeof(std::atomic<UINT>) - sizeof(UINT)]; //Keeps whatever follows off the consumer's line
+};
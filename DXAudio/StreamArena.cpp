@@ -0,0 +1,92 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "StreamArena.h"
+#include <malloc.h>
+#include <string.h>
+
+#define FRAME_SIZE (sizeof(FLOAT) * 2)
+
+//Rounds a size in bytes up to a whole number of cache lines
+#define CACHE_ALIGN(Size) (((Size) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1))
+
+StreamArena::StreamArena() :
+m_Block(nullptr),
+m_Input(nullptr),
+m_Output(nullptr),
+m_InputFrames(0),
+m_OutputFrames(0)
+{ }
+
+StreamArena::~StreamArena() {
+	Clean();
+}
+
+HRESULT StreamArena::Reserve(UINT InputFrames, UINT OutputFrames) {
+	size_t InputSize = 0;
+	size_t OutputSize = 0;
+	BYTE* Block = nullptr;
+
+	//Nothing to do if the buffers are already large enough
+	if (m_Block != nullptr && InputFrames <= m_InputFrames && OutputFrames <= m_OutputFrames) {
+		return S_OK;
+	}
+
+	//Never shrink either buffer
+	if (InputFrames < m_InputFrames) InputFrames = m_InputFrames;
+	if (OutputFrames < m_OutputFrames) OutputFrames = m_OutputFrames;
+
+	InputSize = CACHE_ALIGN(FRAME_SIZE * InputFrames);
+	OutputSize = CACHE_ALIGN(FRAME_SIZE * OutputFrames);
+
+	Block = (BYTE*)(_aligned_malloc(InputSize + OutputSize + CACHE_LINE_SIZE, CACHE_LINE_SIZE));
+
+	if (Block == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	//Start out silent, so that a buffer that's only partially written never holds garbage
+	memset(Block, 0, InputSize + OutputSize + CACHE_LINE_SIZE);
+
+	Clean();
+
+	m_Block = Block;
+	m_Input = (FLOAT*)(Block);
+	m_Output = (FLOAT*)(Block + InputSize);
+	m_InputFrames = InputFrames;
+	m_OutputFrames = OutputFrames;
+
+	return S_OK;
+}
+
+VOID StreamArena::Clean() {
+	if (m_Block != nullptr) {
+		_aligned_free(m_Block);
+		m_Block = nullptr;
+	}
+
+	m_Input = nullptr;
+	m_Output = nullptr;
+	m_InputFrames = 0;
+	m_OutputFrames = 0;
+}
\ No newline at end of file
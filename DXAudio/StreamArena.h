@@ -0,0 +1,74 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include "RingBuffer.h"
+
+/* StreamArena owns the scratch buffers a stream hands between its client reader, its callback and its
+** client writer each period.  Both buffers live in a single allocation, each starting on its own cache
+** line, and are sized once when the clients are initialized - the hot path never allocates or touches
+** the stack for audio data.  The buffers only ever grow, so re-initializing after a device change only
+** reallocates if the new device needs more room. */
+class StreamArena {
+public:
+	StreamArena();
+
+	~StreamArena();
+
+	/* Makes sure the input buffer holds at least [InputFrames] frames and the output buffer at least
+	** [OutputFrames].  Either can be zero if the stream doesn't use it.  This must only be called from
+	** the stream thread, outside of processing, since it may move the buffers. */
+	HRESULT Reserve(UINT InputFrames, UINT OutputFrames);
+
+	/* Frees the memory and sets the object to a pre-initialized state. */
+	VOID Clean();
+
+	/* Returns the input buffer - resampled data from the client reader */
+	FLOAT* GetInput() {
+		return m_Input;
+	}
+
+	/* Returns the output buffer - data from the callback, on its way to the client writer */
+	FLOAT* GetOutput() {
+		return m_Output;
+	}
+
+	/* Returns the capacity of the input buffer in frames */
+	UINT GetInputFrames() const {
+		return m_InputFrames;
+	}
+
+	/* Returns the capacity of the output buffer in frames */
+	UINT GetOutputFrames() const {
+		return m_OutputFrames;
+	}
+
+private:
+	BYTE* m_Block; //The single allocation holding both buffers, aligned to a cache line
+	FLOAT* m_Input; //Input buffer (inside m_Block)
+	FLOAT* m_Output; //Output buffer (inside m_Block)
+	UINT m_InputFrames; //Capacity of m_Input in frames
+	UINT m_OutputFrames; //Capacity of m_Output in frames
+};
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "StreamPerformance.h"
+
+PerformanceHistogram::PerformanceHistogram() :
+m_Count(0),
+m_Total(0),
+m_Max(0)
+{
+	for (UINT i = 0; i < DXAUDIO_HISTOGRAM_BUCKETS; i++) {
+		m_Buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+VOID PerformanceHistogram::Record(UINT64 Value) {
+	UINT64 Max = m_Max.load(std::memory_order_relaxed);
+	UINT64 Remaining = Value;
+	UINT Bucket = 0;
+
+	//The bucket is one more than the index of the highest set bit, or zero for zero
+	while (Remaining != 0 && Bucket < DXAUDIO_HISTOGRAM_BUCKETS - 1) {
+		Remaining >>= 1;
+		Bucket++;
+	}
+
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+	m_Total.fetch_add(Value, std::memory_order_relaxed);
+	m_Buckets[Bucket].fetch_add(1, std::memory_order_relaxed);
+
+	//Only the stream thread raises the maximum, but Reset() may lower it concurrently
+	while (Value > Max && !m_Max.compare_exchange_weak(Max, Value, std::memory_order_relaxed));
+}
+
+VOID PerformanceHistogram::GetHistogram(DXAUDIO_HISTOGRAM* pHistogram) const {
+	pHistogram->Count = m_Count.load(std::memory_order_relaxed);
+	pHistogram->Total = m_Total.load(std::memory_order_relaxed);
+	pHistogram->Max = m_Max.load(std::memory_order_relaxed);
+
+	for (UINT i = 0; i < DXAUDIO_HISTOGRAM_BUCKETS; i++) {
+		pHistogram->Buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+	}
+}
+
+VOID PerformanceHistogram::Reset() {
+	m_Count.store(0, std::memory_order_relaxed);
+	m_Total.store(0, std::memory_order_relaxed);
+	m_Max.store(0, std::memory_order_relaxed);
+
+	for (UINT i = 0; i < DXAUDIO_HISTOGRAM_BUCKETS; i++) {
+		m_Buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+StreamPerformance::StreamPerformance() :
+m_LastWakeup(0),
+m_FramesIn(0),
+m_FramesOut(0),
+m_Reinitializations(0),
+m_StandbySwitches(0),
+m_OfflineTicks(0),
+m_OfflineAudioTime(0)
+{
+	QueryPerformanceFrequency(&m_Frequency);
+}
+
+VOID StreamPerformance::OnWakeup(LONGLONG Now, REFERENCE_TIME ExpectedInterval) {
+	//Jitter is the distance from when the wakeup was due, early or late
+	if (m_LastWakeup != 0 && ExpectedInterval != 0) {
+		const INT64 Interval = INT64(ToMicroseconds(Now - m_LastWakeup));
+		const INT64 Expected = INT64(ExpectedInterval / 10);
+
+		m_WakeupJitter.Record(UINT64(Interval > Expected ? Interval - Expected : Expected - Interval));
+	}
+
+	m_LastWakeup = Now;
+}
+
+VOID StreamPerformance::OnPeriodEnd(LONGLONG Start, REFERENCE_TIME ExpectedInterval) {
+	//Compare the time taken against the time available (microseconds * 1000 / 100-nanosecond units = percent)
+	if (ExpectedInterval != 0) {
+		m_Utilization.Record(ToMicroseconds(GetTicks() - Start) * 1000 / UINT64(ExpectedInterval));
+	}
+}
+
+VOID StreamPerformance::OnReinitialize(LONGLONG Ticks) {
+	m_ReinitializeTime.Record(ToMicroseconds(Ticks));
+	m_Reinitializations.fetch_add(1, std::memory_order_relaxed);
+}
+
+VOID StreamPerformance::GetPerformance(DXAUDIO_STREAM_PERFORMANCE* pPerformance) const {
+	m_WakeupJitter.GetHistogram(&pPerformance->WakeupJitter);
+	m_ConversionTime.GetHistogram(&pPerformance->ConversionTime);
+	m_ResampleTime.GetHistogram(&pPerformance->ResampleTime);
+	m_CallbackTime.GetHistogram(&pPerformance->CallbackTime);
+	m_Utilization.GetHistogram(&pPerformance->Utilization);
+	m_ReinitializeTime.GetHistogram(&pPerformance->ReinitializeTime);
+	m_RecoveryTime.GetHistogram(&pPerformance->RecoveryTime);
+	m_SwitchTime.GetHistogram(&pPerformance->SwitchTime);
+	pPerformance->FramesIn = m_FramesIn.load(std::memory_order_relaxed);
+	pPerformance->FramesOut = m_FramesOut.load(std::memory_order_relaxed);
+	pPerformance->Reinitializations = m_Reinitializations.load(std::memory_order_relaxed);
+	pPerformance->StandbySwitches = m_StandbySwitches.load(std::memory_order_relaxed);
+
+	//Audio time over processing time, both in seconds
+	const UINT64 OfflineTicks = m_OfflineTicks.load(std::memory_order_relaxed);
+
+	pPerformance->RealtimeFactor = OfflineTicks == 0 ? 0.0 :
+		(DOUBLE(m_OfflineAudioTime.load(std::memory_order_relaxed)) / 10000000.0) / (DOUBLE(OfflineTicks) / DOUBLE(m_Frequency.QuadPart));
+}
+
+VOID StreamPerformance::Reset() {
+	m_WakeupJitter.Reset();
+	m_ConversionTime.Reset();
+	m_ResampleTime.Reset();
+	m_CallbackTime.Reset();
+	m_Utilization.Reset();
+	m_ReinitializeTime.Reset();
+	m_RecoveryTime.Reset();
+	m_SwitchTime.Reset();
+	m_FramesIn.store(0, std::memory_order_relaxed);
+	m_FramesOut.store(0, std::memory_order_relaxed);
+	m_Reinitializations.store(0, std::memory_order_relaxed);
+	m_StandbySwitches.store(0, std::memory_order_relaxed);
+	m_OfflineTicks.store(0, std::memory_order_relaxed);
+	m_OfflineAudioTime.store(0, std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <atomic>
+
+/* PerformanceHistogram accumulates a DXAUDIO_HISTOGRAM.  Only the stream thread records values, but
+** any thread may read or reset it, so every field is a relaxed atomic. */
+class PerformanceHistogram {
+public:
+	PerformanceHistogram();
+
+	/* Adds [Value] to the histogram. */
+	VOID Record(UINT64 Value);
+
+	/* Copies the histogram into [pHistogram]. */
+	VOID GetHistogram(DXAUDIO_HISTOGRAM* pHistogram) const;
+
+	/* Empties the histogram. */
+	VOID Reset();
+
+private:
+	std::atomic<UINT64> m_Count; //Number of values recorded
+	std::atomic<UINT64> m_Total; //Sum of the values recorded
+	std::atomic<UINT64> m_Max; //Largest value recorded
+	std::atomic<UINT64> m_Buckets[DXAUDIO_HISTOGRAM_BUCKETS]; //Values recorded in each power-of-two bucket
+};
+
+/* StreamPerformance holds the measurements reported by IDXAudioStream::GetPerformance().  The stream
+** thread and its client reader/writer take performance counter readings around each stage of a period
+** and pass the elapsed ticks in here, where they're converted to microseconds and recorded. */
+class StreamPerformance {
+public:
+	StreamPerformance();
+
+	/* Returns the current performance counter reading, in ticks. */
+	static LONGLONG GetTicks() {
+		LARGE_INTEGER Now;
+		QueryPerformanceCounter(&Now);
+		return Now.QuadPart;
+	}
+
+	/* Called when the stream thread wakes up to process, at [Now] ticks.  [ExpectedInterval] is how long after
+	** the previous wakeup this one was due, in 100-nanosecond units. */
+	VOID OnWakeup(LONGLONG Now, REFERENCE_TIME ExpectedInterval);
+
+	/* Called when the stream thread has finished a period that started at [Start] ticks. */
+	VOID OnPeriodEnd(LONGLONG Start, REFERENCE_TIME ExpectedInterval);
+
+	/* Forgets the previous wakeup, so that the next one isn't measured against it (after a stop or re-initialization). */
+	VOID RestartWakeups() {
+		m_LastWakeup = 0;
+	}
+
+	/* These record [Ticks] spent converting samples, resampling, or in the application's callback. */
+	VOID OnConversion(LONGLONG Ticks) {
+		m_ConversionTime.Record(ToMicroseconds(Ticks));
+	}
+
+	VOID OnResample(LONGLONG Ticks) {
+		m_ResampleTime.Record(ToMicroseconds(Ticks));
+	}
+
+	VOID OnCallback(LONGLONG Ticks) {
+		m_CallbackTime.Record(ToMicroseconds(Ticks));
+	}
+
+	/* Called after each period of an offline stream, which took [Ticks] to produce [Interval] (in 100-nanosecond units) of audio. */
+	VOID OnOfflinePeriod(LONGLONG Ticks, REFERENCE_TIME Interval) {
+		m_OfflineTicks.fetch_add(UINT64(Ticks > 0 ? Ticks : 0), std::memory_order_relaxed);
+		m_OfflineAudioTime.fetch_add(UINT64(Interval), std::memory_order_relaxed);
+	}
+
+	/* Called when the endpoint(s) were re-opened, which took [Ticks]. */
+	VOID OnReinitialize(LONGLONG Ticks);
+
+	/* Called once the first period after a re-open has been processed, [Ticks] after the change was notified. */
+	VOID OnRecovery(LONGLONG Ticks) {
+		m_RecoveryTime.Record(ToMicroseconds(Ticks));
+	}
+
+	/* Called when the stream switched to an endpoint prepared in advance, which took [Ticks] on the stream thread. */
+	VOID OnStandbySwitch(LONGLONG Ticks) {
+		m_SwitchTime.Record(ToMicroseconds(Ticks));
+		m_StandbySwitches.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/* Called by the client reader and writer with the number of endpoint frames they read or rendered. */
+	VOID OnFramesIn(UINT Frames) {
+		m_FramesIn.fetch_add(Frames, std::memory_order_relaxed);
+	}
+
+	VOID OnFramesOut(UINT Frames) {
+		m_FramesOut.fetch_add(Frames, std::memory_order_relaxed);
+	}
+
+	/* Copies the current measurements into [pPerformance]. */
+	VOID GetPerformance(DXAUDIO_STREAM_PERFORMANCE* pPerformance) const;
+
+	/* Empties every histogram and zeroes every counter. */
+	VOID Reset();
+
+private:
+	LARGE_INTEGER m_Frequency; //Ticks per second of the performance counter
+	LONGLONG m_LastWakeup; //Ticks at the previous wakeup, or zero if there wasn't one (stream thread only)
+
+	PerformanceHistogram m_WakeupJitter;
+	PerformanceHistogram m_ConversionTime;
+	PerformanceHistogram m_ResampleTime;
+	PerformanceHistogram m_CallbackTime;
+	PerformanceHistogram m_Utilization;
+	PerformanceHistogram m_ReinitializeTime;
+	PerformanceHistogram m_RecoveryTime;
+	PerformanceHistogram m_SwitchTime;
+	std::atomic<UINT64> m_FramesIn; //Frames read from the capture endpoint
+	std::atomic<UINT64> m_FramesOut; //Frames rendered to the render endpoint
+	std::atomic<UINT64> m_Reinitializations; //Number of re-initializations
+	std::atomic<UINT64> m_StandbySwitches; //Number of switches to a standby endpoint
+	std::atomic<UINT64> m_OfflineTicks; //Ticks spent processing offline periods
+	std::atomic<UINT64> m_OfflineAudioTime; //Audio produced by those periods, in 100-nanosecond units
+
+	/* Converts a tick count to microseconds */
+	UINT64 ToMicroseconds(LONGLONG Ticks) const {
+		return Ticks > 0 ? UINT64(Ticks) * 1000000 / UINT64(m_Frequency.QuadPart) : 0;
+	}
+};
\ No newline at end of file
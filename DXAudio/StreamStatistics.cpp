@@ -0,0 +1,122 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "StreamStatistics.h"
+
+StreamStatistics::StreamStatistics() :
+m_Wakeups(0),
+m_CapturePackets(0),
+m_CatchUpWakeups(0),
+m_CatchUpPackets(0),
+m_MaxPacketsPerWakeup(0),
+m_Discontinuities(0),
+m_TimestampErrors(0),
+m_RenderUnderruns(0),
+m_MissedDeadlines(0),
+m_GlitchCount(0),
+m_GlitchIndex(0)
+{
+	ZeroMemory(m_Glitches, sizeof(m_Glitches));
+	InitializeSRWLock(&m_GlitchLock);
+}
+
+VOID StreamStatistics::OnCaptureWakeup(UINT Packets) {
+	UINT Max = m_MaxPacketsPerWakeup.load(std::memory_order_relaxed);
+
+	m_CapturePackets.fetch_add(Packets, std::memory_order_relaxed);
+
+	if (Packets > 1) {
+		m_CatchUpWakeups.fetch_add(1, std::memory_order_relaxed);
+		m_CatchUpPackets.fetch_add(Packets - 1, std::memory_order_relaxed);
+	}
+
+	//Only the stream thread raises the maximum, but Reset() may lower it concurrently
+	while (Packets > Max && !m_MaxPacketsPerWakeup.compare_exchange_weak(Max, Packets, std::memory_order_relaxed));
+}
+
+VOID StreamStatistics::OnGlitch(const DXAUDIO_GLITCH_EVENT& Event) {
+	switch (Event.Type) {
+		case DXAUDIO_GLITCH_TYPE_DISCONTINUITY: m_Discontinuities.fetch_add(1, std::memory_order_relaxed); break;
+		case DXAUDIO_GLITCH_TYPE_TIMESTAMP_ERROR: m_TimestampErrors.fetch_add(1, std::memory_order_relaxed); break;
+		case DXAUDIO_GLITCH_TYPE_RENDER_UNDERRUN: m_RenderUnderruns.fetch_add(1, std::memory_order_relaxed); break;
+		case DXAUDIO_GLITCH_TYPE_MISSED_DEADLINE: m_MissedDeadlines.fetch_add(1, std::memory_order_relaxed); break;
+	}
+
+	AcquireSRWLockExclusive(&m_GlitchLock);
+
+	//Overwrite the oldest event once the history is full
+	m_Glitches[m_GlitchIndex] = Event;
+	m_GlitchIndex = (m_GlitchIndex + 1) % GLITCH_HISTORY;
+
+	if (m_GlitchCount < GLITCH_HISTORY) {
+		m_GlitchCount++;
+	}
+
+	ReleaseSRWLockExclusive(&m_GlitchLock);
+}
+
+UINT StreamStatistics::GetGlitchEvents(DXAUDIO_GLITCH_EVENT* pEvents, UINT MaxEvents) {
+	UINT Count = 0;
+
+	AcquireSRWLockShared(&m_GlitchLock);
+
+	Count = MaxEvents < m_GlitchCount ? MaxEvents : m_GlitchCount;
+
+	//Start far enough back from the newest event to copy [Count] of them in order
+	for (UINT i = 0; i < Count; i++) {
+		pEvents[i] = m_Glitches[(m_GlitchIndex + GLITCH_HISTORY - Count + i) % GLITCH_HISTORY];
+	}
+
+	ReleaseSRWLockShared(&m_GlitchLock);
+
+	return Count;
+}
+
+VOID StreamStatistics::GetStatistics(DXAUDIO_STREAM_STATISTICS* pStatistics) const {
+	pStatistics->Wakeups = m_Wakeups.load(std::memory_order_relaxed);
+	pStatistics->CapturePackets = m_CapturePackets.load(std::memory_order_relaxed);
+	pStatistics->CatchUpWakeups = m_CatchUpWakeups.load(std::memory_order_relaxed);
+	pStatistics->CatchUpPackets = m_CatchUpPackets.load(std::memory_order_relaxed);
+	pStatistics->MaxPacketsPerWakeup = m_MaxPacketsPerWakeup.load(std::memory_order_relaxed);
+	pStatistics->Discontinuities = m_Discontinuities.load(std::memory_order_relaxed);
+	pStatistics->TimestampErrors = m_TimestampErrors.load(std::memory_order_relaxed);
+	pStatistics->RenderUnderruns = m_RenderUnderruns.load(std::memory_order_relaxed);
+	pStatistics->MissedDeadlines = m_MissedDeadlines.load(std::memory_order_relaxed);
+}
+
+VOID StreamStatistics::Reset() {
+	m_Wakeups.store(0, std::memory_order_relaxed);
+	m_CapturePackets.store(0, std::memory_order_relaxed);
+	m_CatchUpWakeups.store(0, std::memory_order_relaxed);
+	m_CatchUpPackets.store(0, std::memory_order_relaxed);
+	m_MaxPacketsPerWakeup.store(0, std::memory_order_relaxed);
+	m_Discontinuities.store(0, std::memory_order_relaxed);
+	m_TimestampErrors.store(0, std::memory_order_relaxed);
+	m_RenderUnderruns.store(0, std::memory_order_relaxed);
+	m_MissedDeadlines.store(0, std::memory_order_relaxed);
+
+	AcquireSRWLockExclusive(&m_GlitchLock);
+	m_GlitchCount = 0;
+	m_GlitchIndex = 0;
+	ReleaseSRWLockExclusive(&m_GlitchLock);
+}
\ No newline at end of file
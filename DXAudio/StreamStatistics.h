@@ -0,0 +1,75 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <atomic>
+
+#define GLITCH_HISTORY 64 //Number of recent glitch events kept for GetGlitchEvents()
+
+/* StreamStatistics holds the counters reported by IDXAudioStream::GetStatistics().  The stream
+** thread updates them and any thread may read or reset them; every counter is an independent
+** relaxed atomic, so a snapshot is not guaranteed to be consistent across counters.  It also keeps
+** a short history of glitch events, which is guarded by a lock since glitches are rare. */
+class StreamStatistics {
+public:
+	StreamStatistics();
+
+	/* Called by the stream thread each time it wakes up to process the endpoint(s). */
+	VOID OnWakeup() {
+		m_Wakeups.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/* Called by the client reader after it drains the capture endpoint.  [Packets] is the number of
+	** packets that were waiting - anything over one means the thread woke up late and caught up. */
+	VOID OnCaptureWakeup(UINT Packets);
+
+	/* Called by the stream thread when a glitch is detected - counts it and adds it to the history. */
+	VOID OnGlitch(const DXAUDIO_GLITCH_EVENT& Event);
+
+	/* Copies up to [MaxEvents] of the most recent glitch events into [pEvents], oldest first, and returns the number copied. */
+	UINT GetGlitchEvents(DXAUDIO_GLITCH_EVENT* pEvents, UINT MaxEvents);
+
+	/* Copies the current counter values into [pStatistics]. */
+	VOID GetStatistics(DXAUDIO_STREAM_STATISTICS* pStatistics) const;
+
+	/* Sets every counter back to zero and clears the glitch history. */
+	VOID Reset();
+
+private:
+	std::atomic<UINT64> m_Wakeups; //Number of times the thread woke up to process
+	std::atomic<UINT64> m_CapturePackets; //Number of capture packets read
+	std::atomic<UINT64> m_CatchUpWakeups; //Number of wakeups that found more than one capture packet waiting
+	std::atomic<UINT64> m_CatchUpPackets; //Number of capture packets read beyond the first, summed over all wakeups
+	std::atomic<UINT> m_MaxPacketsPerWakeup; //Most capture packets read in a single wakeup
+	std::atomic<UINT64> m_Discontinuities; //Number of capture packets flagged with a data discontinuity
+	std::atomic<UINT64> m_TimestampErrors; //Number of capture packets flagged with a timestamp error
+	std::atomic<UINT64> m_RenderUnderruns; //Number of times the render endpoint ran dry
+	std::atomic<UINT64> m_MissedDeadlines; //Number of late wakeups that didn't cause an underrun
+
+	DXAUDIO_GLITCH_EVENT m_Glitches[GLITCH_HISTORY]; //Ring of recent glitch events
+	UINT m_GlitchCount; //Number of events in m_Glitches
+	UINT m_GlitchIndex; //Where the next event goes in m_Glitches
+	SRWLOCK m_GlitchLock; //Guards the glitch history
+};
\ No newline at end of file
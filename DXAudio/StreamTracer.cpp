@@ -0,0 +1,272 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "StreamTracer.h"
+
+#ifdef DXAUDIO_TRACE
+
+#include <intrin.h>
+#include <stdio.h>
+#include <atomic>
+#include <new>
+
+#define TRACE_RING_RECORDS 16384 //Records per thread - must be a power of two
+#define TRACE_FLUSH_INTERVAL 100 //Milliseconds between flushes
+#define TRACE_WRITE_BUFFER 65536 //Bytes of JSON gathered before each write to the file
+
+/* A single span boundary */
+struct TraceRecord {
+	UINT64 Timestamp; //Cycle counter reading
+	UINT16 Span; //TRACE_SPAN value
+	UINT16 IsEnd; //Nonzero for the end of a span
+	UINT32 Reserved; //Pads the record to 16 bytes
+};
+
+/* A single-producer, single-consumer ring - the owning thread writes and the flusher reads */
+struct TraceRing {
+	TraceRecord Records[TRACE_RING_RECORDS];
+	std::atomic<UINT> WriteIndex; //Only advanced by the owning thread
+	std::atomic<UINT> ReadIndex; //Only advanced by the flusher
+	std::atomic<bool> IsRetired; //Set once the owning thread has unregistered
+	DWORD ThreadId; //The owning thread
+	TraceRing* Next; //The next ring in the flusher's list (guarded by s_RingLock)
+};
+
+static const char* const s_SpanNames[TRACE_SPAN_COUNT] = {
+	"Period",
+	"GetBuffer",
+	"Convert",
+	"Resample",
+	"OnProcess",
+	"ReleaseBuffer",
+	"Reinitialize"
+};
+
+static thread_local TraceRing* t_Ring = nullptr; //The calling thread's ring, if it registered
+
+static SRWLOCK s_RingLock = SRWLOCK_INIT; //Guards s_Rings
+static TraceRing* s_Rings = nullptr; //Every ring that hasn't been freed yet
+
+//Appends [Record] to the calling thread's ring, if it has one and there's room
+static FORCEINLINE VOID Record(TRACE_SPAN Span, UINT16 IsEnd) {
+	TraceRing* Ring = t_Ring;
+
+	if (Ring == nullptr) {
+		return;
+	}
+
+	const UINT Write = Ring->WriteIndex.load(std::memory_order_relaxed);
+
+	if (Write - Ring->ReadIndex.load(std::memory_order_acquire) >= TRACE_RING_RECORDS) {
+		return; //Full - drop the record rather than wait
+	}
+
+	TraceRecord& Slot = Ring->Records[Write & (TRACE_RING_RECORDS - 1)];
+	Slot.Timestamp = __rdtsc();
+	Slot.Span = UINT16(Span);
+	Slot.IsEnd = IsEnd;
+
+	Ring->WriteIndex.store(Write + 1, std::memory_order_release);
+}
+
+/* Drains the rings into the trace file until the process exits */
+class TraceFlusher {
+public:
+	TraceFlusher() :
+	m_File(INVALID_HANDLE_VALUE),
+	m_Length(0),
+	m_ProcessId(GetCurrentProcessId())
+	{
+		WCHAR Path[MAX_PATH];
+		LARGE_INTEGER Counter;
+
+		//Take the first reading of both clocks, to work out the cycle counter's rate from later on
+		QueryPerformanceFrequency(&m_CounterFrequency);
+		QueryPerformanceCounter(&Counter);
+		m_StartCounter = Counter.QuadPart;
+		m_StartCycles = __rdtsc();
+
+		if (GetEnvironmentVariableW(L"DXAUDIO_TRACE_FILE", Path, MAX_PATH) == 0) {
+			wcscpy_s(Path, L"DXAudioTrace.json");
+		}
+
+		m_File = CreateFileW(Path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (m_File == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		//The array format lets the closing bracket be left off, so the file is valid at every flush
+		Append("[\n", 2);
+		Flush();
+
+		HANDLE Thread = CreateThread(NULL, 0, StaticFlusherEntry, this, 0, NULL);
+
+		if (Thread != NULL) {
+			CloseHandle(Thread);
+		}
+	}
+
+private:
+	HANDLE m_File; //The trace file
+	char m_Buffer[TRACE_WRITE_BUFFER]; //JSON waiting to be written
+	UINT m_Length; //Bytes in m_Buffer
+	DWORD m_ProcessId; //Written as the pid of every event
+	LARGE_INTEGER m_CounterFrequency; //Ticks per second of the performance counter
+	LONGLONG m_StartCounter; //Performance counter reading at startup
+	UINT64 m_StartCycles; //Cycle counter reading at startup
+
+	static DWORD __stdcall StaticFlusherEntry(LPVOID Data) {
+		((TraceFlusher*)(Data))->FlusherEntry();
+		return 0;
+	}
+
+	VOID FlusherEntry() {
+		while (true) {
+			Sleep(TRACE_FLUSH_INTERVAL);
+			DrainRings();
+		}
+	}
+
+	VOID DrainRings() {
+		LARGE_INTEGER Counter;
+		TraceRing** Link = &s_Rings;
+
+		//Measure the cycle counter against the performance counter over everything since startup
+		QueryPerformanceCounter(&Counter);
+
+		const DOUBLE Seconds = DOUBLE(Counter.QuadPart - m_StartCounter) / DOUBLE(m_CounterFrequency.QuadPart);
+		const DOUBLE CyclesPerMicrosecond = Seconds > 0.0 ? DOUBLE(__rdtsc() - m_StartCycles) / (Seconds * 1000000.0) : 1.0;
+
+		AcquireSRWLockExclusive(&s_RingLock);
+
+		while (*Link != nullptr) {
+			TraceRing* Ring = *Link;
+			const bool IsRetired = Ring->IsRetired.load(std::memory_order_acquire);
+
+			DrainRing(Ring, CyclesPerMicrosecond);
+
+			//A retired ring won't get any more records, so it can go once it's empty
+			if (IsRetired) {
+				*Link = Ring->Next;
+				_aligned_free(Ring);
+			} else {
+				Link = &Ring->Next;
+			}
+		}
+
+		ReleaseSRWLockExclusive(&s_RingLock);
+
+		Flush();
+	}
+
+	VOID DrainRing(TraceRing* Ring, DOUBLE CyclesPerMicrosecond) {
+		const UINT Write = Ring->WriteIndex.load(std::memory_order_acquire);
+		UINT Read = Ring->ReadIndex.load(std::memory_order_relaxed);
+		char Line[160];
+
+		for (; Read != Write; Read++) {
+			const TraceRecord& Record = Ring->Records[Read & (TRACE_RING_RECORDS - 1)];
+			const DOUBLE Microseconds = DOUBLE(INT64(Record.Timestamp - m_StartCycles)) / CyclesPerMicrosecond;
+
+			const int Length = snprintf (
+				Line,
+				sizeof(Line),
+				"{\"name\":\"%s\",\"cat\":\"DXAudio\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu},\n",
+				Record.Span < TRACE_SPAN_COUNT ? s_SpanNames[Record.Span] : "Unknown",
+				Record.IsEnd ? 'E' : 'B',
+				Microseconds,
+				(unsigned long)(m_ProcessId),
+				(unsigned long)(Ring->ThreadId)
+			);
+
+			if (Length > 0 && Length < (int)(sizeof(Line))) {
+				Append(Line, UINT(Length));
+			}
+		}
+
+		Ring->ReadIndex.store(Read, std::memory_order_release);
+	}
+
+	VOID Append(const char* Text, UINT Length) {
+		if (m_Length + Length > TRACE_WRITE_BUFFER) {
+			Flush();
+		}
+
+		memcpy(m_Buffer + m_Length, Text, Length);
+		m_Length += Length;
+	}
+
+	VOID Flush() {
+		DWORD Written = 0;
+
+		if (m_Length != 0) {
+			WriteFile(m_File, m_Buffer, m_Length, &Written, NULL);
+			m_Length = 0;
+		}
+	}
+};
+
+VOID StreamTracer::RegisterThread() {
+	static TraceFlusher* s_Flusher = new TraceFlusher(); //Thread-safe one-time initialization, never freed
+	(void)(s_Flusher);
+
+	if (t_Ring != nullptr) {
+		return;
+	}
+
+	TraceRing* Ring = (TraceRing*)(_aligned_malloc(sizeof(TraceRing), 64));
+
+	if (Ring == nullptr) {
+		return; //Tracing is best-effort
+	}
+
+	new (&Ring->WriteIndex) std::atomic<UINT>(0);
+	new (&Ring->ReadIndex) std::atomic<UINT>(0);
+	new (&Ring->IsRetired) std::atomic<bool>(false);
+	Ring->ThreadId = GetCurrentThreadId();
+
+	AcquireSRWLockExclusive(&s_RingLock);
+	Ring->Next = s_Rings;
+	s_Rings = Ring;
+	ReleaseSRWLockExclusive(&s_RingLock);
+
+	t_Ring = Ring;
+}
+
+VOID StreamTracer::UnregisterThread() {
+	if (t_Ring != nullptr) {
+		t_Ring->IsRetired.store(true, std::memory_order_release);
+		t_Ring = nullptr;
+	}
+}
+
+VOID StreamTracer::Begin(TRACE_SPAN Span) {
+	Record(Span, 0);
+}
+
+VOID StreamTracer::End(TRACE_SPAN Span) {
+	Record(Span, 1);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+
+/* TRACE_SPAN identifies a stage of the stream thread's work in a trace */
+enum TRACE_SPAN {
+	TRACE_SPAN_PERIOD = 0,     //One wakeup of the stream thread, from start to finish
+	TRACE_SPAN_GET_BUFFER,     //IAudioCaptureClient/IAudioRenderClient::GetBuffer()
+	TRACE_SPAN_CONVERT,        //Converting between the endpoint's sample format and floating point
+	TRACE_SPAN_RESAMPLE,       //libsamplerate's src_process()
+	TRACE_SPAN_CALLBACK,       //The application's OnProcess() method
+	TRACE_SPAN_RELEASE_BUFFER, //IAudioCaptureClient/IAudioRenderClient::ReleaseBuffer()
+	TRACE_SPAN_REINITIALIZE,   //Handling a device or property change
+	TRACE_SPAN_COUNT
+};
+
+/* StreamTracer records a timeline of the stream threads' work, for when a glitch needs explaining.  It is
+** compiled in only if DXAUDIO_TRACE is defined; otherwise every method is an empty inline function.
+**
+** Each registered thread gets its own lock-free ring of fixed-size records, stamped with the processor's
+** cycle counter, so that recording a span boundary costs a few nanoseconds and never blocks or allocates.
+** A background thread drains the rings every TRACE_FLUSH_INTERVAL milliseconds and appends them to a file
+** in the Chrome trace-event format, which chrome://tracing and Perfetto can open.  The file is named by the
+** DXAUDIO_TRACE_FILE environment variable, or DXAudioTrace.json in the working directory.  If a ring fills
+** up before it's drained, the newest records are dropped rather than stalling the stream. */
+class StreamTracer {
+public:
+#ifdef DXAUDIO_TRACE
+	/* Gives the calling thread a ring, starting the flusher if this is the first.  Spans recorded by
+	** threads that haven't registered are ignored, so that the hot path never allocates. */
+	static VOID RegisterThread();
+
+	/* Hands the calling thread's ring over to the flusher, which frees it once it has been drained */
+	static VOID UnregisterThread();
+
+	/* Records the start of [Span] on the calling thread */
+	static VOID Begin(TRACE_SPAN Span);
+
+	/* Records the end of [Span] on the calling thread */
+	static VOID End(TRACE_SPAN Span);
+#else
+	static VOID RegisterThread() { }
+	static VOID UnregisterThread() { }
+	static VOID Begin(TRACE_SPAN Span) { }
+	static VOID End(TRACE_SPAN Span) { }
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,209 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <ksmedia.h>
+
+#include "WaveFileReader.h"
+#include "ClientNegotiation.h"
+
+//Returns the 32-bit little-endian value at [p]
+static UINT32 ReadUInt32(const BYTE* p) {
+	return UINT32(p[0]) | (UINT32(p[1]) << 8) | (UINT32(p[2]) << 16) | (UINT32(p[3]) << 24);
+}
+
+WaveFileReader::WaveFileReader() :
+m_File(INVALID_HANDLE_VALUE),
+m_Mapping(NULL),
+m_View(nullptr),
+m_Data(nullptr),
+m_Frames(0)
+{
+	ZeroMemory(&m_Format, sizeof(m_Format));
+}
+
+WaveFileReader::~WaveFileReader() {
+	Close();
+}
+
+HRESULT WaveFileReader::Open(LPCWSTR FileName, const WAVEFORMATEXTENSIBLE* pRawFormat) {
+	LARGE_INTEGER Size;
+	HRESULT hr = S_OK;
+
+	Close();
+
+	m_File = CreateFileW (
+		FileName,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		NULL
+	);
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!GetFileSizeEx(m_File, &Size)) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	//An empty file can't be mapped, and has nothing to play anyway
+	if (Size.QuadPart == 0) {
+		Close();
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	}
+
+	m_Mapping = CreateFileMappingW(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (m_Mapping == NULL) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	m_View = (const BYTE*)(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_View == nullptr) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	if (pRawFormat != nullptr) {
+		m_Format = *pRawFormat;
+		m_Data = m_View;
+		m_Frames = UINT64(Size.QuadPart) / m_Format.Format.nBlockAlign;
+	} else {
+		hr = ParseHeader(UINT64(Size.QuadPart));
+	}
+
+	if (SUCCEEDED(hr) && (m_Frames == 0 || !IsSupportedFormat())) {
+		hr = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	}
+
+	if (FAILED(hr)) {
+		Close();
+		return hr;
+	}
+
+	return S_OK;
+}
+
+VOID WaveFileReader::Close() {
+	if (m_View != nullptr) {
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+	}
+
+	if (m_Mapping != NULL) {
+		CloseHandle(m_Mapping);
+		m_Mapping = NULL;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	m_Data = nullptr;
+	m_Frames = 0;
+}
+
+HRESULT WaveFileReader::ParseHeader(UINT64 Size) {
+	const BYTE* Format = nullptr;
+	UINT32 FormatBytes = 0;
+	UINT64 Offset = 12;
+
+	if (Size < 12 || memcmp(m_View, "RIFF", 4) != 0 || memcmp(m_View + 8, "WAVE", 4) != 0) {
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	}
+
+	//Walk the chunks until both the format and the data have turned up - chunks are padded to an even length
+	while (Offset + 8 <= Size && m_Data == nullptr) {
+		const BYTE* Chunk = m_View + Offset;
+		const UINT64 ChunkBytes = ReadUInt32(Chunk + 4);
+
+		if (memcmp(Chunk, "fmt ", 4) == 0) {
+			Format = Chunk + 8;
+			FormatBytes = ChunkBytes < Size - Offset - 8 ? UINT32(ChunkBytes) : UINT32(Size - Offset - 8);
+		} else if (memcmp(Chunk, "data", 4) == 0 && Format != nullptr) {
+			//A writer that was interrupted may have left the size too large, so the file's end wins
+			const UINT64 DataBytes = ChunkBytes < Size - Offset - 8 ? ChunkBytes : Size - Offset - 8;
+			const WORD BlockAlign = FormatBytes >= 16 ? ((const WAVEFORMATEX*)(Format))->nBlockAlign : 0;
+
+			m_Data = Chunk + 8;
+			m_Frames = BlockAlign != 0 ? DataBytes / BlockAlign : 0;
+		}
+
+		Offset += 8 + ChunkBytes + (ChunkBytes & 1);
+	}
+
+	if (Format == nullptr || m_Data == nullptr || FormatBytes < 16) {
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	}
+
+	const WAVEFORMATEX* pFormat = (const WAVEFORMATEX*)(Format);
+
+	//Everything is described as WAVEFORMATEXTENSIBLE from here on, as a mix format would be
+	if (pFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE && FormatBytes >= sizeof(WAVEFORMATEXTENSIBLE)) {
+		m_Format = *((const WAVEFORMATEXTENSIBLE*)(pFormat));
+	} else if (pFormat->wFormatTag == WAVE_FORMAT_PCM || pFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
+		BuildClientFormat (
+			&m_Format,
+			pFormat->nSamplesPerSec,
+			pFormat->nChannels,
+			pFormat->nChannels == 2 ? KSAUDIO_SPEAKER_STEREO : 0, //No particular layout otherwise
+			pFormat->wBitsPerSample,
+			pFormat->wBitsPerSample,
+			pFormat->wFormatTag == WAVE_FORMAT_IEEE_FLOAT
+		);
+	} else {
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	}
+
+	return S_OK;
+}
+
+bool WaveFileReader::IsSupportedFormat() {
+	const WAVEFORMATEX& Format = m_Format.Format;
+
+	if (Format.nChannels < 2 || Format.nSamplesPerSec == 0 || Format.nBlockAlign != Format.nChannels * Format.wBitsPerSample / 8) {
+		return false;
+	}
+
+	if (m_Format.SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
+		return Format.wBitsPerSample == 32;
+	}
+
+	//16-bit samples must fill their container, while 24-bit samples may be packed or sit in 32 bits
+	return m_Format.SubFormat == KSDATAFORMAT_SUBTYPE_PCM && (
+		(Format.wBitsPerSample == 16 && m_Format.Samples.wValidBitsPerSample == 16) ||
+		Format.wBitsPerSample == 24 ||
+		Format.wBitsPerSample == 32
+	);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+#include <Audioclient.h>
+
+/* WaveFileReader maps a RIFF WAV file, or a file of headerless samples, into memory for reading.  PCM samples of 16,
+** 24 or 32 bits (24-bit samples packed in three bytes or in a 32-bit container) and 32-bit floating-point samples
+** are accepted, in two or more channels.  The operating system pages the data in as it's read. */
+class WaveFileReader {
+public:
+	WaveFileReader();
+
+	~WaveFileReader();
+
+	/* Maps [FileName].  If [pRawFormat] is NULL, the file must be a WAV file and its header gives the format;
+	** otherwise the whole file is samples in [pRawFormat]. */
+	HRESULT Open(LPCWSTR FileName, const WAVEFORMATEXTENSIBLE* pRawFormat);
+
+	/* Unmaps and closes the file. */
+	VOID Close();
+
+	/* Returns true between a successful Open() and Close(). */
+	bool IsOpen() {
+		return m_View != nullptr;
+	}
+
+	/* Returns the format of the samples, always as a WAVEFORMATEXTENSIBLE. */
+	const WAVEFORMATEXTENSIBLE& GetFormat() {
+		return m_Format;
+	}
+
+	/* Returns the first sample frame. */
+	const BYTE* GetData() {
+		return m_Data;
+	}
+
+	/* Returns the number of whole frames in the file. */
+	UINT64 GetFrames() {
+		return m_Frames;
+	}
+
+private:
+	HANDLE m_File; //The file, or INVALID_HANDLE_VALUE if closed
+	HANDLE m_Mapping; //The file mapping object
+	const BYTE* m_View; //The mapped view of the whole file
+	const BYTE* m_Data; //The first sample frame in m_View
+	UINT64 m_Frames; //Frames in the file
+	WAVEFORMATEXTENSIBLE m_Format; //Format of the samples
+
+	/* Finds the format and data chunks of the mapped WAV file, which is [Size] bytes long */
+	HRESULT ParseHeader(UINT64 Size);
+
+	/* Returns true if m_Format describes samples the client reader and writer can convert */
+	bool IsSupportedFormat();
+};
\ No newline at end of file
@@ -0,0 +1,307 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include <Windows.h>
+#include <malloc.h>
+
+#include "WaveFileWriter.h"
+
+#define WAVE_WRITE_BUFFER 262144 //Bytes gathered in each buffer before it's written to the file
+
+WaveFileWriter::WaveFileWriter() :
+m_File(INVALID_HANDLE_VALUE),
+m_Current(0),
+m_BufferLength(0),
+m_DataBytes(0),
+m_DataOffset(0),
+m_IsRaw(false),
+m_Thread(NULL),
+m_WorkEvent(NULL),
+m_IdleEvent(NULL),
+m_Pending(nullptr),
+m_PendingLength(0),
+m_PendingOffset(0),
+m_WriteResult(S_OK)
+{
+	m_Buffers[0] = nullptr;
+	m_Buffers[1] = nullptr;
+}
+
+WaveFileWriter::~WaveFileWriter() {
+	Close();
+}
+
+HRESULT WaveFileWriter::Open(LPCWSTR FileName, const WAVEFORMATEX* pFormat, bool IsRaw) {
+	const UINT32 FormatBytes = sizeof(WAVEFORMATEX) + (pFormat->wFormatTag == WAVE_FORMAT_PCM ? 0 : pFormat->cbSize);
+	BYTE Header[12 + 8 + sizeof(WAVEFORMATEXTENSIBLE) + 8];
+	UINT32 Length = 0;
+	HRESULT hr = S_OK;
+
+	Close();
+
+	if (FormatBytes > sizeof(WAVEFORMATEXTENSIBLE)) {
+		return E_INVALIDARG;
+	}
+
+	for (UINT i = 0; i < 2; i++) {
+		m_Buffers[i] = (BYTE*)(_aligned_malloc(WAVE_WRITE_BUFFER, 64));
+
+		if (m_Buffers[i] == nullptr) {
+			Close();
+			return E_OUTOFMEMORY;
+		}
+	}
+
+	m_WorkEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+	m_IdleEvent = CreateEventW(NULL, TRUE, TRUE, NULL);
+
+	if (m_WorkEvent == NULL || m_IdleEvent == NULL) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	m_File = CreateFileW (
+		FileName,
+		GENERIC_WRITE,
+		FILE_SHARE_READ,
+		NULL,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		NULL
+	);
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	m_IsRaw = IsRaw;
+	m_Current = 0;
+	m_BufferLength = 0;
+	m_DataBytes = 0;
+	m_WriteResult = S_OK;
+
+	if (!m_IsRaw) {
+		//RIFF header - the sizes are filled in by Flush()
+		CopyMemory(Header + Length, "RIFF\0\0\0\0WAVE", 12);
+		Length += 12;
+
+		//Format chunk - the WAVEFORMATEX as it is, without cbSize for plain PCM
+		CopyMemory(Header + Length, "fmt ", 4);
+		*((UINT32*)(Header + Length + 4)) = FormatBytes;
+		CopyMemory(Header + Length + 8, pFormat, FormatBytes);
+		Length += 8 + FormatBytes;
+
+		//Data chunk header
+		CopyMemory(Header + Length, "data\0\0\0\0", 8);
+		Length += 8;
+
+		hr = WriteAt(0, Header, Length);
+
+		if (FAILED(hr)) {
+			Close();
+			return hr;
+		}
+	}
+
+	m_DataOffset = Length;
+
+	m_Thread = CreateThread (
+		NULL,
+		0,
+		StaticWriterThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	if (m_Thread == NULL) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	return S_OK;
+}
+
+HRESULT WaveFileWriter::Write(const BYTE* pData, UINT32 Bytes) {
+	HRESULT hr = S_OK;
+
+	while (Bytes != 0) {
+		const UINT32 Space = WAVE_WRITE_BUFFER - m_BufferLength;
+		const UINT32 Chunk = Bytes < Space ? Bytes : Space;
+
+		CopyMemory(m_Buffers[m_Current] + m_BufferLength, pData, Chunk);
+		m_BufferLength += Chunk;
+		pData += Chunk;
+		Bytes -= Chunk;
+
+		if (m_BufferLength == WAVE_WRITE_BUFFER) {
+			hr = SubmitBuffer();
+
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT WaveFileWriter::Flush() {
+	HRESULT hr = S_OK;
+	UINT32 Size = 0;
+
+	if (!IsOpen()) {
+		return S_FALSE;
+	}
+
+	if (m_BufferLength != 0) {
+		hr = SubmitBuffer();
+
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	hr = WaitForWriter();
+
+	if (FAILED(hr) || m_IsRaw) {
+		return hr;
+	}
+
+	//The sizes are 32-bit, so a file over 4GB is still playable up to that point
+	Size = m_DataOffset + m_DataBytes - 8 > 0xFFFFFFFF ? 0xFFFFFFFF : UINT32(m_DataOffset + m_DataBytes - 8);
+	hr = WriteAt(4, &Size, sizeof(Size));
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	Size = m_DataBytes > 0xFFFFFFFF ? 0xFFFFFFFF : UINT32(m_DataBytes);
+
+	return WriteAt(m_DataOffset - 4, &Size, sizeof(Size));
+}
+
+VOID WaveFileWriter::Close() {
+	if (m_Thread != NULL) {
+		Flush();
+
+		//A NULL buffer tells the writer thread to exit
+		m_Pending = nullptr;
+		SetEvent(m_WorkEvent);
+		WaitForSingleObject(m_Thread, INFINITE);
+		CloseHandle(m_Thread);
+		m_Thread = NULL;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	if (m_WorkEvent != NULL) {
+		CloseHandle(m_WorkEvent);
+		m_WorkEvent = NULL;
+	}
+
+	if (m_IdleEvent != NULL) {
+		CloseHandle(m_IdleEvent);
+		m_IdleEvent = NULL;
+	}
+
+	for (UINT i = 0; i < 2; i++) {
+		if (m_Buffers[i] != nullptr) {
+			_aligned_free(m_Buffers[i]);
+			m_Buffers[i] = nullptr;
+		}
+	}
+
+	m_BufferLength = 0;
+	m_DataBytes = 0;
+}
+
+DWORD __stdcall WaveFileWriter::StaticWriterThreadEntry(LPVOID Data) {
+	((WaveFileWriter*)(Data))->WriterThreadEntry();
+	return 0;
+}
+
+VOID WaveFileWriter::WriterThreadEntry() {
+	//The events order every access to the m_Pending fields between the two threads
+	while (WaitForSingleObject(m_WorkEvent, INFINITE) == WAIT_OBJECT_0 && m_Pending != nullptr) {
+		m_WriteResult = WriteAt(m_PendingOffset, m_Pending, m_PendingLength);
+		SetEvent(m_IdleEvent);
+	}
+}
+
+HRESULT WaveFileWriter::SubmitBuffer() {
+	HRESULT hr = WaitForWriter();
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	m_Pending = m_Buffers[m_Current];
+	m_PendingLength = m_BufferLength;
+	m_PendingOffset = m_DataOffset + m_DataBytes;
+
+	ResetEvent(m_IdleEvent);
+	SetEvent(m_WorkEvent);
+
+	//Carry on in the other buffer, which the writer thread is done with
+	m_DataBytes += m_BufferLength;
+	m_BufferLength = 0;
+	m_Current ^= 1;
+
+	return S_OK;
+}
+
+HRESULT WaveFileWriter::WaitForWriter() {
+	WaitForSingleObject(m_IdleEvent, INFINITE);
+
+	return m_WriteResult;
+}
+
+HRESULT WaveFileWriter::WriteAt(UINT64 Offset, const VOID* pData, UINT32 Bytes) {
+	LARGE_INTEGER Position;
+	DWORD Written = 0;
+
+	Position.QuadPart = LONGLONG(Offset);
+
+	if (!SetFilePointerEx(m_File, Position, NULL, FILE_BEGIN)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!WriteFile(m_File, pData, Bytes, &Written, NULL)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	//A short write means the disk is full
+	if (Written != Bytes) {
+		return HRESULT_FROM_WIN32(ERROR_DISK_FULL);
+	}
+
+	return S_OK;
+}
\ No newline at end of file
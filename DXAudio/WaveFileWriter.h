@@ -0,0 +1,86 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <comdef.h>
+
+/* WaveFileWriter writes a RIFF WAV file in any WAVEFORMATEX format, or the samples alone.  Data is gathered in one
+** of two buffers, and each buffer is written out by a thread of the writer's own once it's full, so that the caller
+** only waits on the disk if it gets a whole buffer ahead.  The header's sizes are patched at every Flush(), so the
+** file is complete whenever the writer is idle. */
+class WaveFileWriter {
+public:
+	WaveFileWriter();
+
+	~WaveFileWriter();
+
+	/* Creates (or overwrites) [FileName] and, unless [IsRaw] is true, writes a WAV header for [pFormat]. */
+	HRESULT Open(LPCWSTR FileName, const WAVEFORMATEX* pFormat, bool IsRaw);
+
+	/* Returns true between Open() and Close(). */
+	bool IsOpen() {
+		return m_File != INVALID_HANDLE_VALUE;
+	}
+
+	/* Appends [Bytes] bytes of sample data.  Fails if an earlier write to the file did. */
+	HRESULT Write(const BYTE* pData, UINT32 Bytes);
+
+	/* Writes out whatever is buffered, waits for it, and updates the sizes in the header. */
+	HRESULT Flush();
+
+	/* Flushes and closes the file. */
+	VOID Close();
+
+private:
+	HANDLE m_File; //The file, or INVALID_HANDLE_VALUE if closed
+	BYTE* m_Buffers[2]; //Sample data being gathered, and sample data being written
+	UINT m_Current; //Index of the buffer being gathered
+	UINT32 m_BufferLength; //Bytes in the buffer being gathered
+	UINT64 m_DataBytes; //Sample data handed to the writer thread so far (not counting the buffer being gathered)
+	UINT32 m_DataOffset; //Offset of the sample data in the file
+	bool m_IsRaw; //True if the file has no header
+
+	HANDLE m_Thread; //Writes full buffers to the file
+	HANDLE m_WorkEvent; //Set when a buffer is handed to the writer thread, or when it should exit
+	HANDLE m_IdleEvent; //Manual-reset, set while the writer thread has nothing to write
+	const BYTE* m_Pending; //The buffer handed to the writer thread, or NULL to exit
+	UINT32 m_PendingLength; //Bytes in m_Pending
+	UINT64 m_PendingOffset; //Where m_Pending goes in the file
+	HRESULT m_WriteResult; //Result of the writer thread's last write
+
+	/* The static writer thread entry point */
+	static DWORD __stdcall StaticWriterThreadEntry(LPVOID Data);
+
+	/* Writes each buffer handed over until told to exit */
+	VOID WriterThreadEntry();
+
+	/* Waits for the writer thread to finish with the other buffer, then hands it the current one */
+	HRESULT SubmitBuffer();
+
+	/* Waits for the writer thread to go idle, and returns the result of its last write */
+	HRESULT WaitForWriter();
+
+	/* Writes [Bytes] bytes at [Offset] in the file */
+	HRESULT WriteAt(UINT64 Offset, const VOID* pData, UINT32 Bytes);
+};
\ No newline at end of file
@@ -74,6 +74,9 @@ int main() {
 
 		DXAUDIO_STREAM_DESC Desc;
 
+		ZeroMemory(&Desc, sizeof(Desc));
+
+		Desc.Size = sizeof(Desc);
 		Desc.SampleRate = 22050.0f;
 		Desc.Type = Type;
 
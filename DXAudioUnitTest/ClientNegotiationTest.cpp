@@ -0,0 +1,380 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#include "UnitTest.hpp"
+#include "FakeAudioClient.hpp"
+#include "ClientNegotiation.h"
+
+//ChooseEnginePeriod
+
+TEST(ChooseEnginePeriodRoundsUpToFundamental) {
+	CHECK(ChooseEnginePeriod(480, 48, 96, 480) == 96);
+	CHECK(ChooseEnginePeriod(480, 128, 200, 480) == 256);
+	CHECK(ChooseEnginePeriod(441, 1, 147, 441) == 147);
+}
+
+TEST(ChooseEnginePeriodFallsBackToDefault) {
+	//No fundamental period, no minimum, or a minimum over the maximum - the driver only supports the default
+	CHECK(ChooseEnginePeriod(480, 0, 96, 480) == 480);
+	CHECK(ChooseEnginePeriod(480, 48, 0, 480) == 480);
+	CHECK(ChooseEnginePeriod(480, 48, 960, 480) == 480);
+
+	//Rounding up to the fundamental period goes past the maximum
+	CHECK(ChooseEnginePeriod(480, 128, 400, 450) == 480);
+}
+
+//InitializeLowLatencyClient
+
+TEST(LowLatencyUsesSmallestPeriod) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 PeriodFrames = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+
+	CHECK(InitializeLowLatencyClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, (WAVEFORMATEX*)(&Format), &PeriodFrames) == S_OK);
+	CHECK(PeriodFrames == 96);
+	CHECK(Device.Endpoint.EnginePeriod == 96);
+	CHECK(Device.Endpoint.StreamFlags == AUDCLNT_STREAMFLAGS_EVENTCALLBACK);
+	CHECK(Device.Endpoint.Activations == 1);
+}
+
+TEST(LowLatencySharesLockedPeriod) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 PeriodFrames = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	Device.Endpoint.LockedPeriod = 240;
+
+	//The first attempt is refused, and the second must be made on a new client at the locked period
+	CHECK(InitializeLowLatencyClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, (WAVEFORMATEX*)(&Format), &PeriodFrames) == S_OK);
+	CHECK(PeriodFrames == 240);
+	CHECK(Device.Endpoint.EnginePeriod == 240);
+	CHECK(Device.Endpoint.Activations == 2);
+	CHECK(Device.Endpoint.Reuses == 0);
+}
+
+TEST(LowLatencyNeedsClient3) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client;
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 PeriodFrames = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	Device.Endpoint.HasClient3 = false;
+	Client = Device.ActivateClient();
+
+	//Nothing was attempted, so the client is kept for the fallback
+	CHECK(InitializeLowLatencyClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, (WAVEFORMATEX*)(&Format), &PeriodFrames) == E_NOINTERFACE);
+	CHECK(Device.Endpoint.Activations == 1);
+	CHECK(Client->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 100000, 0, (WAVEFORMATEX*)(&Format), NULL) == S_OK);
+	CHECK(Device.Endpoint.Reuses == 0);
+}
+
+TEST(LowLatencyFailureLeavesFreshClient) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 PeriodFrames = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	Device.Endpoint.SharedStreamResult = AUDCLNT_E_UNSUPPORTED_FORMAT;
+
+	//The fallback to IAudioClient::Initialize() must not reuse the client that just failed
+	CHECK(InitializeLowLatencyClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, (WAVEFORMATEX*)(&Format), &PeriodFrames) == AUDCLNT_E_UNSUPPORTED_FORMAT);
+	CHECK(Client != nullptr);
+	CHECK(Device.Endpoint.Activations == 2);
+	CHECK(Client->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 100000, 0, (WAVEFORMATEX*)(&Format), NULL) == S_OK);
+	CHECK(Device.Endpoint.Reuses == 0);
+}
+
+TEST(LowLatencyInvalidatedKeepsClient) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 PeriodFrames = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	Device.Endpoint.SharedStreamResult = AUDCLNT_E_DEVICE_INVALIDATED;
+
+	//The device is gone, so there's no point in activating another client on it
+	CHECK(InitializeLowLatencyClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, (WAVEFORMATEX*)(&Format), &PeriodFrames) == AUDCLNT_E_DEVICE_INVALIDATED);
+	CHECK(Device.Endpoint.Activations == 1);
+}
+
+//ListExclusiveRates
+
+//GetClientMixFormat
+
+TEST(MixFormatKeepsExtensibleFormat) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE MixFormat;
+	WAVEFORMATEXTENSIBLE* pFormat = nullptr;
+
+	FakeEndpoint::GetMixFormat(&MixFormat);
+
+	CHECK(GetClientMixFormat(Client, &pFormat) == S_OK);
+	CHECK(memcmp(pFormat, &MixFormat, sizeof(MixFormat)) == 0);
+
+	CoTaskMemFree(pFormat);
+}
+
+TEST(MixFormatWidensPlainFormat) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client;
+	WAVEFORMATEXTENSIBLE* pFormat = nullptr;
+	WAVEFORMATEXTENSIBLE ClientFormat;
+
+	Device.Endpoint.IsPlainMixFormat = true;
+	Client = Device.ActivateClient();
+
+	//The tag stays as the client gave it, but the extensible fields can be read, and a client format stored over it
+	CHECK(GetClientMixFormat(Client, &pFormat) == S_OK);
+	CHECK(pFormat->Format.wFormatTag == WAVE_FORMAT_IEEE_FLOAT);
+	CHECK(pFormat->Format.cbSize == 0);
+	CHECK(pFormat->Format.nSamplesPerSec == 48000);
+	CHECK(pFormat->Samples.wValidBitsPerSample == 32);
+	CHECK(pFormat->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT);
+
+	BuildClientFormat(&ClientFormat, 44100, 2, KSAUDIO_SPEAKER_STEREO, 16, 16, false);
+	*pFormat = ClientFormat;
+	CHECK(memcmp(pFormat, &ClientFormat, sizeof(ClientFormat)) == 0);
+
+	CoTaskMemFree(pFormat);
+}
+
+TEST(ExclusiveRatesClosestFirst) {
+	DWORD Rates[12];
+	const UINT Count = ListExclusiveRates(44100.0f, 48000, Rates, ARRAYSIZE(Rates));
+
+	//Every standard rate once, the application's own rate first
+	CHECK(Count == 9);
+	CHECK(Rates[0] == 44100);
+	CHECK(Rates[1] == 48000);
+	CHECK(Rates[2] == 32000);
+	CHECK(Rates[3] == 22050);
+	CHECK(Rates[Count - 1] == 192000);
+}
+
+TEST(ExclusiveRatesPreferHigherOnTie) {
+	DWORD Rates[12];
+	const UINT Count = ListExclusiveRates(46050.0f, 44100, Rates, ARRAYSIZE(Rates));
+
+	CHECK(Count == 10);
+	CHECK(Rates[0] == 46050);
+	CHECK(Rates[1] == 48000);
+	CHECK(Rates[2] == 44100);
+}
+
+TEST(ExclusiveRatesStopAtMax) {
+	DWORD Rates[2];
+
+	CHECK(ListExclusiveRates(48000.0f, 48000, Rates, ARRAYSIZE(Rates)) == 2);
+	CHECK(Rates[0] == 48000);
+	CHECK(Rates[1] == 44100);
+}
+
+//ChooseExclusiveFormat
+
+TEST(ExclusiveFormatTakesFirstAccepted) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE MixFormat;
+	WAVEFORMATEXTENSIBLE Format;
+
+	FakeEndpoint::GetMixFormat(&MixFormat);
+	BuildClientFormat(&Device.Endpoint.ExclusiveFormat, 48000, 2, KSAUDIO_SPEAKER_STEREO, 32, 24, false);
+
+	//44.1kHz comes first but is refused, so 24 bits in 32 at the next closest rate is the first match
+	CHECK(ChooseExclusiveFormat(Client, 44100.0f, &MixFormat, &Format) == S_OK);
+	CHECK(Format.Format.nSamplesPerSec == 48000);
+	CHECK(Format.Format.wBitsPerSample == 32);
+	CHECK(Format.Samples.wValidBitsPerSample == 24);
+	CHECK(Format.SubFormat == KSDATAFORMAT_SUBTYPE_PCM);
+}
+
+TEST(ExclusiveFormatNoneAccepted) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE MixFormat;
+	WAVEFORMATEXTENSIBLE Format;
+
+	FakeEndpoint::GetMixFormat(&MixFormat);
+
+	CHECK(ChooseExclusiveFormat(Client, 44100.0f, &MixFormat, &Format) == AUDCLNT_E_UNSUPPORTED_FORMAT);
+}
+
+//InitializeExclusiveClient
+
+TEST(ExclusiveUsesDevicePeriod) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	BuildClientFormat(&Device.Endpoint.ExclusiveFormat, 48000, 2, KSAUDIO_SPEAKER_STEREO, 32, 32, true);
+
+	CHECK(InitializeExclusiveClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 1, 48000.0f, &Format, &Period) == S_OK);
+	CHECK(Period == 30000);
+	CHECK(Device.Endpoint.ShareMode == AUDCLNT_SHAREMODE_EXCLUSIVE);
+	CHECK(Device.Endpoint.BufferDuration == 30000);
+	CHECK(Device.Endpoint.Periodicity == 30000);
+	CHECK(memcmp(&Format, &Device.Endpoint.ExclusiveFormat, sizeof(Format)) == 0);
+}
+
+TEST(ExclusiveRefusedLeavesFreshClient) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE MixFormat;
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+
+	FakeEndpoint::GetMixFormat(&MixFormat);
+	Format = MixFormat;
+	BuildClientFormat(&Device.Endpoint.ExclusiveFormat, 48000, 2, KSAUDIO_SPEAKER_STEREO, 32, 32, true);
+	Device.Endpoint.ExclusiveResult = AUDCLNT_E_DEVICE_IN_USE;
+
+	//Another application holds the device, so the stream falls back to shared mode on a new client
+	CHECK(InitializeExclusiveClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 1, 48000.0f, &Format, &Period) == AUDCLNT_E_DEVICE_IN_USE);
+	CHECK(memcmp(&Format, &MixFormat, sizeof(Format)) == 0);
+	CHECK(Device.Endpoint.Activations == 2);
+	CHECK(Client->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 100000, 0, (WAVEFORMATEX*)(&MixFormat), NULL) == S_OK);
+	CHECK(Device.Endpoint.Reuses == 0);
+}
+
+TEST(ExclusiveNoFormatKeepsClient) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+
+	//Nothing was initialized, so there's no need for a new client
+	CHECK(InitializeExclusiveClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 1, 48000.0f, &Format, &Period) == AUDCLNT_E_UNSUPPORTED_FORMAT);
+	CHECK(Device.Endpoint.Activations == 1);
+	CHECK(Device.Endpoint.Initializations == 0);
+}
+
+TEST(ExclusiveRetriesAlignedBuffer) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	BuildClientFormat(&Device.Endpoint.ExclusiveFormat, 48000, 2, KSAUDIO_SPEAKER_STEREO, 32, 32, true);
+	Device.Endpoint.AlignedBufferFrames = 160;
+
+	//3ms is 144 frames, which the device rounds up to 160 - the second attempt is made on a new client
+	CHECK(InitializeExclusiveClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 1, 48000.0f, &Format, &Period) == S_OK);
+	CHECK(Period == 33333);
+	CHECK(Device.Endpoint.BufferDuration == 33333);
+	CHECK(Device.Endpoint.Activations == 2);
+	CHECK(Device.Endpoint.Reuses == 0);
+}
+
+//InitializeEngineConversionClient
+
+TEST(EngineConversionAsksForStreamFormat) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+
+	FakeEndpoint::GetMixFormat(&Format);
+
+	//Stereo floats at the stream's rate, converted by the engine at its default quality
+	CHECK(InitializeEngineConversionClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 100000, 0, 22050.25f, &Format) == S_OK);
+	CHECK(Device.Endpoint.StreamFlags == (AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY));
+	CHECK(Device.Endpoint.ShareMode == AUDCLNT_SHAREMODE_SHARED);
+	CHECK(Device.Endpoint.BufferDuration == 100000);
+	CHECK(Format.Format.nSamplesPerSec == 22050);
+	CHECK(Format.Format.nChannels == 2);
+	CHECK(Format.Format.wBitsPerSample == 32);
+	CHECK(Format.SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT);
+	CHECK(memcmp(&Format, &Device.Endpoint.Format, sizeof(Format)) == 0);
+}
+
+TEST(EngineConversionFailureLeavesFreshClient) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	WAVEFORMATEXTENSIBLE Format;
+
+	FakeEndpoint::GetMixFormat(&Format);
+	Device.Endpoint.SharedResult = AUDCLNT_E_UNSUPPORTED_FORMAT;
+
+	CHECK(InitializeEngineConversionClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 100000, 0, 22050.0f, &Format) == AUDCLNT_E_UNSUPPORTED_FORMAT);
+	CHECK(Format.Format.nSamplesPerSec == 48000);
+	CHECK(Device.Endpoint.Activations == 2);
+}
+
+//ChooseRenderFrames
+
+TEST(SharedRenderFillsFreeSpace) {
+	UINT32 DataFrames = 0;
+
+	CHECK(ChooseRenderFrames(false, 480, 300, 500, &DataFrames) == 180);
+	CHECK(DataFrames == 180);
+	CHECK(ChooseRenderFrames(false, 480, 300, 100, &DataFrames) == 100);
+	CHECK(DataFrames == 100);
+	CHECK(ChooseRenderFrames(false, 480, 480, 100, &DataFrames) == 0);
+	CHECK(DataFrames == 0);
+}
+
+TEST(ExclusiveEventRenderLocksWholeBuffer) {
+	CFakeAudioDevice Device;
+	CComPtr<IAudioClient> Client = Device.ActivateClient();
+	CComPtr<IAudioRenderClient> RenderClient;
+	WAVEFORMATEXTENSIBLE Format;
+	REFERENCE_TIME Period = 0;
+	UINT32 BufferFrames = 0;
+	UINT32 DataFrames = 0;
+	BYTE* Buffer = nullptr;
+	const UINT32 Available[] = { 0, 100, 144, 400 };
+
+	FakeEndpoint::GetMixFormat(&Format);
+	BuildClientFormat(&Device.Endpoint.ExclusiveFormat, 48000, 2, KSAUDIO_SPEAKER_STEREO, 32, 32, true);
+
+	CHECK(InitializeExclusiveClient(&Device, Client, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, 1, 48000.0f, &Format, &Period) == S_OK);
+	CHECK(Client->GetBufferSize(&BufferFrames) == S_OK);
+	CHECK(BufferFrames == 144);
+	CHECK(Client->GetService(IID_PPV_ARGS(&RenderClient)) == S_OK);
+
+	//The endpoint only takes its whole buffer, whatever the padding would say
+	CHECK(RenderClient->GetBuffer(100, &Buffer) == AUDCLNT_E_BUFFER_SIZE_ERROR);
+
+	//Short of data, the whole buffer is still locked, and the rest is left to be rendered as silence
+	for (UINT32 Frames : Available) {
+		CHECK(ChooseRenderFrames(true, BufferFrames, 100, Frames, &DataFrames) == BufferFrames);
+		CHECK(DataFrames == (Frames < BufferFrames ? Frames : BufferFrames));
+		CHECK(RenderClient->GetBuffer(BufferFrames, &Buffer) == S_OK);
+		CHECK(RenderClient->ReleaseBuffer(BufferFrames, DataFrames != 0 ? 0 : AUDCLNT_BUFFERFLAGS_SILENT) == S_OK);
+	}
+
+	CHECK(Device.Endpoint.RefusedBuffers == 1);
+	CHECK(Device.Endpoint.RenderedFrames == BufferFrames * 4);
+}
\ No newline at end of file
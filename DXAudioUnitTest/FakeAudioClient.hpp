@@ -0,0 +1,475 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "QueryInterface.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <Audioclient.h>
+#include <ksmedia.h>
+#include <math.h>
+#include <vector>
+
+/* FakeEndpoint scripts how the clients of a CFakeAudioDevice behave, and records what they were asked to do.  A
+** test fills in the behavior, hands the device to the code under test, then checks the record. */
+struct FakeEndpoint {
+	//Behavior
+
+	bool HasClient3; //Clients answer QueryInterface() for IAudioClient3
+	UINT32 DefaultPeriod; //Engine periods reported by GetSharedModeEnginePeriod(), in frames
+	UINT32 FundamentalPeriod;
+	UINT32 MinPeriod;
+	UINT32 MaxPeriod;
+	UINT32 LockedPeriod; //If nonzero, another stream holds the engine at this period, and InitializeSharedAudioStream() refuses any other
+	HRESULT SharedStreamResult; //If it's a failure, InitializeSharedAudioStream() always fails with it
+	HRESULT SharedResult; //If it's a failure, shared-mode Initialize() always fails with it
+	HRESULT ExclusiveResult; //If it's a failure, exclusive-mode Initialize() always fails with it
+	WAVEFORMATEXTENSIBLE ExclusiveFormat; //The one format IsFormatSupported() accepts in exclusive mode (none if zeroed)
+	REFERENCE_TIME DevicePeriod; //The minimum device period reported by GetDevicePeriod()
+	UINT32 AlignedBufferFrames; //If nonzero, exclusive-mode Initialize() fails with AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED for any other buffer size
+	bool IsPlainMixFormat; //GetMixFormat() returns the mix format as a plain WAVEFORMATEX, allocated no larger than that
+
+	//Record
+
+	UINT Activations; //Clients created by Activate()
+	UINT Reuses; //Initialization attempts on a client that had already been initialized, or had failed to be
+	UINT Initializations; //Clients initialized successfully
+	AUDCLNT_SHAREMODE ShareMode; //The rest describe the last successful initialization
+	DWORD StreamFlags;
+	REFERENCE_TIME BufferDuration;
+	REFERENCE_TIME Periodicity;
+	UINT32 EnginePeriod; //Only set by InitializeSharedAudioStream()
+	WAVEFORMATEXTENSIBLE Format;
+	UINT32 RenderedFrames; //Frames released by render clients
+	UINT RefusedBuffers; //GetBuffer() calls a render client refused with AUDCLNT_E_BUFFER_SIZE_ERROR
+
+	/* Starts out as an endpoint with a 48kHz stereo float mix format that supports IAudioClient3, doesn't allow
+	** exclusive mode, and never fails */
+	FakeEndpoint() {
+		ZeroMemory(this, sizeof(FakeEndpoint));
+
+		HasClient3 = true;
+		DefaultPeriod = 480;
+		FundamentalPeriod = 48;
+		MinPeriod = 96;
+		MaxPeriod = 480;
+		DevicePeriod = 30000;
+	}
+
+	/* Fills [pFormat] with the mix format, 48kHz stereo floats */
+	static VOID GetMixFormat(WAVEFORMATEXTENSIBLE* pFormat) {
+		ZeroMemory(pFormat, sizeof(WAVEFORMATEXTENSIBLE));
+
+		pFormat->Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+		pFormat->Format.nChannels = 2;
+		pFormat->Format.nSamplesPerSec = 48000;
+		pFormat->Format.wBitsPerSample = 32;
+		pFormat->Format.nBlockAlign = 8;
+		pFormat->Format.nAvgBytesPerSec = 48000 * 8;
+		pFormat->Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+		pFormat->Samples.wValidBitsPerSample = 32;
+		pFormat->dwChannelMask = KSAUDIO_SPEAKER_STEREO;
+		pFormat->SubFormat = KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+	}
+};
+
+/* CFakeRenderClient is the render client an exclusive-mode CFakeAudioClient hands out.  Like a real one, it only
+** locks its whole buffer at a time if the client is event-driven, and refuses anything else with
+** AUDCLNT_E_BUFFER_SIZE_ERROR - otherwise it locks up to the whole buffer.  There's no playback, so the buffer
+** never holds anything. */
+class CFakeRenderClient : public IAudioRenderClient {
+public:
+	CFakeRenderClient(FakeEndpoint& Endpoint, UINT32 BufferFrames, UINT32 BlockAlign, bool IsEventDriven) :
+	m_RefCount(1),
+	m_Endpoint(Endpoint),
+	m_Buffer(BufferFrames * BlockAlign),
+	m_BufferFrames(BufferFrames),
+	m_IsEventDriven(IsEventDriven),
+	m_LockedFrames(0)
+	{ }
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IAudioRenderClient);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() final {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() final {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IAudioRenderClient methods
+
+	STDMETHODIMP GetBuffer(UINT32 NumFramesRequested, BYTE** ppData) final {
+		if (m_LockedFrames != 0) {
+			return AUDCLNT_E_OUT_OF_ORDER;
+		} else if (NumFramesRequested > m_BufferFrames) {
+			return AUDCLNT_E_BUFFER_TOO_LARGE;
+		} else if (m_IsEventDriven && NumFramesRequested != m_BufferFrames) {
+			m_Endpoint.RefusedBuffers++;
+			return AUDCLNT_E_BUFFER_SIZE_ERROR;
+		}
+
+		m_LockedFrames = NumFramesRequested;
+		*ppData = m_Buffer.data();
+
+		return S_OK;
+	}
+
+	STDMETHODIMP ReleaseBuffer(UINT32 NumFramesWritten, DWORD dwFlags) final {
+		if (NumFramesWritten > m_LockedFrames) {
+			return AUDCLNT_E_INVALID_SIZE;
+		}
+
+		m_Endpoint.RenderedFrames += NumFramesWritten;
+		m_LockedFrames = 0;
+
+		return S_OK;
+	}
+
+private:
+	long m_RefCount; //Reference counter
+	FakeEndpoint& m_Endpoint; //The record to keep
+	std::vector<BYTE> m_Buffer; //The endpoint buffer, m_BufferFrames long
+	UINT32 m_BufferFrames; //Size of the endpoint buffer in frames
+	bool m_IsEventDriven; //True if the client was initialized with AUDCLNT_STREAMFLAGS_EVENTCALLBACK
+	UINT32 m_LockedFrames; //Frames locked by GetBuffer() and not released yet
+};
+
+/* CFakeAudioClient is the client Activate() creates on a CFakeAudioDevice.  It only goes as far as initialization,
+** which it does according to the device's FakeEndpoint, and handing out a CFakeRenderClient in exclusive mode.  Like a real client, it can only be initialized once - a
+** second attempt, even after a failed one, fails and is counted in FakeEndpoint::Reuses. */
+class CFakeAudioClient : public IAudioClient3 {
+public:
+	CFakeAudioClient(FakeEndpoint& Endpoint) :
+	m_RefCount(1),
+	m_Endpoint(Endpoint),
+	m_IsUsed(false),
+	m_BufferFrames(0),
+	m_BlockAlign(0),
+	m_StreamFlags(0)
+	{ }
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		if (m_Endpoint.HasClient3) {
+			QUERY_INTERFACE_CAST(IAudioClient3);
+			QUERY_INTERFACE_CAST(IAudioClient2);
+		}
+
+		QUERY_INTERFACE_CAST(IAudioClient);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() final {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() final {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IAudioClient methods
+
+	STDMETHODIMP Initialize(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME hnsBufferDuration, REFERENCE_TIME hnsPeriodicity, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) final {
+		HRESULT hr = BeginInitialization();
+
+		if (SUCCEEDED(hr)) {
+			if (ShareMode == AUDCLNT_SHAREMODE_SHARED) {
+				hr = m_Endpoint.SharedResult;
+			} else {
+				hr = m_Endpoint.ExclusiveResult;
+
+				m_BufferFrames = (UINT32)(floor(double(hnsBufferDuration) * pFormat->nSamplesPerSec / 10000000.0 + 0.5));
+
+				if (SUCCEEDED(hr) && m_Endpoint.AlignedBufferFrames != 0 && m_BufferFrames != m_Endpoint.AlignedBufferFrames) {
+					m_BufferFrames = m_Endpoint.AlignedBufferFrames;
+					hr = AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED;
+				}
+			}
+		}
+
+		if (SUCCEEDED(hr)) {
+			Record(ShareMode, StreamFlags, hnsBufferDuration, hnsPeriodicity, 0, pFormat);
+
+			if (ShareMode == AUDCLNT_SHAREMODE_EXCLUSIVE) {
+				m_BlockAlign = pFormat->nBlockAlign;
+				m_StreamFlags = StreamFlags;
+			}
+		}
+
+		return hr;
+	}
+
+	/* Only answers after an exclusive-mode initialization failed with AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED, with
+	** the aligned size */
+	STDMETHODIMP GetBufferSize(UINT32* pNumBufferFrames) final {
+		if (m_BufferFrames == 0) {
+			return AUDCLNT_E_NOT_INITIALIZED;
+		}
+
+		*pNumBufferFrames = m_BufferFrames;
+
+		return S_OK;
+	}
+
+	STDMETHODIMP GetStreamLatency(REFERENCE_TIME* phnsLatency) final { return E_NOTIMPL; }
+
+	STDMETHODIMP GetCurrentPadding(UINT32* pNumPaddingFrames) final { return E_NOTIMPL; }
+
+	/* Accepts FakeEndpoint::ExclusiveFormat in exclusive mode, and only the mix format in shared mode */
+	STDMETHODIMP IsFormatSupported(AUDCLNT_SHAREMODE ShareMode, const WAVEFORMATEX* pFormat, WAVEFORMATEX** ppClosestMatch) final {
+		WAVEFORMATEXTENSIBLE Accepted;
+
+		if (ShareMode == AUDCLNT_SHAREMODE_EXCLUSIVE) {
+			Accepted = m_Endpoint.ExclusiveFormat;
+		} else {
+			FakeEndpoint::GetMixFormat(&Accepted);
+
+			if (ppClosestMatch != nullptr) {
+				*ppClosestMatch = nullptr;
+			}
+		}
+
+		if (Accepted.Format.wFormatTag == 0 || pFormat->wFormatTag != WAVE_FORMAT_EXTENSIBLE) {
+			return AUDCLNT_E_UNSUPPORTED_FORMAT;
+		}
+
+		return memcmp(pFormat, &Accepted, sizeof(WAVEFORMATEXTENSIBLE)) == 0 ? S_OK : AUDCLNT_E_UNSUPPORTED_FORMAT;
+	}
+
+	STDMETHODIMP GetMixFormat(WAVEFORMATEX** ppDeviceFormat) final {
+		return CopyMixFormat(ppDeviceFormat);
+	}
+
+	STDMETHODIMP GetDevicePeriod(REFERENCE_TIME* phnsDefaultDevicePeriod, REFERENCE_TIME* phnsMinimumDevicePeriod) final {
+		if (phnsDefaultDevicePeriod != nullptr) *phnsDefaultDevicePeriod = 100000;
+		if (phnsMinimumDevicePeriod != nullptr) *phnsMinimumDevicePeriod = m_Endpoint.DevicePeriod;
+
+		return S_OK;
+	}
+
+	STDMETHODIMP Start() final { return E_NOTIMPL; }
+
+	STDMETHODIMP Stop() final { return E_NOTIMPL; }
+
+	STDMETHODIMP Reset() final { return E_NOTIMPL; }
+
+	STDMETHODIMP SetEventHandle(HANDLE eventHandle) final { return E_NOTIMPL; }
+
+	/* Only hands out an IAudioRenderClient, once the client has been initialized in exclusive mode */
+	STDMETHODIMP GetService(REFIID riid, void** ppv) final {
+		if (m_BlockAlign == 0) {
+			return AUDCLNT_E_NOT_INITIALIZED;
+		}
+
+		CFakeRenderClient* RenderClient = new CFakeRenderClient(m_Endpoint, m_BufferFrames, m_BlockAlign, (m_StreamFlags & AUDCLNT_STREAMFLAGS_EVENTCALLBACK) != 0);
+		HRESULT hr = RenderClient->QueryInterface(riid, ppv);
+
+		RenderClient->Release();
+
+		return hr;
+	}
+
+	//IAudioClient2 methods
+
+	STDMETHODIMP IsOffloadCapable(AUDIO_STREAM_CATEGORY Category, BOOL* pbOffloadCapable) final { return E_NOTIMPL; }
+
+	STDMETHODIMP SetClientProperties(const AudioClientProperties* pProperties) final { return E_NOTIMPL; }
+
+	STDMETHODIMP GetBufferSizeLimits(const WAVEFORMATEX* pFormat, BOOL bEventDriven, REFERENCE_TIME* phnsMinBufferDuration, REFERENCE_TIME* phnsMaxBufferDuration) final { return E_NOTIMPL; }
+
+	//IAudioClient3 methods
+
+	STDMETHODIMP GetSharedModeEnginePeriod(const WAVEFORMATEX* pFormat, UINT32* pDefaultPeriodInFrames, UINT32* pFundamentalPeriodInFrames, UINT32* pMinPeriodInFrames, UINT32* pMaxPeriodInFrames) final {
+		*pDefaultPeriodInFrames = m_Endpoint.DefaultPeriod;
+		*pFundamentalPeriodInFrames = m_Endpoint.FundamentalPeriod;
+		*pMinPeriodInFrames = m_Endpoint.MinPeriod;
+		*pMaxPeriodInFrames = m_Endpoint.MaxPeriod;
+
+		return S_OK;
+	}
+
+	STDMETHODIMP GetCurrentSharedModeEnginePeriod(WAVEFORMATEX** ppFormat, UINT32* pCurrentPeriodInFrames) final {
+		*pCurrentPeriodInFrames = m_Endpoint.LockedPeriod != 0 ? m_Endpoint.LockedPeriod : m_Endpoint.DefaultPeriod;
+
+		return CopyMixFormat(ppFormat);
+	}
+
+	STDMETHODIMP InitializeSharedAudioStream(DWORD StreamFlags, UINT32 PeriodInFrames, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) final {
+		HRESULT hr = BeginInitialization();
+
+		if (SUCCEEDED(hr)) {
+			hr = m_Endpoint.SharedStreamResult;
+		}
+
+		if (SUCCEEDED(hr) && m_Endpoint.LockedPeriod != 0 && PeriodInFrames != m_Endpoint.LockedPeriod) {
+			hr = AUDCLNT_E_ENGINE_PERIODICITY_LOCKED;
+		}
+
+		if (SUCCEEDED(hr)) {
+			Record(AUDCLNT_SHAREMODE_SHARED, StreamFlags, 0, 0, PeriodInFrames, pFormat);
+		}
+
+		return hr;
+	}
+
+private:
+	long m_RefCount; //Reference counter
+	FakeEndpoint& m_Endpoint; //The behavior to follow and the record to keep
+	bool m_IsUsed; //Set by the first initialization attempt, whether it succeeded or not
+	UINT32 m_BufferFrames; //The buffer size the last exclusive-mode initialization asked for, or the aligned one
+	UINT32 m_BlockAlign; //Bytes per frame of the exclusive-mode format, or zero if the client isn't initialized in exclusive mode
+	DWORD m_StreamFlags; //The flags the client was initialized with in exclusive mode
+
+	/* Fails if the client has already been through an initialization */
+	HRESULT BeginInitialization() {
+		if (m_IsUsed) {
+			m_Endpoint.Reuses++;
+			return AUDCLNT_E_ALREADY_INITIALIZED;
+		}
+
+		m_IsUsed = true;
+
+		return S_OK;
+	}
+
+	VOID Record(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Periodicity, UINT32 EnginePeriod, const WAVEFORMATEX* pFormat) {
+		m_Endpoint.Initializations++;
+		m_Endpoint.ShareMode = ShareMode;
+		m_Endpoint.StreamFlags = StreamFlags;
+		m_Endpoint.BufferDuration = BufferDuration;
+		m_Endpoint.Periodicity = Periodicity;
+		m_Endpoint.EnginePeriod = EnginePeriod;
+
+		ZeroMemory(&m_Endpoint.Format, sizeof(WAVEFORMATEXTENSIBLE));
+		memcpy(&m_Endpoint.Format, pFormat, pFormat->wFormatTag == WAVE_FORMAT_EXTENSIBLE ? sizeof(WAVEFORMATEXTENSIBLE) : sizeof(WAVEFORMATEX));
+	}
+
+	HRESULT CopyMixFormat(WAVEFORMATEX** ppFormat) {
+		WAVEFORMATEXTENSIBLE MixFormat;
+		const SIZE_T Size = m_Endpoint.IsPlainMixFormat ? sizeof(WAVEFORMATEX) : sizeof(WAVEFORMATEXTENSIBLE);
+		WAVEFORMATEX* pFormat = (WAVEFORMATEX*)(CoTaskMemAlloc(Size));
+
+		if (pFormat == nullptr) {
+			return E_OUTOFMEMORY;
+		}
+
+		FakeEndpoint::GetMixFormat(&MixFormat);
+		memcpy(pFormat, &MixFormat, Size);
+
+		if (m_Endpoint.IsPlainMixFormat) {
+			pFormat->wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+			pFormat->cbSize = 0;
+		}
+
+		*ppFormat = pFormat;
+
+		return S_OK;
+	}
+};
+
+/* CFakeAudioDevice is an IMMDevice that creates a new CFakeAudioClient on every call to Activate(), all of them
+** sharing [Endpoint].  It lives on the test's stack, so releasing it never deletes it. */
+class CFakeAudioDevice : public IMMDevice {
+public:
+	FakeEndpoint Endpoint;
+
+	CFakeAudioDevice() : m_RefCount(1) { }
+
+	/* Activates a client the way a stream would, for the code under test to start from */
+	CComPtr<IAudioClient> ActivateClient() {
+		CComPtr<IAudioClient> Client;
+
+		Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)(&Client));
+
+		return Client;
+	}
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IMMDevice);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() final {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() final {
+		return --m_RefCount;
+	}
+
+	//IMMDevice methods
+
+	STDMETHODIMP Activate(REFIID iid, DWORD dwClsCtx, PROPVARIANT* pActivationParams, void** ppInterface) final {
+		CFakeAudioClient* Client = new CFakeAudioClient(Endpoint);
+		HRESULT hr = Client->QueryInterface(iid, ppInterface);
+
+		Client->Release();
+
+		if (SUCCEEDED(hr)) {
+			Endpoint.Activations++;
+		}
+
+		return hr;
+	}
+
+	STDMETHODIMP OpenPropertyStore(DWORD stgmAccess, IPropertyStore** ppProperties) final { return E_NOTIMPL; }
+
+	STDMETHODIMP GetId(LPWSTR* ppstrId) final { return E_NOTIMPL; }
+
+	STDMETHODIMP GetState(DWORD* pdwState) final {
+		*pdwState = DEVICE_STATE_ACTIVE;
+		return S_OK;
+	}
+
+private:
+	long m_RefCount; //Reference counter
+};
\ No newline at end of file
@@ -0,0 +1,290 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#include "UnitTest.hpp"
+#include "DXAudio.h"
+#include "QueryInterface.h"
+#include <atlbase.h>
+#include <atomic>
+
+/* The callbacks count what the stream hands them, from the stream thread, while the test thread reads the counts */
+
+class TestWriteCallback : public IDXAudioWriteCallback {
+public:
+	std::atomic<UINT> Failures;
+	std::atomic<UINT64> Frames;
+
+	TestWriteCallback() : Failures(0), Frames(0) { }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) {
+		QUERY_INTERFACE_CAST(IDXAudioWriteCallback);
+		QUERY_INTERFACE_CAST(IDXAudioCallback);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		return 1;
+	}
+
+	VOID STDMETHODCALLTYPE OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) final {
+		std::wcout << File << L"(" << Line << L"): stream failure " << std::hex << hr << std::dec << std::endl;
+		Failures++;
+	}
+
+	VOID STDMETHODCALLTYPE OnThreadInit() final { }
+
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT BufferFrames) final {
+		ZeroMemory(AudioOut, sizeof(FLOAT) * 2 * BufferFrames);
+		Frames += BufferFrames;
+	}
+};
+
+class TestReadCallback : public IDXAudioReadCallback {
+public:
+	std::atomic<UINT> Failures;
+	std::atomic<UINT64> Frames;
+
+	TestReadCallback() : Failures(0), Frames(0) { }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) {
+		QUERY_INTERFACE_CAST(IDXAudioReadCallback);
+		QUERY_INTERFACE_CAST(IDXAudioCallback);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		return 1;
+	}
+
+	VOID STDMETHODCALLTYPE OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) final {
+		std::wcout << File << L"(" << Line << L"): stream failure " << std::hex << hr << std::dec << std::endl;
+		Failures++;
+	}
+
+	VOID STDMETHODCALLTYPE OnThreadInit() final { }
+
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames) final {
+		this->Frames += Frames;
+	}
+};
+
+/* Fills [pDesc] for a stream of [Type] at 22050Hz on the simulated devices described by [pDevice] */
+static VOID DescribeStream(DXAUDIO_STREAM_DESC* pDesc, DXAUDIO_STREAM_TYPE Type, DWORD Flags, const DXAUDIO_SIMULATED_DEVICE_DESC* pDevice) {
+	ZeroMemory(pDesc, sizeof(DXAUDIO_STREAM_DESC));
+
+	pDesc->Size = sizeof(DXAUDIO_STREAM_DESC);
+	pDesc->SampleRate = 22050.0f;
+	pDesc->Type = Type;
+	pDesc->Flags = Flags;
+	pDesc->pSimulatedDevice = pDevice;
+}
+
+//Engine conversion
+
+TEST(EngineConversionBypassesResampler) {
+	DXAUDIO_SIMULATED_DEVICE_DESC Device;
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_INFO Info;
+	TestWriteCallback Write;
+	TestReadCallback Read;
+	CComPtr<IDXAudioStream> Output;
+	CComPtr<IDXAudioStream> Input;
+
+	ZeroMemory(&Device, sizeof(Device));
+	Device.ToneFrequency = 440.0f;
+
+	//The simulated clients take the stream's own format when asked to convert it, so neither side resamples
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_OUTPUT, DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Write, &Output) == S_OK);
+	CHECK(Output->WaitForReady(5000) == S_OK);
+
+	Output->GetStreamInfo(&Info);
+	CHECK(Info.Output.ConversionPath == DXAUDIO_CONVERSION_PATH_ENGINE);
+	CHECK(Info.Output.SampleRate == 22050);
+	CHECK(Info.Output.MixFormat.SampleRate == 48000);
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_INPUT, DXAUDIO_STREAM_FLAG_ENGINE_CONVERSION, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Read, &Input) == S_OK);
+	CHECK(Input->WaitForReady(5000) == S_OK);
+
+	Input->GetStreamInfo(&Info);
+	CHECK(Info.Input.ConversionPath == DXAUDIO_CONVERSION_PATH_ENGINE);
+	CHECK(Info.Input.SampleRate == 22050);
+
+	CHECK(Write.Failures == 0);
+	CHECK(Read.Failures == 0);
+}
+
+TEST(DefaultConversionResamples) {
+	DXAUDIO_SIMULATED_DEVICE_DESC Device;
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_INFO Info;
+	TestWriteCallback Write;
+	CComPtr<IDXAudioStream> Output;
+
+	ZeroMemory(&Device, sizeof(Device));
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_OUTPUT, 0, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Write, &Output) == S_OK);
+	CHECK(Output->WaitForReady(5000) == S_OK);
+
+	Output->GetStreamInfo(&Info);
+	CHECK(Info.Output.ConversionPath == DXAUDIO_CONVERSION_PATH_LIBSAMPLERATE);
+	CHECK(Info.Output.SampleRate == 48000);
+	CHECK(Write.Failures == 0);
+}
+
+//Performance counters
+
+TEST(PerformanceCountsOutput) {
+	DXAUDIO_SIMULATED_DEVICE_DESC Device;
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_PERFORMANCE Performance;
+	TestWriteCallback Write;
+	CComPtr<IDXAudioStream> Output;
+
+	ZeroMemory(&Device, sizeof(Device));
+	Device.JitterMicroseconds = 2000;
+	Device.Seed = 1;
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_OUTPUT, 0, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Write, &Output) == S_OK);
+	CHECK(Output->WaitForReady(5000) == S_OK);
+
+	Output->Start();
+	Sleep(500);
+	Output->Stop();
+
+	//Half a second of 10ms periods, each delayed by up to 2ms
+	Output->GetPerformance(&Performance);
+	CHECK(Performance.WakeupJitter.Count > 10);
+	CHECK(Performance.WakeupJitter.Max > 0);
+	CHECK(Performance.CallbackTime.Count > 10);
+	CHECK(Performance.ResampleTime.Count > 10);
+	CHECK(Performance.FramesOut >= 4800);
+	CHECK(Performance.FramesIn == 0);
+	CHECK(Performance.Reinitializations == 0);
+	CHECK(Write.Frames > 0);
+
+	Output->ResetPerformance();
+	Output->GetPerformance(&Performance);
+	CHECK(Performance.WakeupJitter.Count == 0);
+	CHECK(Performance.CallbackTime.Count == 0);
+	CHECK(Performance.FramesOut == 0);
+
+	CHECK(Write.Failures == 0);
+}
+
+TEST(PerformanceCountsInput) {
+	DXAUDIO_SIMULATED_DEVICE_DESC Device;
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_PERFORMANCE Performance;
+	TestReadCallback Read;
+	CComPtr<IDXAudioStream> Input;
+
+	ZeroMemory(&Device, sizeof(Device));
+	Device.ToneFrequency = 440.0f;
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_INPUT, 0, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Read, &Input) == S_OK);
+	CHECK(Input->WaitForReady(5000) == S_OK);
+
+	Input->Start();
+	Sleep(500);
+	Input->Stop();
+
+	Input->GetPerformance(&Performance);
+	CHECK(Performance.WakeupJitter.Count > 10);
+	CHECK(Performance.ConversionTime.Count > 10);
+	CHECK(Performance.FramesIn >= 4800);
+	CHECK(Performance.FramesOut == 0);
+	CHECK(Read.Frames > 0);
+
+	CHECK(Read.Failures == 0);
+}
+
+TEST(PerformanceCountsReinitializations) {
+	DXAUDIO_SIMULATED_DEVICE_DESC Device;
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_PERFORMANCE Performance;
+	TestWriteCallback Write;
+	CComPtr<IDXAudioStream> Output;
+
+	ZeroMemory(&Device, sizeof(Device));
+	Device.FaultIntervalMilliseconds = 100;
+	Device.FaultTypes = DXAUDIO_SIMULATED_FAULT_INVALIDATE;
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_OUTPUT, 0, &Device);
+	CHECK(DXAudioCreateStream(&Desc, &Write, &Output) == S_OK);
+	CHECK(Output->WaitForReady(5000) == S_OK);
+
+	Output->Start();
+	Sleep(600);
+	Output->Stop();
+
+	//Each invalidation re-opens the endpoint, which is timed from the notification to the next period
+	Output->GetPerformance(&Performance);
+	CHECK(Performance.Reinitializations >= 1);
+	CHECK(Performance.ReinitializeTime.Count >= 1);
+	CHECK(Performance.RecoveryTime.Count >= 1);
+	CHECK(Performance.FramesOut > 0);
+
+	Output->ResetPerformance();
+	Output->GetPerformance(&Performance);
+	CHECK(Performance.Reinitializations == 0);
+	CHECK(Performance.ReinitializeTime.Count == 0);
+
+	CHECK(Write.Failures == 0);
+}
+
+TEST(PerformanceMeasuresOfflineRate) {
+	DXAUDIO_STREAM_DESC Desc;
+	DXAUDIO_STREAM_PERFORMANCE Performance;
+	TestWriteCallback Write;
+	CComPtr<IDXAudioStream> Offline;
+
+	DescribeStream(&Desc, DXAUDIO_STREAM_TYPE_OFFLINE, 0, nullptr);
+	CHECK(DXAudioCreateStream(&Desc, &Write, &Offline) == S_OK);
+	CHECK(Offline->WaitForReady(5000) == S_OK);
+
+	Offline->Start();
+	Sleep(200);
+	Offline->Stop();
+
+	//Nothing waits on a clock, so a callback that does nothing renders far faster than real time
+	Offline->GetPerformance(&Performance);
+	CHECK(Performance.RealtimeFactor > 1.0);
+	CHECK(Performance.CallbackTime.Count > 0);
+	CHECK(Performance.FramesOut > 0);
+
+	CHECK(Write.Failures == 0);
+}
\ No newline at end of file
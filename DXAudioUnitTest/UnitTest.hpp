@@ -0,0 +1,68 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+/* A minimal test harness.  TEST() defines a test and registers it before main() runs, and CHECK() reports a
+** failed condition without ending the test, so that one run shows everything that's wrong. */
+
+typedef void (*TestFunction)();
+
+struct TestCase {
+	const char* Name;
+	TestFunction Function;
+};
+
+/* Returns every test registered so far, in the order their files were initialized */
+inline std::vector<TestCase>& GetTests() {
+	static std::vector<TestCase> Tests;
+	return Tests;
+}
+
+/* Returns the number of checks that have failed so far */
+inline int& GetFailureCount() {
+	static int FailureCount = 0;
+	return FailureCount;
+}
+
+struct TestRegistrar {
+	TestRegistrar(const char* Name, TestFunction Function) {
+		GetTests().push_back({ Name, Function });
+	}
+};
+
+#define TEST(Name)\
+	static void Name();\
+	static TestRegistrar Name##_Registrar(#Name, Name);\
+	static void Name()
+
+#define CHECK(Condition)\
+	do {\
+		if (!(Condition)) {\
+			std::cout << __FILE__ << "(" << __LINE__ << "): CHECK(" << #Condition << ") failed" << std::endl;\
+			GetFailureCount()++;\
+		}\
+	} while (false)
\ No newline at end of file